@@ -0,0 +1,535 @@
+// bench_latency.c
+// End-to-end move latency against the number of games in play. For each
+// level (default 1, 100, 1000 and 10000 games) a fresh server loop is
+// forked: server.c built with -DSERVER_NO_MAIN on io_os, with epoll in
+// place of select() so it can hold 2N connections. 2N players connect over
+// TCP loopback, pair up into N games and play steadily: the player to move
+// writes MOVE after a think time (--think-ms, jittered), and one sample is
+// the time from that write until both players have read the BOARD it
+// caused. Moves the rules refuse are retried and the sample starts over.
+// Reports moves/s and the sample percentiles per level, as a table or, with
+// --tsv, one line per level to track per commit. Each side of the
+// benchmark needs 2N + a few fds; a level that does not fit RLIMIT_NOFILE
+// is skipped. --target HOST PORT measures a running server instead (its
+// MAX_CLIENTS caps the levels).
+// Run:   ./bench_latency [--games 1,100,1000,10000] [--seconds N] [--think-ms N] [--size N] [--tsv]
+//                        [--target HOST PORT]
+// gcc -O2 -pthread -DSERVER_NO_MAIN -DMAX_CLIENTS=20100 -I../server bench_latency.c ../server/server.c ../server/server_game.c ../server/server_rules.c ../server/server_proto.c ../server/server_playout.c ../server/server_pattern.c ../server/server_tt.c ../server/server_bot.c ../server/server_ring.c ../server/server_botpool.c ../server/server_book.c ../server/server_boardpool.c ../server/server_rxpool.c ../server/server_journal.c ../server/server_snapshot.c ../server/server_crc.c ../server/server_archive.c ../server/server_history.c ../server/server_rating.c ../server/server_match.c ../server/server_fdtab.c ../server/server_metrics.c ../server/server_admin.c ../server/server_slowlog.c ../server/server_dash.c ../server/server_capture.c ../server/server_io.c -lm -o bench_latency
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "server_io.h"
+#include "server_metrics.h"
+
+#define RBUF 4096
+#define CELLS (BOARD_MAX_SIZE * BOARD_MAX_SIZE)
+#define CONNECT_BATCH 256    // players connected before waiting for their NICK replies
+#define PLIES_PER_GAME 200   // then the game is left and hosted again
+
+// ---- the server side: io_os with epoll instead of select() ----
+
+static int ep_fd = -1;
+static int max_fds;
+static uint32_t *reg_conn;        // conn_id each fd is registered for, 0 none
+static unsigned char *is_ready;
+static int *ready_fds, nready;
+static struct epoll_event *evs;
+
+static void ep_add(int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST) epoll_ctl(ep_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static int ep_wait(const Client clients[], int listen_fd, int bot_fd, int timeout_ms) {
+    (void)bot_fd;
+    if (ep_fd < 0) {
+        ep_fd = epoll_create1(EPOLL_CLOEXEC);
+        ep_add(listen_fd);
+    }
+    // closed fds leave the epoll set by themselves; a reused one has a new conn_id
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        int fd = clients[i].fd;
+        if (fd < 0 || fd >= max_fds || reg_conn[fd] == clients[i].conn_id) continue;
+        ep_add(fd);
+        reg_conn[fd] = clients[i].conn_id;
+    }
+    for (int k = 0; k < nready; k++) is_ready[ready_fds[k]] = 0;
+    nready = 0;
+    int n = epoll_wait(ep_fd, evs, max_fds, timeout_ms);
+    for (int k = 0; k < n; k++) {
+        int fd = evs[k].data.fd;
+        is_ready[fd] = 1;
+        ready_fds[nready++] = fd;
+    }
+    return n;
+}
+
+static int ep_ready(int fd) {
+    return fd >= 0 && fd < max_fds && is_ready[fd];
+}
+
+static void run_server(int listen_fd) {
+    reg_conn = calloc((size_t)max_fds, sizeof(*reg_conn));
+    is_ready = calloc((size_t)max_fds, 1);
+    ready_fds = calloc((size_t)max_fds, sizeof(*ready_fds));
+    evs = calloc((size_t)max_fds, sizeof(*evs));
+    if (!reg_conn || !is_ready || !ready_fds || !evs) {
+        perror("calloc");
+        _exit(1);
+    }
+    static ServerIo io;
+    io = io_os;
+    io.wait = ep_wait;
+    io.ready = ep_ready;
+    metrics_init();
+    srand(1);
+    server_init(&io, listen_fd, -1);
+    for (;;) server_step();
+}
+
+// ---- the players ----
+
+typedef struct
+{
+    int fd;
+    int game;                 // index into games, -1 before the first START
+    int color;
+    int nick_ok;
+    size_t rlen;
+    char rbuf[RBUF];
+} Player;
+
+typedef struct
+{
+    int id;                   // server game id, 0 while being set up
+    int black, white;         // player indices
+    int to_move;
+    int plies;
+    int pending;              // a MOVE is out: waiting for both BOARDs
+    int got;                  // bit per colour that read the BOARD
+    int opened;               // bit per colour that read the opening BOARD
+    uint64_t sent_ns;
+    char board[CELLS];
+} Match;
+
+typedef struct
+{
+    uint64_t due;
+    int game;
+    int plies;
+} Timer;
+
+static Player *players;
+static Match *games;
+static int nplayers, ngames, size = 19, think_ms = 100;
+static int cli_ep = -1;
+static Timer *heap;
+static int nheap, heap_cap;
+static unsigned rng = 88172645u;
+static Histogram lat;
+static int measuring;
+static uint64_t moves, rejected, errors;
+static double rate;           // moves/s while measuring
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static unsigned next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void heap_push(uint64_t due, int game, int plies) {
+    if (nheap == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 1024;
+        heap = realloc(heap, (size_t)heap_cap * sizeof(Timer));
+        if (!heap) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    Timer t = {due, game, plies};
+    int i = nheap++;
+    while (i > 0 && heap[(i - 1) / 2].due > t.due) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = t;
+}
+
+static Timer heap_pop(void) {
+    Timer top = heap[0], last = heap[--nheap];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= nheap) break;
+        if (c + 1 < nheap && heap[c + 1].due < heap[c].due) c++;
+        if (heap[c].due >= last.due) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+static void say(int p, const char *line) {
+    size_t n = strlen(line);
+    if (send(players[p].fd, line, n, MSG_NOSIGNAL) != (ssize_t)n) errors++;
+}
+
+static void schedule(int g) {
+    uint64_t think = think_ms > 0 ? (uint64_t)(think_ms / 2 + next_rand() % (unsigned)(think_ms + 1)) : 0;
+    heap_push(now_ns() + think * 1000000ull, g, games[g].plies);
+}
+
+static void host(int g) {
+    char line[32];
+    snprintf(line, sizeof(line), "HOST %d B\n", size);
+    games[g].id = 0;
+    say(games[g].black, line);
+}
+
+static void play(int g) {
+    Match *m = &games[g];
+    char line[64];
+    if (m->plies >= PLIES_PER_GAME) {
+        snprintf(line, sizeof(line), "LEAVE %d\n", m->id);
+        m->id = 0;
+        say(m->black, line);
+        return;
+    }
+    int n = size * size, empty = 0;
+    for (int k = 0; k < n; k++) empty += m->board[k] == '.';
+    if (empty == 0) {
+        snprintf(line, sizeof(line), "PASS %d\n", m->id);
+    } else {
+        int pick = (int)(next_rand() % (unsigned)empty), k = 0;
+        for (;; k++) {
+            if (m->board[k] == '.' && pick-- == 0) break;
+        }
+        m->board[k] = 'x';   // not again if refused
+        snprintf(line, sizeof(line), "MOVE %d %d %d\n", m->id, k % size, k / size);
+    }
+    m->pending = 1;
+    m->got = 0;
+    m->sent_ns = now_ns();
+    say(m->to_move == 0 ? m->black : m->white, line);
+}
+
+static void on_line(int p, char *line) {
+    Player *pl = &players[p];
+    int id, sz;
+    char word[16];
+    if (strncmp(line, "BOARD ", 6) == 0) {
+        if (pl->game < 0 || sscanf(line, "BOARD %d %15s", &id, word) != 2 || id != games[pl->game].id) return;
+        Match *m = &games[pl->game];
+        char *cells = strchr(line + 6, ' ');
+        if (cells) cells = strchr(cells + 1, ' ');
+        if (!cells || (int)strlen(cells + 1) < size * size) return;
+        if (!(m->opened & 1 << pl->color)) {
+            // the opening board: black starts
+            m->opened |= 1 << pl->color;
+            if (pl->color == 0) {
+                memcpy(m->board, cells + 1, (size_t)(size * size));
+                m->to_move = 0;
+                schedule(pl->game);
+            }
+            return;
+        }
+        if (!m->pending) return;
+        m->got |= 1 << pl->color;
+        if (m->got != 3) return;
+        uint64_t t = now_ns();
+        if (measuring) hist_record(&lat, t - m->sent_ns);
+        moves++;
+        memcpy(m->board, cells + 1, (size_t)(size * size));
+        m->pending = 0;
+        m->plies++;
+        m->to_move = strcmp(word, "BLACK") == 0 ? 0 : 1;
+        schedule(pl->game);
+    } else if (strncmp(line, "START ", 6) == 0) {
+        if (sscanf(line, "START %d %d %15s", &id, &sz, word) != 3) return;
+        pl->game = p / 2;
+        pl->color = strcmp(word, "BLACK") == 0 ? 0 : 1;
+        // the two STARTs come over separate connections in either order
+        Match *m = &games[p / 2];
+        m->id = id;
+        m->opened &= ~(1 << pl->color);
+        if (pl->color == 0) {
+            m->plies = 0;
+            m->pending = 0;
+        }
+    } else if (strncmp(line, "HOSTED ", 7) == 0) {
+        if (sscanf(line, "HOSTED %d", &id) != 1) return;
+        char join[32];
+        snprintf(join, sizeof(join), "JOIN %d\n", id);
+        say(p + 1, join);
+    } else if (strcmp(line, "OK LEFT") == 0 || (strncmp(line, "GAME_OVER ", 10) == 0 && p % 2 == 0)) {
+        host(p / 2);   // black left, or two passes ended it
+    } else if (strcmp(line, "OK NICK set") == 0) {
+        pl->nick_ok = 1;
+    } else if (strncmp(line, "ERR ", 4) == 0) {
+        Match *m = pl->game >= 0 ? &games[pl->game] : NULL;
+        if (m && m->pending && (strcmp(line, "ERR suicide") == 0 || strcmp(line, "ERR ko") == 0 ||
+                                strcmp(line, "ERR occupied") == 0)) {
+            rejected++;
+            play(pl->game);
+        } else {
+            errors++;
+        }
+    }
+}
+
+static void on_readable(int p) {
+    Player *pl = &players[p];
+    for (;;) {
+        ssize_t r = recv(pl->fd, pl->rbuf + pl->rlen, sizeof(pl->rbuf) - 1 - pl->rlen, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && errno == EAGAIN) return;
+        if (r <= 0) {
+            errors++;
+            epoll_ctl(cli_ep, EPOLL_CTL_DEL, pl->fd, NULL);
+            return;
+        }
+        pl->rlen += (size_t)r;
+        size_t start = 0;
+        for (size_t k = 0; k < pl->rlen; k++) {
+            if (pl->rbuf[k] != '\n') continue;
+            pl->rbuf[k] = '\0';
+            on_line(p, pl->rbuf + start);
+            start = k + 1;
+        }
+        memmove(pl->rbuf, pl->rbuf + start, pl->rlen - start);
+        pl->rlen -= start;
+        if (pl->rlen == sizeof(pl->rbuf) - 1) pl->rlen = 0;
+    }
+}
+
+// serve players until deadline, or until done() holds
+static void run_until(uint64_t deadline, int (*done)(void)) {
+    struct epoll_event ev[512];
+    while (now_ns() < deadline && !(done && done())) {
+        int timeout = 10;
+        if (nheap) {
+            uint64_t now = now_ns();
+            int ms = heap[0].due > now ? (int)((heap[0].due - now) / 1000000) : 0;
+            if (ms < timeout) timeout = ms;
+        }
+        int n = epoll_wait(cli_ep, ev, 512, timeout);
+        for (int k = 0; k < n; k++) on_readable((int)ev[k].data.u32);
+        uint64_t now = now_ns();
+        while (nheap && heap[0].due <= now) {
+            Timer t = heap_pop();
+            Match *m = &games[t.game];
+            if (m->id && !m->pending && m->plies == t.plies) play(t.game);
+        }
+    }
+}
+
+static int connected_upto;
+
+static int nicks_done(void) {
+    for (int i = 0; i < connected_upto; i++) {
+        if (!players[i].nick_ok) return 0;
+    }
+    return 1;
+}
+
+static int all_started(void) {
+    for (int g = 0; g < ngames; g++) {
+        if (!games[g].id) return 0;
+    }
+    return 1;
+}
+
+// one level: ngames games on the server at addr; 0 on success
+static int level(const struct sockaddr_in *addr, int seconds) {
+    nplayers = 2 * ngames;
+    players = calloc((size_t)nplayers, sizeof(Player));
+    games = calloc((size_t)ngames, sizeof(Match));
+    if (!players || !games) {
+        perror("calloc");
+        exit(1);
+    }
+    cli_ep = epoll_create1(EPOLL_CLOEXEC);
+    nheap = 0;
+    memset(&lat, 0, sizeof(lat));
+    moves = rejected = errors = 0;
+    measuring = 0;
+
+    int rc = 0;
+    for (int i = 0; i < nplayers && rc == 0; i++) {
+        Player *p = &players[i];
+        p->game = -1;
+        p->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (p->fd < 0 || connect(p->fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+            perror("connect");
+            rc = -1;
+            break;
+        }
+        int one = 1;
+        setsockopt(p->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(p->fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        epoll_ctl(cli_ep, EPOLL_CTL_ADD, p->fd, &ev);
+        char nick[32];
+        snprintf(nick, sizeof(nick), "NICK lat%d\n", i);
+        say(i, nick);
+        connected_upto = i + 1;
+        if (connected_upto % CONNECT_BATCH == 0 || connected_upto == nplayers) {
+            run_until(now_ns() + 10000000000ull, nicks_done);
+            if (!nicks_done()) {
+                fprintf(stderr, "%d games: players not accepted (server full?)\n", ngames);
+                rc = -1;
+            }
+        }
+    }
+    if (rc == 0) {
+        for (int g = 0; g < ngames; g++) {
+            games[g].black = 2 * g;
+            games[g].white = 2 * g + 1;
+            host(g);
+        }
+        run_until(now_ns() + 30000000000ull, all_started);
+        if (!all_started()) {
+            fprintf(stderr, "%d games: not all games started\n", ngames);
+            rc = -1;
+        }
+    }
+    double secs = 0;
+    if (rc == 0) {
+        run_until(now_ns() + 1000000000ull, NULL);   // warm up: every game has moved
+        measuring = 1;
+        uint64_t m0 = moves, t0 = now_ns();
+        run_until(t0 + (uint64_t)seconds * 1000000000ull, NULL);
+        secs = (double)(now_ns() - t0) / 1e9;
+        moves -= m0;
+    }
+
+    for (int i = 0; i < connected_upto; i++) close(players[i].fd);
+    close(cli_ep);
+    free(players);
+    free(games);
+    rate = rc == 0 ? (double)moves / secs : 0;
+    return rc;
+}
+
+static double ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int levels[16], nlevels = 0, seconds = 10, tsv = 0;
+    const char *target_host = NULL;
+    int target_port = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            for (char *s = strtok(argv[++i], ","); s && nlevels < 16; s = strtok(NULL, ",")) levels[nlevels++] = atoi(s);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--think-ms") == 0 && i + 1 < argc) {
+            think_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tsv") == 0) {
+            tsv = 1;
+        } else if (strcmp(argv[i], "--target") == 0 && i + 2 < argc) {
+            target_host = argv[++i];
+            target_port = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--games 1,100,1000,10000] [--seconds N] [--think-ms N] [--size N] [--tsv] [--target HOST PORT]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nlevels == 0) {
+        levels[0] = 1, levels[1] = 100, levels[2] = 1000, levels[3] = 10000;
+        nlevels = 4;
+    }
+    if (seconds <= 0 || think_ms < 0 || size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE) {
+        fprintf(stderr, "bad options\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    max_fds = rl.rlim_cur > 1 << 20 ? 1 << 20 : (int)rl.rlim_cur;
+
+    if (tsv) printf("games\tmoves_per_s\tsamples\tp50_us\tp99_us\tp999_us\tmax_us\n");
+    else printf("%7s %10s %9s %9s %9s %9s %9s  (ms, MOVE written -> both players read BOARD; think %d ms, %dx%d)\n",
+                "games", "moves/s", "samples", "p50", "p99", "p99.9", "max", think_ms, size, size);
+    for (int l = 0; l < nlevels; l++) {
+        ngames = levels[l];
+        if (ngames <= 0) continue;
+        if (2 * ngames + 16 > max_fds || (!target_host && 2 * ngames > MAX_CLIENTS)) {
+            fprintf(stderr, "%d games: needs %d fds and client slots per side; have %d fds, MAX_CLIENTS %d\n", ngames,
+                    2 * ngames + 16, max_fds, MAX_CLIENTS);
+            continue;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        pid_t pid = -1;
+        if (target_host) {
+            addr.sin_port = htons((uint16_t)target_port);
+            if (inet_pton(AF_INET, target_host, &addr.sin_addr) != 1) {
+                fprintf(stderr, "bad address %s\n", target_host);
+                return 1;
+            }
+        } else {
+            int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t alen = sizeof(addr);
+            if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 1024) < 0 ||
+                getsockname(lfd, (struct sockaddr *)&addr, &alen) < 0) {
+                perror("listen");
+                return 1;
+            }
+            fflush(stdout);
+            pid = fork();
+            if (pid == 0) run_server(lfd);
+            close(lfd);
+        }
+
+        int rc = level(&addr, seconds);
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        if (rc < 0) continue;
+        if (tsv)
+            printf("%d\t%.0f\t%llu\t%.0f\t%.0f\t%.0f\t%.0f\n", ngames, rate,
+                   (unsigned long long)lat.count, (double)hist_quantile(&lat, 0.5) / 1e3,
+                   (double)hist_quantile(&lat, 0.99) / 1e3, (double)hist_quantile(&lat, 0.999) / 1e3,
+                   (double)lat.max / 1e3);
+        else
+            printf("%7d %10.0f %9llu %9.3f %9.3f %9.3f %9.3f%s\n", ngames, rate,
+                   (unsigned long long)lat.count, ms(hist_quantile(&lat, 0.5)), ms(hist_quantile(&lat, 0.99)),
+                   ms(hist_quantile(&lat, 0.999)), ms(lat.max), errors ? "  (errors, see above)" : "");
+        if (errors) fprintf(stderr, "%d games: %llu errors, %llu refused moves\n", ngames, (unsigned long long)errors,
+                            (unsigned long long)rejected);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// bench_match.c
+// Matchmaking queue throughput: seeks arrive at a fixed rate on simulated
+// time, spread over each pass interval (sizes 9/13/19, normal ratings
+// around 1500, some colour wishes), and a pairing pass runs every
+// MATCH_PASS_MS, as in the server loop. Reports
+// the real time spent in seek and pass calls, pairs made, the queue length
+// and how long and how far apart (in rating) paired players were.
+// Run:   ./bench_match [seeks_per_sec] [sim_seconds]
+// gcc -O2 bench_match.c ../server/server_match.c ../server/server_fdtab.c -I../server -lm -o bench_match
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "server_match.h"
+
+typedef struct
+{
+    long pairs;
+    double wait_ms;
+    double gap;
+    int64_t now;
+} Totals;
+
+static double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static double normal(unsigned *rng) {
+    double u = (rand_r(rng) + 1.0) / ((double)RAND_MAX + 2.0);
+    double v = (rand_r(rng) + 1.0) / ((double)RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * 3.14159265358979 * v);
+}
+
+static void on_pair(const Seek *a, const Seek *b, void *arg) {
+    Totals *t = arg;
+    t->pairs++;
+    t->wait_ms += (double)(t->now - a->since_ms) + (double)(t->now - b->since_ms);
+    t->gap += fabs(a->rating - b->rating);
+}
+
+int main(int argc, char **argv) {
+    int rate = argc > 1 ? atoi(argv[1]) : 5000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 60;
+    if (rate < 1 || seconds < 1) {
+        fprintf(stderr, "Usage: %s [seeks_per_sec] [sim_seconds]\n", argv[0]);
+        return 1;
+    }
+    static const int sizes[3] = {9, 13, 19};
+    unsigned rng = 12345;
+    Totals t = {0, 0, 0, 0};
+    long seeks = 0, passes = 0;
+    int max_waiting = 0;
+    int fd = 0;
+    double seek_sec = 0, pass_sec = 0;
+
+    int per_pass = (int)((long)rate * MATCH_PASS_MS / 1000);
+    if (per_pass < 1) per_pass = 1;
+    for (int64_t start = 0; start < (int64_t)seconds * 1000; start += MATCH_PASS_MS) {
+        double t0 = now_sec();
+        for (int i = 0; i < per_pass; i++) {
+            int r = rand_r(&rng) % 10;
+            char color = r == 0 ? 'B' : r == 1 ? 'W' : 'R';
+            // fds are reused once paired in the server; here they just grow
+            int64_t at = start + (int64_t)i * MATCH_PASS_MS / per_pass;
+            if (match_seek(fd++, sizes[rand_r(&rng) % 3], color, 1500.0 + 300.0 * normal(&rng), at) == 0)
+                seeks++;
+        }
+        t.now = start + MATCH_PASS_MS;
+        double t1 = now_sec();
+        if (match_waiting() > max_waiting) max_waiting = match_waiting();
+        match_pass(t.now, on_pair, &t);
+        passes++;
+        double t2 = now_sec();
+        seek_sec += t1 - t0;
+        pass_sec += t2 - t1;
+    }
+
+    printf("%ld seeks over %d s simulated (%d/s), %ld passes\n", seeks, seconds, rate, passes);
+    printf("seek: %.0f ns each, pass: %.1f us each (%.0f ns per seek)\n", seek_sec / seeks * 1e9,
+           pass_sec / passes * 1e6, pass_sec / seeks * 1e9);
+    printf("pairs: %ld, still waiting: %d (max %d), avg wait %.0f ms, avg rating gap %.0f\n", t.pairs,
+           match_waiting(), max_waiting, t.pairs ? t.wait_ms / (2.0 * t.pairs) : 0.0,
+           t.pairs ? t.gap / t.pairs : 0.0);
+    return 0;
+}
@@ -0,0 +1,344 @@
+// bench_memory.c
+// Server memory per idle connection, per open game and per running game.
+// The server loop runs in this process (server.c built with
+// -DSERVER_NO_MAIN on io_os, epoll in place of select(), stepped by hand),
+// and N players connect to it over TCP loopback in three phases: N connect
+// and set a nick (idle), N of them host a game (open), N more join those
+// games (running). After each phase the process RSS and the server's own
+// accounting (STATS mem_* lines, read over a probe connection) are
+// sampled; everything on the player side is allocated and touched up
+// front, so the deltas are the server's. "empty server" is what
+// server_init and the first STATS made resident before anyone connected.
+// A running game is charged what the join phase added minus its second
+// connection. Kernel socket memory is not in RSS and is not counted. The
+// last lines project --project idle connections (default 100000): a
+// client table that size plus the measured cost per connection.
+// Each phase needs N fds on both ends of the loopback, so 2N + a few must
+// fit RLIMIT_NOFILE and N must fit MAX_CLIENTS / 2 and MAX_GAMES.
+// Run:   ./bench_memory [--n N] [--size N] [--project N]
+// gcc -O2 -pthread -DSERVER_NO_MAIN -DMAX_CLIENTS=20100 -I../server bench_memory.c ../server/server.c ../server/server_game.c ../server/server_rules.c ../server/server_proto.c ../server/server_playout.c ../server/server_pattern.c ../server/server_tt.c ../server/server_bot.c ../server/server_ring.c ../server/server_botpool.c ../server/server_book.c ../server/server_boardpool.c ../server/server_rxpool.c ../server/server_journal.c ../server/server_snapshot.c ../server/server_crc.c ../server/server_archive.c ../server/server_history.c ../server/server_rating.c ../server/server_match.c ../server/server_fdtab.c ../server/server_metrics.c ../server/server_admin.c ../server/server_slowlog.c ../server/server_dash.c ../server/server_capture.c ../server/server_io.c -lm -o bench_memory
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "server_io.h"
+#include "server_metrics.h"
+
+#define CONNECT_BATCH 256    // connects before stepping the server through their accepts
+#define MAX_STEPS 10000000   // per phase, in case the server stops answering
+
+// ---- the server side: io_os with epoll instead of select(), never blocking ----
+
+static int ep_fd = -1;
+static int max_fds;
+static uint32_t *reg_conn;        // conn_id each fd is registered for, 0 none
+static unsigned char *is_ready;
+static int *ready_fds, nready;
+static struct epoll_event *evs;
+
+static void ep_add(int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+    if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST) epoll_ctl(ep_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static int ep_wait(const Client clients[], int listen_fd, int bot_fd, int timeout_ms) {
+    (void)bot_fd;
+    (void)timeout_ms;   // the players are in this process: poll, they cannot write while we wait
+    if (ep_fd < 0) {
+        ep_fd = epoll_create1(EPOLL_CLOEXEC);
+        ep_add(listen_fd);
+    }
+    // closed fds leave the epoll set by themselves; a reused one has a new conn_id
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        int fd = clients[i].fd;
+        if (fd < 0 || fd >= max_fds || reg_conn[fd] == clients[i].conn_id) continue;
+        ep_add(fd);
+        reg_conn[fd] = clients[i].conn_id;
+    }
+    for (int k = 0; k < nready; k++) is_ready[ready_fds[k]] = 0;
+    nready = 0;
+    int n = epoll_wait(ep_fd, evs, max_fds, 0);
+    for (int k = 0; k < n; k++) {
+        int fd = evs[k].data.fd;
+        is_ready[fd] = 1;
+        ready_fds[nready++] = fd;
+    }
+    return n;
+}
+
+static int ep_ready(int fd) {
+    return fd >= 0 && fd < max_fds && is_ready[fd];
+}
+
+// ---- the players ----
+
+typedef struct
+{
+    int fd;
+    int gid;                  // from HOSTED
+    int col;                  // position in the current reply line
+    char head[48];            // its first bytes
+} Player;
+
+static Player *players;       // [0] probes, then 2N players
+static int nplayers;
+static int cli_ep;
+static struct epoll_event *cli_evs;
+static int pongs, errors;
+
+static const char *mem_names[MEM_COUNT] = {"clients", "rxbufs", "games", "boards", "moves", "match", "ratings", "tt", "bot"};
+
+typedef struct
+{
+    uint64_t rss;
+    uint64_t mem[MEM_COUNT];
+    uint64_t mem_total;
+} Sample;
+
+static Sample probe_sample;
+
+static void on_line(Player *p) {
+    int n = p->col < (int)sizeof(p->head) ? p->col : (int)sizeof(p->head) - 1;
+    p->head[n] = '\0';
+    char name[24];
+    unsigned long long v;
+    if (strcmp(p->head, "PONG") == 0) {
+        pongs++;
+    } else if (strncmp(p->head, "HOSTED ", 7) == 0) {
+        sscanf(p->head, "HOSTED %d", &p->gid);
+    } else if (strncmp(p->head, "ERR ", 4) == 0) {
+        fprintf(stderr, "player %d: %s\n", (int)(p - players), p->head);
+        errors++;
+    } else if (sscanf(p->head, "STAT mem_%23s %llu", name, &v) == 2) {
+        if (strcmp(name, "total") == 0) probe_sample.mem_total = v;
+        for (int m = 0; m < MEM_COUNT; m++) {
+            if (strcmp(name, mem_names[m]) == 0) probe_sample.mem[m] = v;
+        }
+    }
+}
+
+static void drain(Player *p) {
+    char buf[4096];
+    for (;;) {
+        ssize_t r = recv(p->fd, buf, sizeof(buf), 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            if (r == 0) {
+                errors++;
+                epoll_ctl(cli_ep, EPOLL_CTL_DEL, p->fd, NULL);
+            }
+            return;
+        }
+        for (ssize_t i = 0; i < r; i++) {
+            if (buf[i] == '\n') {
+                on_line(p);
+                p->col = 0;
+            } else {
+                if (p->col < (int)sizeof(p->head) - 1) p->head[p->col] = buf[i];
+                p->col++;
+            }
+        }
+    }
+}
+
+// step the server and read what it sent until `want` PONGs have come back
+static int settle(int want) {
+    for (int s = 0; s < MAX_STEPS && pongs < want; s++) {
+        server_step();
+        int n = epoll_wait(cli_ep, cli_evs, nplayers, 0);
+        for (int k = 0; k < n; k++) drain(&players[cli_evs[k].data.u32]);
+    }
+    return pongs < want ? -1 : 0;
+}
+
+static void say(int i, const char *text) {
+    size_t n = strlen(text);
+    if (send(players[i].fd, text, n, MSG_NOSIGNAL) != (ssize_t)n) errors++;
+}
+
+// connect players first .. first + n - 1, each sending its NICK
+static int connect_players(const struct sockaddr_in *addr, int first, int n) {
+    int want = pongs;
+    for (int i = first; i < first + n; i++) {
+        Player *p = &players[i];
+        p->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (p->fd < 0 || connect(p->fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+            perror("connect");
+            return -1;
+        }
+        fcntl(p->fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        epoll_ctl(cli_ep, EPOLL_CTL_ADD, p->fd, &ev);
+        char line[48];
+        snprintf(line, sizeof(line), "NICK mem%d\nPING\n", i);
+        say(i, line);
+        if ((i - first + 1) % CONNECT_BATCH == 0 || i == first + n - 1) {
+            if (settle(want + i - first + 1) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    unsigned long long size = 0, resident = 0;
+    if (f) {
+        if (fscanf(f, "%llu %llu", &size, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+static int sample(Sample *s) {
+    memset(&probe_sample, 0, sizeof(probe_sample));
+    say(0, "STATS\nPING\n");
+    if (settle(pongs + 1) < 0) return -1;
+    *s = probe_sample;
+    s->rss = rss_bytes();
+    return 0;
+}
+
+static void row(const char *what, int n, const Sample *a, const Sample *b, double minus_rss, double minus_acc) {
+    double rss = ((double)b->rss - (double)a->rss) / n - minus_rss;
+    double acc = ((double)b->mem_total - (double)a->mem_total) / n - minus_acc;
+    printf("%-18s %8d %14.0f %14.0f   ", what, n, rss, acc);
+    for (int m = 0; m < MEM_COUNT; m++) {
+        if (b->mem[m] != a->mem[m])
+            printf(" %s %+.0f", mem_names[m], ((double)b->mem[m] - (double)a->mem[m]) / n);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    int n = 4000, size = 19, project = 100000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--n") == 0 && i + 1 < argc) n = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--project") == 0 && i + 1 < argc) project = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [--n N] [--size N] [--project N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n <= 0 || size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE || project <= 0) {
+        fprintf(stderr, "bad options\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    max_fds = rl.rlim_cur > 1 << 20 ? 1 << 20 : (int)rl.rlim_cur;
+    if (4 * n + 16 > max_fds || 2 * n + 1 > MAX_CLIENTS || n > MAX_GAMES) {
+        fprintf(stderr, "--n %d needs %d fds (have %d), %d client slots (MAX_CLIENTS %d) and %d games (MAX_GAMES %d)\n",
+                n, 4 * n + 16, max_fds, 2 * n + 1, MAX_CLIENTS, n, MAX_GAMES);
+        return 1;
+    }
+
+    // everything on this side up front and touched, so RSS deltas are the server's
+    nplayers = 2 * n + 1;
+    reg_conn = calloc((size_t)max_fds, sizeof(*reg_conn));
+    is_ready = calloc((size_t)max_fds, 1);
+    ready_fds = calloc((size_t)max_fds, sizeof(*ready_fds));
+    evs = calloc((size_t)max_fds, sizeof(*evs));
+    players = calloc((size_t)nplayers, sizeof(Player));
+    cli_evs = calloc((size_t)nplayers, sizeof(*cli_evs));
+    if (!reg_conn || !is_ready || !ready_fds || !evs || !players || !cli_evs) {
+        perror("calloc");
+        return 1;
+    }
+    memset(reg_conn, 0, (size_t)max_fds * sizeof(*reg_conn));
+    memset(is_ready, 0, (size_t)max_fds);
+    memset(ready_fds, 0, (size_t)max_fds * sizeof(*ready_fds));
+    memset(evs, 0, (size_t)max_fds * sizeof(*evs));
+    memset(players, 0, (size_t)nplayers * sizeof(Player));
+    memset(cli_evs, 0, (size_t)nplayers * sizeof(*cli_evs));
+    cli_ep = epoll_create1(EPOLL_CLOEXEC);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 4096) < 0 ||
+        getsockname(lfd, (struct sockaddr *)&addr, &alen) < 0) {
+        perror("listen");
+        return 1;
+    }
+    static ServerIo io;
+    io = io_os;
+    io.wait = ep_wait;
+    io.ready = ep_ready;
+    metrics_init();
+    srand(1);
+    uint64_t rss_before = rss_bytes();
+    server_init(&io, lfd, -1);
+
+    // the probe, then one round of each phase's commands on it so the
+    // server's first-use allocations (stdio, metrics) land in the baseline
+    Sample base, idle, open, running;
+    char line[64];
+    if (connect_players(&addr, 0, 1) < 0 || sample(&base) < 0 || sample(&base) < 0) {
+        fprintf(stderr, "probe not answered\n");
+        return 1;
+    }
+
+    // phase 1: idle connections
+    if (connect_players(&addr, 1, n) < 0 || sample(&idle) < 0) {
+        fprintf(stderr, "idle phase: not all players answered\n");
+        return 1;
+    }
+    // phase 2: each of them hosts a game
+    for (int i = 1; i <= n; i++) {
+        snprintf(line, sizeof(line), "HOST %d B\nPING\n", size);
+        say(i, line);
+    }
+    if (settle(pongs + n) < 0 || sample(&open) < 0) {
+        fprintf(stderr, "open phase: not all hosts answered\n");
+        return 1;
+    }
+    // phase 3: N more players join them
+    if (connect_players(&addr, n + 1, n) < 0) {
+        fprintf(stderr, "running phase: not all players answered\n");
+        return 1;
+    }
+    for (int i = 1; i <= n; i++) {
+        snprintf(line, sizeof(line), "JOIN %d\nPING\n", players[i].gid);
+        say(n + i, line);
+    }
+    if (settle(pongs + n) < 0 || sample(&running) < 0) {
+        fprintf(stderr, "running phase: not all joins answered\n");
+        return 1;
+    }
+
+    double conn_rss = ((double)idle.rss - (double)base.rss) / n;
+    double conn_acc = ((double)idle.mem_total - (double)base.mem_total) / n;
+    printf("%d players, %dx%d games; bytes per unit (RSS: resident pages; accounted: STATS mem_total)\n", n, size,
+           size);
+    printf("%-18s %8s %14s %14s    %s\n", "", "count", "rss", "accounted", "accounted by subsystem");
+    printf("%-18s %8d %14.0f %14llu\n", "empty server", 1, (double)base.rss - (double)rss_before,
+           (unsigned long long)base.mem_total);
+    row("idle connection", n, &base, &idle, 0, 0);
+    row("open game", n, &idle, &open, 0, 0);
+    row("running game", n, &open, &running, conn_rss, conn_acc);
+    printf("reserved at build time: client table %llu (%d x %zu), game table %llu (%d x %zu)\n",
+           (unsigned long long)base.mem[MEM_CLIENTS], MAX_CLIENTS, sizeof(Client),
+           (unsigned long long)base.mem[MEM_GAMES], MAX_GAMES, sizeof(Game));
+    printf("%d idle connections: a client table for them holds %.1f MB (resident from the start when server_init\n"
+           "touches every slot), plus %.1f MB as they connect\n",
+           project, (double)project * sizeof(Client) / 1e6, conn_rss * project / 1e6);
+    if (errors) printf("(%d errors, see above)\n", errors);
+    return errors != 0;
+}
@@ -0,0 +1,108 @@
+// bench_playouts.c
+// Playout throughput on PlayoutBoard, single core and all cores, for the
+// light (uniform) and pattern-weighted policies.
+// Run:   ./bench_playouts [seconds_per_run]
+// gcc -O2 -pthread bench_playouts.c ../server/server_playout.c ../server/server_pattern.c -I../server -o bench_playouts
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "server_playout.h"
+
+#define KOMI 6.5
+
+typedef struct
+{
+    int size;
+    int patterns;
+    double seconds;
+    unsigned seed;
+    long playouts;
+    long black_wins;
+} Run;
+
+static double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void *run_playouts(void *arg) {
+    Run *r = (Run *)arg;
+    PlayoutBoard empty, pb;
+    pb_init(&empty, r->size);
+    if (r->patterns) pb_enable_patterns(&empty);
+
+    double end = now_sec() + r->seconds;
+    while (now_sec() < end) {
+        // check the clock every 64 playouts
+        for (int i = 0; i < 64; i++) {
+            pb_copy(&pb, &empty);
+            if (pb_playout(&pb, &r->seed, KOMI) == 0) r->black_wins++;
+            r->playouts++;
+        }
+    }
+    return NULL;
+}
+
+static double measure(int size, int patterns, int threads, double seconds, double *black_rate) {
+    Run runs[64];
+    pthread_t tids[64];
+    if (threads > 64) threads = 64;
+
+    for (int i = 0; i < threads; i++) {
+        runs[i].size = size;
+        runs[i].patterns = patterns;
+        runs[i].seconds = seconds;
+        runs[i].seed = 0x12345u + (unsigned)i * 0x9e3779b9u;
+        runs[i].playouts = 0;
+        runs[i].black_wins = 0;
+    }
+
+    double t0 = now_sec();
+    for (int i = 1; i < threads; i++) pthread_create(&tids[i], NULL, run_playouts, &runs[i]);
+    run_playouts(&runs[0]);
+    for (int i = 1; i < threads; i++) pthread_join(tids[i], NULL);
+    double dt = now_sec() - t0;
+
+    long total = 0, black = 0;
+    for (int i = 0; i < threads; i++) {
+        total += runs[i].playouts;
+        black += runs[i].black_wins;
+    }
+    *black_rate = total ? (double)black / total : 0.0;
+    return (double)total / dt;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 2.0;
+    if (argc >= 2) seconds = atof(argv[1]);
+    if (seconds <= 0) {
+        fprintf(stderr, "Usage: %s [seconds_per_run]\n", argv[0]);
+        return 1;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+
+    printf("size   policy   threads  playouts/sec  black_wins\n");
+    const int sizes[] = {9, 13, 19, 32};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        double light = 0;
+        for (int patterns = 0; patterns <= 1; patterns++) {
+            const char *name = patterns ? "pattern" : "light";
+            double rate;
+            double pps = measure(sizes[i], patterns, 1, seconds, &rate);
+            printf("%2dx%-2d  %-7s  %7d  %12.0f  %.3f\n", sizes[i], sizes[i], name, 1, pps, rate);
+            if (!patterns) light = pps;
+            else printf("%2dx%-2d  pattern cost vs light: %.2fx slower\n", sizes[i], sizes[i], light / pps);
+            if (cores > 1) {
+                pps = measure(sizes[i], patterns, (int)cores, seconds, &rate);
+                printf("%2dx%-2d  %-7s  %7ld  %12.0f  %.3f\n", sizes[i], sizes[i], name, cores, pps, rate);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// bench_restart.c
+// Restart cost of the journal. Three child processes share one journal
+// path: the first opens it empty and plays N games of random moves, the
+// second restarts by replaying that whole history (and leaves a snapshot),
+// then adds a tail of moves; the third restarts from the snapshot plus
+// that tail. Each child starts with a fresh registry, as a restarted server.
+// Run:   ./bench_restart [games] [moves_per_game] [tail_moves] [dir]
+// gcc -O2 -pthread bench_restart.c ../server/server_game.c ../server/server_fdtab.c ../server/server_rules.c ../server/server_proto.c ../server/server_boardpool.c ../server/server_rxpool.c ../server/server_journal.c ../server/server_snapshot.c ../server/server_crc.c ../server/server_archive.c -I../server -o bench_restart
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "server_game.h"
+#include "server_proto.h"
+#include "server_journal.h"
+
+// no sockets here
+ssize_t send_str(int fd, const char *s) {
+    (void)fd;
+    return (ssize_t)strlen(s);
+}
+
+void close_client_later(Client clients[], int fd, const char *reason) {
+    (void)clients;
+    (void)fd;
+    (void)reason;
+}
+
+void broadcast_subscribed(Client clients[], const char *msg) {
+    (void)clients;
+    (void)msg;
+}
+
+int64_t wall_ms(void) {
+    return 0;
+}
+
+static unsigned rng = 12345;
+
+static unsigned next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// a random legal move for g, journaled; a pass if none is found quickly
+static void random_move(Game *g) {
+    int c = g->to_move;
+    for (int tries = 0; tries < 20; tries++) {
+        int x = (int)(next_rand() % (unsigned)g->size), y = (int)(next_rand() % (unsigned)g->size);
+        if (game_play_move(g, c, x, y) == MOVE_OK) {
+            journal_move(g->id, c, x, y);
+            return;
+        }
+    }
+    game_pass(g);
+    journal_pass(g->id, c);
+}
+
+static int open_journal(const char *path, const char *what) {
+    if (journal_open(path, 0) < 0) return -1;
+    JournalStats js;
+    journal_stats(&js);
+    printf("%-20s %6llu games from snapshot, %8llu records replayed, %8.1f ms\n", what,
+           (unsigned long long)js.restored, (unsigned long long)js.replayed, js.restore_ms);
+    return 0;
+}
+
+static int build(const char *path, int games, int moves) {
+    if (open_journal(path, "empty start") < 0) return 1;
+    const int sizes[] = {9, 13, 19};
+    for (int i = 0; i < games; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "g%d", i + 1);
+        Game *g = game_restore(i + 1, sizes[i % 3], 0, 0, "host", name);
+        if (!g) {
+            fprintf(stderr, "registry full at %d games\n", i);
+            return 1;
+        }
+        journal_create(g);
+        snprintf(g->guest_nick, sizeof(g->guest_nick), "guest");
+        g->status = GAME_RUNNING;
+        game_clear_board(g);
+        journal_join(g);
+    }
+    for (int m = 0; m < moves; m++) {
+        for (int i = 0; i < game_total(); i++) random_move(game_at(i));
+    }
+    journal_sync();
+    return 0;
+}
+
+static int full_then_tail(const char *path, int tail) {
+    if (open_journal(path, "full replay") < 0) return 1;
+    for (int m = 0; m < tail; m++) random_move(game_at((int)(next_rand() % (unsigned)game_total())));
+    journal_sync();
+    return 0;
+}
+
+static int from_snapshot(const char *path) {
+    return open_journal(path, "snapshot + tail") < 0 ? 1 : 0;
+}
+
+static int run_child(int (*fn)(const char *, int, int), const char *path, int a, int b) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int r = fn(path, a, b);
+        fflush(stdout);
+        _exit(r);
+    }
+    int st;
+    if (pid < 0 || waitpid(pid, &st, 0) < 0) return -1;
+    return WIFEXITED(st) && WEXITSTATUS(st) == 0 ? 0 : -1;
+}
+
+static int phase_build(const char *path, int a, int b) { return build(path, a, b); }
+static int phase_full(const char *path, int a, int b) { (void)b; return full_then_tail(path, a); }
+static int phase_snap(const char *path, int a, int b) { (void)a; (void)b; return from_snapshot(path); }
+
+int main(int argc, char **argv) {
+    int games = argc > 1 ? atoi(argv[1]) : MAX_GAMES;
+    int moves = argc > 2 ? atoi(argv[2]) : 60;
+    int tail = argc > 3 ? atoi(argv[3]) : 1000;
+    const char *dir = argc > 4 ? argv[4] : "/tmp";
+    if (games <= 0 || games > MAX_GAMES || moves < 0 || tail < 0) {
+        fprintf(stderr, "Usage: %s [games<=%d] [moves_per_game] [tail_moves] [dir]\n", argv[0], MAX_GAMES);
+        return 1;
+    }
+
+    char path[4096], other[4200];
+    snprintf(path, sizeof(path), "%s/bench_restart.%d.journal", dir, (int)getpid());
+    printf("%d games x %d moves, tail %d moves, %s\n", games, moves, tail, path);
+
+    int rc = run_child(phase_build, path, games, moves);
+    if (rc == 0) rc = run_child(phase_full, path, tail, 0);
+    if (rc == 0) rc = run_child(phase_snap, path, 0, 0);
+
+    unlink(path);
+    snprintf(other, sizeof(other), "%s.snap", path);
+    unlink(other);
+    snprintf(other, sizeof(other), "%s.next", path);
+    unlink(other);
+    return rc < 0 ? 1 : 0;
+}
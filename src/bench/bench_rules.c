@@ -0,0 +1,425 @@
+// bench_rules.c
+// Rules engine microbenchmarks on a fixed corpus of positions: empty 9x9
+// and 19x19, a seeded random mid-game, a 179-stone comb chain, a ladder
+// run across the board and a 288-stone capture. Cases time legality
+// sweeps (every empty point tried, the board restored after legal moves),
+// MOVE-path replays (game_play_move with the move list kept, as the
+// server plays), collect_group over every stone, the mass capture and a
+// ko refusal. Each case is warmed up, sized to at least --min-ms per
+// repetition and repeated; ns/op is reported as median, min, mean and
+// relative stddev. The corpus is built by code, not read from a file;
+// its checksum is printed so two runs can be checked to have timed the
+// same positions.
+// Run:   ./bench_rules [--reps N] [--min-ms N] [--filter SUBSTR]
+// gcc -O2 bench_rules.c ../server/server_rules.c -I../server -lm -o bench_rules
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "server_game.h"
+
+#define MAX_SEQ 512
+
+typedef struct
+{
+    const char *name;
+    int size;
+    int to_move;
+    unsigned char board[BOARD_CELLS_MAX];
+    unsigned char prev[BOARD_CELLS_MAX];
+    int seq[MAX_SEQ];         // a game continuing from the position: board index, -1 pass
+    int nseq;
+} Position;
+
+typedef struct
+{
+    const char *name;
+    const Position *pos;
+    long (*run)(const Position *pos);   // one batch; returns ops done
+    const char *unit;                   // what one op is
+} Case;
+
+static Game g;
+static unsigned char storage[2 * BOARD_CELLS_MAX];
+static volatile long sink;   // keeps results observable
+
+static Position empty9, empty19, midgame, chain, ladder, capture, ko;
+
+static double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+// ---- corpus ----
+
+static void load(const Position *p) {
+    g.size = p->size;
+    game_use_storage(&g, storage);
+    memcpy(g.board, p->board, (size_t)(p->size * p->size));
+    memcpy(g.prev_board, p->prev, (size_t)(p->size * p->size));
+    g.to_move = p->to_move;
+    g.ply = 0;
+}
+
+static void save(Position *p, const char *name) {
+    p->name = name;
+    p->size = g.size;
+    p->to_move = g.to_move;
+    memcpy(p->board, g.board, (size_t)(g.size * g.size));
+    memcpy(p->prev, g.prev_board, (size_t)(g.size * g.size));
+}
+
+static void fresh(int size) {
+    memset(&g, 0, sizeof(g));
+    g.size = size;
+    game_use_storage(&g, storage);
+    game_clear_board(&g);
+}
+
+static void put(int x, int y, int stone) {
+    g.board[y * g.size + x] = (unsigned char)stone;
+}
+
+// fixed LCG so the corpus does not depend on the libc's rand()
+static unsigned lcg(unsigned *s) {
+    *s = *s * 1103515245u + 12345u;
+    return (*s >> 16) & 0x7fff;
+}
+
+// random legal moves on empty points; passes when none is found quickly
+static int random_game(int *seq, int moves, unsigned seed) {
+    int n = g.size * g.size, played = 0;
+    while (played < moves) {
+        int idx = -1;
+        for (int tries = 0; tries < 50; tries++) {
+            int k = (int)(lcg(&seed) % (unsigned)n);
+            if (g.board[k] == 0 && game_play_move(&g, g.to_move, k % g.size, k / g.size) == MOVE_OK) {
+                idx = k;
+                break;
+            }
+        }
+        if (idx < 0) game_pass(&g);
+        seq[played++] = idx;
+    }
+    return played;
+}
+
+typedef struct
+{
+    unsigned char board[BOARD_CELLS_MAX], prev[BOARD_CELLS_MAX];
+    int to_move, ply, cap_black, cap_white;
+} Undo;
+
+static void undo_save(Undo *u) {
+    memcpy(u->board, g.board, sizeof(u->board));
+    memcpy(u->prev, g.prev_board, sizeof(u->prev));
+    u->to_move = g.to_move;
+    u->ply = g.ply;
+    u->cap_black = g.cap_black;
+    u->cap_white = g.cap_white;
+}
+
+static void undo_load(const Undo *u) {
+    memcpy(g.board, u->board, sizeof(u->board));
+    memcpy(g.prev_board, u->prev, sizeof(u->prev));
+    g.to_move = u->to_move;
+    g.ply = u->ply;
+    g.cap_black = u->cap_black;
+    g.cap_white = u->cap_white;
+}
+
+// liberties of the group at idx, and the highest-index one of them
+static int libs_at(int idx, int *a_lib) {
+    static const int dx[4] = {1, -1, 0, 0}, dy[4] = {0, 0, 1, -1};
+    int stones[BOARD_CELLS_MAX], libs = 0;
+    int cnt = collect_group(&g, idx % g.size, idx / g.size, g.board[idx], stones, BOARD_CELLS_MAX, &libs);
+    *a_lib = -1;
+    for (int i = 0; i < cnt; i++) {
+        for (int k = 0; k < 4; k++) {
+            int x = stones[i] % g.size + dx[k], y = stones[i] / g.size + dy[k];
+            if (in_bounds(&g, x, y) && g.board[y * g.size + x] == 0 && y * g.size + x > *a_lib)
+                *a_lib = y * g.size + x;
+        }
+    }
+    return libs;
+}
+
+// the other liberty of a two-liberty group
+static int other_lib(int idx, int not) {
+    static const int dx[4] = {1, -1, 0, 0}, dy[4] = {0, 0, 1, -1};
+    int stones[BOARD_CELLS_MAX], libs;
+    int cnt = collect_group(&g, idx % g.size, idx / g.size, g.board[idx], stones, BOARD_CELLS_MAX, &libs);
+    for (int i = 0; i < cnt; i++) {
+        for (int k = 0; k < 4; k++) {
+            int x = stones[i] % g.size + dx[k], y = stones[i] / g.size + dy[k];
+            if (in_bounds(&g, x, y) && g.board[y * g.size + x] == 0 && y * g.size + x != not) return y * g.size + x;
+        }
+    }
+    return -1;
+}
+
+// white (the runner, in atari) extends; black ataris on the liberty
+// after which the next extension still has at most two liberties, until
+// the runner is captured at the edge
+static int ladder_game(int *seq, int runner) {
+    int n = 0;
+    while (n + 2 <= MAX_SEQ && g.board[runner] == 2) {
+        int lib;
+        if (libs_at(runner, &lib) != 1) break;
+        if (game_play_move(&g, 1, lib % g.size, lib / g.size) != MOVE_OK) break;
+        seq[n++] = lib;
+        int a, libs = libs_at(runner, &a);
+        if (libs == 1 && game_play_move(&g, 0, a % g.size, a / g.size) == MOVE_OK) {
+            seq[n++] = a;   // at the edge: captured
+            break;
+        }
+        if (libs != 2) break;
+        int cand[2] = {a, other_lib(runner, a)}, chosen = -1;
+        for (int i = 0; i < 2 && chosen < 0; i++) {
+            if (cand[i] < 0) continue;
+            Undo u;
+            undo_save(&u);
+            int ok = game_play_move(&g, 0, cand[i] % g.size, cand[i] / g.size) == MOVE_OK;
+            if (ok && g.board[runner] == 2) {
+                int esc;
+                ok = libs_at(runner, &esc) == 1 && game_play_move(&g, 1, esc % g.size, esc / g.size) == MOVE_OK &&
+                     libs_at(runner, &esc) <= 2;
+            }
+            undo_load(&u);
+            if (ok) chosen = cand[i];
+        }
+        if (chosen < 0) break;
+        game_play_move(&g, 0, chosen % g.size, chosen / g.size);
+        seq[n++] = chosen;
+    }
+    return n;
+}
+
+static void build_corpus(void) {
+    fresh(9);
+    save(&empty9, "empty9");
+    fresh(19);
+    save(&empty19, "empty19");
+
+    // 150 random moves, then 150 more as the replay sequence
+    fresh(19);
+    int warm[150];
+    random_game(warm, 150, 20240601u);
+    save(&midgame, "midgame19");
+    midgame.nseq = random_game(midgame.seq, 150, 777u);
+
+    // comb: black rows 0,2,..,18 over x 0..16 joined by column 0; white
+    // rows 1,3,..,17 over x 2..18; free points at x 17/18 and x 1
+    fresh(19);
+    for (int y = 0; y < 19; y++) {
+        put(0, y, 1);
+        for (int x = 0; x < 19; x++) {
+            if (y % 2 == 0 && x <= 16) put(x, y, 1);
+            if (y % 2 == 1 && x >= 2) put(x, y, 2);
+        }
+    }
+    save(&chain, "chain19");
+
+    // ladder: a white stone at (3,3) in atari with its one liberty at
+    // (4,3); the chase runs diagonally to the lower right edge
+    fresh(19);
+    put(3, 3, 2);
+    put(2, 3, 1);
+    put(3, 2, 1);
+    put(4, 2, 1);
+    put(3, 4, 1);
+    g.to_move = 1;
+    save(&ladder, "ladder19");
+    ladder.nseq = ladder_game(ladder.seq, 3 * 19 + 3);
+
+    // white fills the inside but the centre, black the edge ring:
+    // black at the centre captures 288 stones
+    fresh(19);
+    for (int y = 0; y < 19; y++)
+        for (int x = 0; x < 19; x++) put(x, y, x == 0 || y == 0 || x == 18 || y == 18 ? 1 : 2);
+    put(9, 9, 0);
+    save(&capture, "capture19");
+
+    // black just took a ko at (2,1); white retaking at (1,1) is refused
+    fresh(9);
+    put(1, 0, 1);
+    put(0, 1, 1);
+    put(1, 2, 1);
+    put(2, 0, 2);
+    put(3, 1, 2);
+    put(2, 2, 2);
+    put(1, 1, 2);
+    game_play_move(&g, 0, 2, 1);
+    save(&ko, "ko9");
+}
+
+static unsigned corpus_checksum(void) {
+    const Position *all[] = {&empty9, &empty19, &midgame, &chain, &ladder, &capture, &ko};
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        const Position *p = all[i];
+        int n = p->size * p->size;
+        for (int k = 0; k < n; k++) h = (h ^ p->board[k]) * 16777619u;
+        for (int k = 0; k < n; k++) h = (h ^ p->prev[k]) * 16777619u;
+        for (int k = 0; k < p->nseq; k++) h = (h ^ (unsigned)p->seq[k]) * 16777619u;
+    }
+    return h;
+}
+
+// ---- cases ----
+
+// every empty point for the side to move; legal moves are undone
+static long run_sweep(const Position *p) {
+    load(p);
+    int n = p->size * p->size, legal = 0;
+    long ops = 0;
+    for (int k = 0; k < n; k++) {
+        if (p->board[k]) continue;
+        ops++;
+        if (game_play_move(&g, p->to_move, k % p->size, k / p->size) == MOVE_OK) {
+            legal++;
+            memcpy(g.board, p->board, (size_t)n);
+            memcpy(g.prev_board, p->prev, (size_t)n);
+        }
+    }
+    sink += legal;
+    return ops;
+}
+
+// the undo alone, to subtract from the sweeps
+static long run_restore(const Position *p) {
+    int n = p->size * p->size;
+    for (int k = 0; k < 64; k++) {
+        memcpy(g.board, p->board, (size_t)n);
+        memcpy(g.prev_board, p->prev, (size_t)n);
+        sink += g.board[k];
+    }
+    return 64;
+}
+
+// the position's continuation, move list kept as in a server game
+static long run_replay(const Position *p) {
+    load(p);
+    g.to_move = p->to_move;
+    uint16_t moves[MAX_SEQ];
+    g.moves = moves;
+    g.moves_cap = MAX_SEQ;
+    for (int i = 0; i < p->nseq; i++) {
+        int k = p->seq[i];
+        if (k < 0) game_pass(&g);
+        else sink += game_play_move(&g, g.to_move, k % p->size, k / p->size);
+    }
+    g.moves = NULL;
+    g.moves_cap = 0;
+    return p->nseq;
+}
+
+static long run_collect(const Position *p) {
+    load(p);
+    int n = p->size * p->size, stones[BOARD_CELLS_MAX];
+    long ops = 0;
+    for (int k = 0; k < n; k++) {
+        if (!p->board[k]) continue;
+        int libs;
+        sink += collect_group(&g, k % p->size, k / p->size, p->board[k], stones, BOARD_CELLS_MAX, &libs) + libs;
+        ops++;
+    }
+    return ops;
+}
+
+static long run_capture(const Position *p) {
+    load(p);
+    sink += game_play_move(&g, 0, 9, 9);
+    sink += g.cap_black;
+    return 1;
+}
+
+static long run_ko(const Position *p) {
+    load(p);
+    for (int i = 0; i < 16; i++) sink += game_play_move(&g, 1, 1, 1);
+    return 16;
+}
+
+// ---- harness ----
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void measure(const Case *c, int reps, double min_sec) {
+    // warm up and size a repetition: double the batches until it lasts min_sec
+    long batches = 1, ops = 0;
+    for (;;) {
+        double t0 = now_sec();
+        ops = 0;
+        for (long b = 0; b < batches; b++) ops += c->run(c->pos);
+        if (now_sec() - t0 >= min_sec) break;
+        batches *= 2;
+    }
+
+    double ns[256];
+    if (reps > 256) reps = 256;
+    for (int r = 0; r < reps; r++) {
+        double t0 = now_sec();
+        ops = 0;
+        for (long b = 0; b < batches; b++) ops += c->run(c->pos);
+        ns[r] = (now_sec() - t0) * 1e9 / (double)ops;
+    }
+    double mean = 0, var = 0;
+    for (int r = 0; r < reps; r++) mean += ns[r];
+    mean /= reps;
+    for (int r = 0; r < reps; r++) var += (ns[r] - mean) * (ns[r] - mean);
+    double sd = reps > 1 ? sqrt(var / (reps - 1)) : 0;
+    qsort(ns, (size_t)reps, sizeof(double), cmp_double);
+    double median = reps % 2 ? ns[reps / 2] : (ns[reps / 2 - 1] + ns[reps / 2]) / 2;
+    printf("%-20s %-10s %10ld %10.1f %10.1f %10.1f %6.1f%% %12.0f\n", c->name, c->unit, ops, median, ns[0], mean,
+           mean > 0 ? 100.0 * sd / mean : 0.0, 1e9 / median);
+}
+
+int main(int argc, char **argv) {
+    int reps = 15;
+    double min_ms = 50;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) min_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--reps N] [--min-ms N] [--filter SUBSTR]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1 || min_ms <= 0) {
+        fprintf(stderr, "--reps and --min-ms must be positive\n");
+        return 1;
+    }
+
+    build_corpus();
+    const Case cases[] = {
+        {"sweep/empty9", &empty9, run_sweep, "point"},
+        {"sweep/empty19", &empty19, run_sweep, "point"},
+        {"sweep/midgame19", &midgame, run_sweep, "point"},
+        {"sweep/chain19", &chain, run_sweep, "point"},
+        {"restore/19", &empty19, run_restore, "restore"},
+        {"replay/midgame19", &midgame, run_replay, "move"},
+        {"replay/ladder19", &ladder, run_replay, "move"},
+        {"collect/midgame19", &midgame, run_collect, "call"},
+        {"collect/chain19", &chain, run_collect, "call"},
+        {"capture/288", &capture, run_capture, "move"},
+        {"ko/refuse", &ko, run_ko, "move"},
+    };
+
+    printf("corpus %08x: midgame %d moves, ladder %d moves, %d reps of >= %.0f ms\n", corpus_checksum(),
+           midgame.nseq, ladder.nseq, reps, min_ms);
+    printf("%-20s %-10s %10s %10s %10s %10s %7s %12s\n", "case", "op", "ops/rep", "median ns", "min ns",
+           "mean ns", "rsd", "ops/s");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (filter && !strstr(cases[i].name, filter)) continue;
+        measure(&cases[i], reps, min_ms / 1000.0);
+    }
+    return 0;
+}
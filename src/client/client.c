@@ -234,17 +234,19 @@ int main()
             {
                 int size;
                 char pref;
+                int vs_bot = 0;
                 char game_name[64] = {0};
                 
-                if (host_popup(&size, &pref, game_name))
+                if (host_popup(&size, &pref, game_name, &vs_bot))
                 {
                     char cmd[128];
+                    const char *verb = vs_bot ? "HOST_BOT" : "HOST";
                     
                     // Jeśli użytkownik podał nazwę, wyślij ją do serwera
                     if (game_name[0]) {
-                        snprintf(cmd, sizeof(cmd), "HOST %d %c %s", size, pref, game_name);
+                        snprintf(cmd, sizeof(cmd), "%s %d %c %s", verb, size, pref, game_name);
                     } else {
-                        snprintf(cmd, sizeof(cmd), "HOST %d %c", size, pref);
+                        snprintf(cmd, sizeof(cmd), "%s %d %c", verb, size, pref);
                     }
                     
                     my_game_size = size;
@@ -319,13 +321,13 @@ int main()
                         int ry = ev.y - game_inner_y0;
                         int rx = ev.x - game_inner_x0;
 
-                        // content lines are even (0,2,4...) because separators are odd
-                        if (ry >= 0 && rx >= 0 && (ry % 2 == 0))
+                        // with separators content lines are even (0,2,4...); compact boards use every line
+                        if (ry >= 0 && rx >= 0 && (ry % game_row_step == 0))
                         {
-                            int y = ry / 2;
+                            int y = game_view_y0 + ry / game_row_step;
 
-                            // each cell is (cell_w=3) + 1 separator
-                            int x = rx / 4;
+                            // each cell is cell_w + 1 separator
+                            int x = rx / (game_cell_w + 1);
 
                             if (x >= 0 && x < my_game_size && y >= 0 && y < my_game_size)
                             {
@@ -41,7 +41,7 @@ void pump_network(Screen *screen) {
             return;
         }
 
-        char line[1024];
+        char line[NET_LINE_MAX];
         while (net_next_line(&net, line, sizeof(line))) {
             parse_server_line(line, screen);
         }
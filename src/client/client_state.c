@@ -26,6 +26,8 @@ int main_menu_y0 = 0;      // main menu origin y
 
 int game_box_top = 0, game_box_left = 0; // board box pos
 int game_inner_y0 = 0, game_inner_x0 = 0; // board content origin
+int game_cell_w = 3, game_row_step = 2;   // board cell geometry
+int game_view_y0 = 0;                     // first board row shown
 
 int ui_enabled_colours = 1; // 1 if colours enabled
 
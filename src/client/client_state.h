@@ -31,6 +31,9 @@ extern int game_box_top;      // board box top
 extern int game_box_left;     // board box left
 extern int game_inner_y0;     // board content origin y
 extern int game_inner_x0;     // board content origin x
+extern int game_cell_w;       // board cell width in columns
+extern int game_row_step;     // screen lines per board row (2 with separators, 1 compact)
+extern int game_view_y0;      // first board row shown (large boards scroll)
 
 extern int ui_enabled_colours; // 1 if colours enabled
 
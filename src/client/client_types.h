@@ -18,4 +18,4 @@ typedef struct {
     char nickname[32];
 } Settings;
 
-#define BOARD_MAX_SIZE 19
+#define BOARD_MAX_SIZE 32
@@ -378,14 +378,27 @@ void draw_play_lobby(void)
     refresh();
 }
 
-int host_popup(int *out_size, char *out_pref, char *out_game_name)
+// board sizes offered by the host popup
+static const int host_sizes[] = {7, 9, 11, 13, 15, 17, 19, 21, 25, 32};
+
+static int step_board_size(int size, int dir)
+{
+    const int n = (int)(sizeof(host_sizes) / sizeof(host_sizes[0]));
+    int i = 0;
+    while (i < n - 1 && host_sizes[i] < size) i++;
+    i = (i + dir + n) % n;
+    return host_sizes[i];
+}
+
+int host_popup(int *out_size, char *out_pref, char *out_game_name, int *out_bot)
 {
     int size = 9;
     int sel = 2; // 0=B, 1=W, 2=R
+    int vs_bot = 0;
     char game_name[64] = "";
 
     int w = 50;
-    int h = 15;
+    int h = 17;
     int y = (LINES - h) / 2;
     int x = (COLS - w) / 2;
     if (y < 0) y = 0;
@@ -432,8 +445,13 @@ int host_popup(int *out_size, char *out_pref, char *out_game_name)
         mvwprintw(win, 10, 2, "%s", game_name[0] ? game_name : "<default: your_nick game>");
         wattroff(win, COLOR_PAIR(3));
 
+        mvwprintw(win, 12, 2, "Opponent: ");
+        wattron(win, A_BOLD);
+        wprintw(win, "%s", vs_bot ? "BOT" : "HUMAN");
+        wattroff(win, A_BOLD);
+
         wattron(win, COLOR_PAIR(6));
-        mvwprintw(win, 12, 2, "N=Edit name  Enter=OK  Q/ESC=Cancel");
+        mvwprintw(win, 14, 2, "N=Edit name  O=Opponent  Enter=OK  Q/ESC=Cancel");
         wattroff(win, COLOR_PAIR(6));
 
         wrefresh(win);
@@ -452,6 +470,7 @@ int host_popup(int *out_size, char *out_pref, char *out_game_name)
         {
             *out_size = size;
             *out_pref = (sel == 0 ? 'B' : (sel == 1 ? 'W' : 'R'));
+            *out_bot = vs_bot;
             
             // Skopiuj nazwę jeśli została ustawiona
             if (game_name[0]) {
@@ -467,6 +486,12 @@ int host_popup(int *out_size, char *out_pref, char *out_game_name)
             return 1;
         }
 
+        if (ch == 'o' || ch == 'O')
+        {
+            vs_bot = !vs_bot;
+            continue;
+        }
+
         if (ch == 'n' || ch == 'N')
         {
             // Edycja nazwy gry
@@ -502,13 +527,11 @@ int host_popup(int *out_size, char *out_pref, char *out_game_name)
 
         if (ch == 'a' || ch == 'A' || ch == KEY_LEFT)
         {
-            size -= 2;
-            if (size < 7) size = 19;
+            size = step_board_size(size, -1);
         }
         else if (ch == 'd' || ch == 'D' || ch == KEY_RIGHT)
         {
-            size += 2;
-            if (size > 19) size = 7;
+            size = step_board_size(size, +1);
         }
 
         if (ch == 'w' || ch == 'W' || ch == KEY_UP)
@@ -555,9 +578,11 @@ void apply_theme(int theme)
     }
 }
 
-static void draw_board_grid(int top, int left, int size, int cell_w)
+// Draws board rows y0..y0+rows-1. row_step 2 puts a separator line between
+// rows; row_step 1 is the compact layout used when the board is too tall.
+static void draw_board_grid(int top, int left, int size, int cell_w, int row_step, int y0, int rows)
 {
-    const int board_h = 2 * size + 1;
+    const int board_h = row_step * rows + (row_step == 2 ? 1 : 2);
     const int board_w = 1 + size*(cell_w + 1);
 
     const char *TL = "┌", *TR = "┐", *BL = "└", *BR = "┘";
@@ -595,9 +620,10 @@ static void draw_board_grid(int top, int left, int size, int cell_w)
         addstr(x == size - 1 ? TR : TJ);
     }
 
-    for (int y = 0; y < size; y++)
+    for (int r = 0; r < rows; r++)
     {
-        int ry = top + 1 + y * 2;
+        int y = y0 + r;
+        int ry = top + 1 + r * row_step;
 
         mvaddstr(ry, left, VT);
         for (int x = 0; x < size; x++)
@@ -620,13 +646,13 @@ static void draw_board_grid(int top, int left, int size, int cell_w)
             if (g_board[idx] == 1)
             {
                 attron(COLOR_PAIR(4) | A_BOLD);
-                mvaddch(ry, cx + 1, 'B');
+                mvaddch(ry, cx + cell_w / 2, 'B');
                 attroff(COLOR_PAIR(4) | A_BOLD);
             }
             else if (g_board[idx] == 2)
             {
                 attron(COLOR_PAIR(2) | A_BOLD);
-                mvaddch(ry, cx + 1, 'W');
+                mvaddch(ry, cx + cell_w / 2, 'W');
                 attroff(COLOR_PAIR(2) | A_BOLD);
             }
 
@@ -637,7 +663,7 @@ static void draw_board_grid(int top, int left, int size, int cell_w)
             mvaddstr(ry, cx + cell_w, VT);
         }
 
-        if (y != size - 1)
+        if (row_step == 2 && r != rows - 1)
         {
             int sy = ry + 1;
             mvaddstr(sy, left, LJ);
@@ -665,6 +691,9 @@ static void draw_board_grid(int top, int left, int size, int cell_w)
     game_inner_x0 = left + 1;
     game_box_top = top;
     game_box_left = left;
+    game_cell_w = cell_w;
+    game_row_step = row_step;
+    game_view_y0 = y0;
 }
 
 static void draw_info_panel(int panel_x, int panel_y, int panel_w, int panel_h)
@@ -760,7 +789,26 @@ void draw_game_screen(void)
 
     int cell_w = 3;
     int board_w = 1 + my_game_size * (cell_w + 1);
-    const int board_h = 2 * my_game_size + 1;
+
+    // Zarezerwuj miejsce na dolną linijkę i ramkę
+    int available_h = LINES - 1;
+    int row_step = 2;
+    int rows = my_game_size;
+    int board_h = 2 * rows + 1;
+    if (board_h + 2 > available_h)
+    {
+        // compact rows; if that is still too tall, show a window around the cursor
+        row_step = 1;
+        if (rows + 4 > available_h) rows = available_h - 4;
+        if (rows < 1) rows = 1;
+        board_h = rows + 2;
+    }
+
+    int view_y0 = game_view_y0;
+    if (cur_y < view_y0) view_y0 = cur_y;
+    if (cur_y >= view_y0 + rows) view_y0 = cur_y - rows + 1;
+    if (view_y0 > my_game_size - rows) view_y0 = my_game_size - rows;
+    if (view_y0 < 0) view_y0 = 0;
     
     // Panel info - taki sam jak plansza
     int panel_w = 24;
@@ -785,13 +833,11 @@ void draw_game_screen(void)
     int start_x = (COLS - total_w) / 2;
     if (start_x < 1) start_x = 1;
     
-    // Zarezerwuj miejsce na dolną linijkę
-    int available_h = LINES - 1;
     int start_y = (available_h - (board_h + 2)) / 2;
     if (start_y < 1) start_y = 1;
     
     // Rysuj planszę z ramką
-    draw_board_grid(start_y + 1, start_x + 1, my_game_size, cell_w);
+    draw_board_grid(start_y + 1, start_x + 1, my_game_size, cell_w, row_step, view_y0, rows);
     
     // Rysuj panel info na tej samej wysokości co plansza
     int panel_x = start_x + board_w + 4;
@@ -804,6 +850,8 @@ void draw_game_screen(void)
     // Dolna wskazówka zawsze widoczna
     attron(COLOR_PAIR(6));
     mvprintw(LINES - 1, 1, "Arrows/WASD: move | Enter: place | P: pass | Q/ESC: exit");
+    if (rows < my_game_size)
+        printw(" | rows %d-%d/%d", view_y0 + 1, view_y0 + rows, my_game_size);
     attroff(COLOR_PAIR(6));
 
     refresh();
@@ -1,9 +1,11 @@
 #pragma once 
 #include <stddef.h>
 
+#define NET_LINE_MAX 4096   // longest server line (a 32x32 BOARD is ~1.1 KB)
+
 typedef struct {
     int fd;
-    char buf[4096];
+    char buf[NET_LINE_MAX];
     size_t len;
 } Net;
 
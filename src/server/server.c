@@ -5,13 +5,25 @@
 //   SUB           -> subscribe to lobby broadcasts
 //   GAMES         -> list games
 //   HOST <size> <B|W|R>
+//   HOST_BOT <size> <B|W|R> -> play against the built-in engine
 //   JOIN <id>
 //   MOVE <id> <x> <y>
 //   PASS <id>
-//   CANCEL
+//   SEEK <size> [B|W|R] -> wait for an opponent of similar rating
+//   CANCEL        -> cancel an open game or a seek
+//   STATS         -> counters, gauges, memory per subsystem and latency percentiles
+//   HISTORY <nick> [offset limit] -> archived games of a player, newest first
+//   GAME_RECORD <id> [SGF] -> an archived game, raw archive record or SGF
+//   RATING <nick> -> Glicko-2 rating, RD, volatility, games, wins
+//   PING [token]  -> PONG [token], after everything sent before it
 //   QUIT          -> disconnect
-// Run:   ./server 9000
-// gcc server.c server_game.c server_proto.c -o server
+// Run:   ./server 9000 [--bot-ms N] [--bot-playouts N] [--bot-threads N] [--bot-policy light|pattern]
+//                   [--bot-tt-mb N] [--bot-cpu N] [--book FILE] [--journal FILE] [--snapshot-secs N]
+//                   [--archive DIR] [--admin-port N]   (Prometheus text at 127.0.0.1:N/metrics)
+//                   [--slow-log FILE] [--slow-ms N]    (commands and loop iterations over N ms)
+//                   [--dash FILE]                       (snapshots for tools/admin_dash, e.g. /dev/shm/go.dash)
+//                   [--capture FILE] [--seed N]         (inbound traffic for tools/replay; rand() seed)
+// gcc -O2 -pthread server.c server_game.c server_rules.c server_proto.c server_playout.c server_pattern.c server_tt.c server_bot.c server_ring.c server_botpool.c server_book.c server_boardpool.c server_rxpool.c server_journal.c server_snapshot.c server_crc.c server_archive.c server_history.c server_rating.c server_match.c server_fdtab.c server_metrics.c server_admin.c server_slowlog.c server_dash.c server_capture.c server_io.c -lm -o server
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,29 +39,52 @@
 #include <time.h>
 #include "server_game.h"
 #include "server_proto.h"
+#include "server_bot.h"
+#include "server_botpool.h"
+#include "server_boardpool.h"
+#include "server_rxpool.h"
+#include "server_tt.h"
+#include "server_book.h"
+#include "server_journal.h"
+#include "server_archive.h"
+#include "server_history.h"
+#include "server_rating.h"
+#include "server_match.h"
+#include "server_metrics.h"
+#include "server_admin.h"
+#include "server_slowlog.h"
+#include "server_dash.h"
+#include "server_capture.h"
+#include "server_io.h"
+#include "server_fdtab.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-static const char* nick_of_fd(Client clients[], int fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd == fd) return clients[i].nick;
-    }
-    return "?";
-}
+static BotConfig bot_cfg;
+static int bot_cpu;  // cores the bot pool may use, bounds admitted bot games
+static int loop_lines; // command lines handled in this loop iteration
+static uint32_t conn_seq; // last Client.conn_id handed out
+static Client client_table[MAX_CLIENTS];
+static int listen_fd = -1, bot_fd = -1;
+static bool timed_jobs;   // journal snapshots need a wakeup at least once a second
+static int64_t last_pass;
+static int bot_retry[MAX_GAMES];   // games whose search the pool refused
+static int nbot_retry;
 
 // send all data in s of length n
 // NOTE: not static, because server_proto.c uses it too
 ssize_t send_str(int fd, const char *s) {
     size_t n = strlen(s);
     while (n > 0) {
-        ssize_t w = send(fd, s, n, 0);
+        ssize_t w = server_io->send(fd, s, n);
         if (w < 0) {
             if (errno == EINTR) continue;
             return -1;
         }
         s += (size_t)w;
         n -= (size_t)w;
+        metrics_bytes_out((size_t)w);
     }
     return 0;
 }
@@ -65,23 +100,56 @@ static void send_fmt(int fd, const char *prefix, const char *body) {
 static void client_init(Client *c) {
     c->fd = -1;
     c->nick[0] = '\0';
+    c->buf = NULL;
     c->len = 0;
+    c->cap = 0;
     c->subscribed = false;
+    c->conn_id = 0;
+    c->closing = NULL;
     memset(&c->addr, 0, sizeof(c->addr));
 }
 
+// client table index of each open fd, -1 if none; grown at accept
+static int *fd_slots;
+static int fd_slots_cap;
+
+static int reserve_fd_slot(int fd) {
+    int *t = fdtab_reserve(fd_slots, &fd_slots_cap, sizeof(*fd_slots), 0xff, fd);
+    if (!t) return -1;
+    fd_slots = t;
+    return 0;
+}
+
+static Client *client_by_fd(Client clients[], int fd) {
+    if (fd < 0 || fd >= fd_slots_cap || fd_slots[fd] < 0) return NULL;
+    Client *c = &clients[fd_slots[fd]];
+    return c->fd == fd ? c : NULL;
+}
+
 // Add new client, return index or -1 if full
 static int add_client(Client clients[], int fd, struct sockaddr_in *peer) {
+    // every per-fd table, so nothing later has to grow one mid-command
+    if (reserve_fd_slot(fd) < 0 || game_reserve_fd(fd) < 0 || match_reserve_fd(fd) < 0) return -1;
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (clients[i].fd == -1) {
             clients[i].fd = fd;
-            clients[i].len = 0;
+            fd_slots[fd] = i;
             clients[i].addr = *peer;
             clients[i].subscribed = false;
 
+            clients[i].conn_id = ++conn_seq;
+            capture_conn_open(clients[i].conn_id);
+
             // default nick: u<fd>
             snprintf(clients[i].nick, sizeof(clients[i].nick), "u%d", fd);
 
+            if (dash_enabled()) {
+                char ip[INET_ADDRSTRLEN] = {0}, note[DASH_NOTE_SIZE];
+                inet_ntop(AF_INET, &peer->sin_addr, ip, sizeof(ip));
+                snprintf(note, sizeof(note), "CONNECT %s %s:%d", clients[i].nick, ip, ntohs(peer->sin_port));
+                dash_note(note);
+            }
+
             return i;
         }
     }
@@ -105,17 +173,86 @@ static void list_clients(Client clients[], int to_fd) {
 
 // Close client connection and free slot
 static void client_close(Client *c) {
-    if (c->fd >= 0) close(c->fd);
+    if (dash_enabled() && c->fd >= 0) {
+        char note[DASH_NOTE_SIZE];
+        snprintf(note, sizeof(note), "DISCONNECT %s", c->nick);
+        dash_note(note);
+    }
+    match_cancel(c->fd);
+    if (c->fd >= 0) capture_conn_close(c->conn_id);
+    if (c->fd >= 0) server_io->close(c->fd);
+    if (c->fd >= 0 && c->fd < fd_slots_cap) fd_slots[c->fd] = -1;
+    rxbuf_free(c->buf, c->cap);
     client_init(c);
 }
 
-void broadcast_subscribed(Client clients[], const char *msg) {
+// ---- deferred closes ----
+// A client that quits, hangs up or fails a send is marked and queued, and
+// stays in the table until close_pending() at the end of the loop pass:
+// nothing is torn down under a caller that is still using the client or
+// its games, and the lobby events of a mass disconnect go out as one batch
+// per subscriber instead of one send per removed game.
+
+static int close_queue[MAX_CLIENTS];
+static int nclosing;
+static char *event_batch;            // lobby events held back during close_pending
+static size_t batch_len, batch_cap;
+static int batching;
+
+static void queue_close(Client *c, const char *reason) {
+    if (c->fd < 0 || c->closing) return;
+    c->closing = reason;
+    close_queue[nclosing++] = (int)(c - client_table);
+}
+
+void close_client_later(Client clients[], int fd, const char *reason) {
+    Client *c = client_by_fd(clients, fd);
+    if (c) queue_close(c, reason);
+}
+
+static void send_subscribed(Client clients[], const char *msg) {
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd != -1 && clients[i].subscribed) {
-            if (send_str(clients[i].fd, msg) < 0) {
-                remove_games_of_client(clients, clients[i].fd, "DISCONNECT");
-                client_close(&clients[i]);
-            }
+        if (clients[i].fd != -1 && clients[i].subscribed && !clients[i].closing) {
+            if (send_str(clients[i].fd, msg) < 0) queue_close(&clients[i], "DISCONNECT");
+        }
+    }
+}
+
+void broadcast_subscribed(Client clients[], const char *msg) {
+    // every lobby event passes through here, so it is also the dashboard feed
+    if (dash_enabled()) dash_note(strncmp(msg, "EVENT ", 6) == 0 ? msg + 6 : msg);
+    size_t n = strlen(msg);
+    if (batching && batch_len + n + 1 > batch_cap) {
+        size_t cap = batch_cap ? batch_cap * 2 : 4096;
+        while (cap < batch_len + n + 1) cap *= 2;
+        char *b = realloc(event_batch, cap);
+        if (b) {
+            event_batch = b;
+            batch_cap = cap;
+        }
+    }
+    if (batching && batch_len + n + 1 <= batch_cap) {
+        memcpy(event_batch + batch_len, msg, n + 1);
+        batch_len += n;
+        return;
+    }
+    send_subscribed(clients, msg);
+}
+
+// close everyone queued, and whoever the batched events then fail to reach
+static void close_pending(Client clients[]) {
+    while (nclosing) {
+        batching = 1;
+        for (int k = 0; k < nclosing; k++) {   // removing games may queue more
+            Client *c = &clients[close_queue[k]];
+            remove_games_of_client(clients, c->fd, c->closing);
+            client_close(c);
+        }
+        nclosing = 0;
+        batching = 0;
+        if (batch_len) {
+            batch_len = 0;
+            send_subscribed(clients, event_batch);
         }
     }
 }
@@ -135,6 +272,275 @@ static void rstrip(char *s) {
     }
 }
 
+// NICKS line to fd, or to both players if fd is -1
+static void send_nicks(Game *g, int fd) {
+    const char *black = g->host_color == 0 ? g->host_nick : g->guest_nick;
+    const char *white = g->host_color == 0 ? g->guest_nick : g->host_nick;
+
+    char nn[128];
+    snprintf(nn, sizeof(nn), "NICKS %d %s %s\n", g->id, black, white);
+    if (fd != -1) {
+        send_str(fd, nn);
+        return;
+    }
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+    send_str(host, nn);
+    if (guest != -1) send_str(guest, nn);
+}
+
+// START/BOARD/NICKS to both players and a lobby event
+static void start_game(Client clients[], Game *g) {
+    g->status = GAME_RUNNING;
+
+    const char *hc = (g->host_color == 0) ? "BLACK" : "WHITE";
+    const char *gc = (g->host_color == 0) ? "WHITE" : "BLACK";
+
+    game_clear_board(g);
+    journal_join(g);
+
+    // START do obu
+    char sh[64], sg[64];
+    snprintf(sh, sizeof(sh), "START %d %d %s\n", g->id, g->size, hc);
+    snprintf(sg, sizeof(sg), "START %d %d %s\n", g->id, g->size, gc);
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+    send_str(host, sh);
+    if (guest != -1) send_str(guest, sg);
+
+    // pierwsza plansza (pusta)
+    send_board(g);
+    send_captures(g);
+
+    send_nicks(g, -1);
+
+    char ev[64];
+    snprintf(ev, sizeof(ev), "EVENT GAME_STARTED %d\n", g->id);
+    broadcast_subscribed(clients, ev);
+}
+
+static int64_t now_ms(void) {
+    return server_io->now_ms();
+}
+
+int64_t wall_ms(void) {
+    return server_io->wall_ms();
+}
+
+static void fill_gauges(Client clients[], MetricsGauges *g) {
+    memset(g, 0, sizeof(*g));
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd != -1) g->clients++;
+    }
+    g->games = game_total();
+    g->bot_games = bot_game_count();
+    g->bot_queue = botpool_pending();
+    g->seeks = match_waiting();
+    JournalStats js;
+    journal_stats(&js);
+    g->journal_records = js.records;
+    g->journal_batches = js.batches;
+    ArchiveStats as;
+    archive_stats(&as);
+    g->archive_games = as.games;
+    g->archive_bytes = as.bytes;
+    SlowlogStats ss;
+    slowlog_stats(&ss);
+    g->slow_logged = ss.logged;
+    g->slow_dropped = ss.dropped;
+    g->mem[MEM_CLIENTS] = sizeof(client_table) + (uint64_t)fd_slots_cap * sizeof(int);
+    g->mem[MEM_RXBUFS] = rxbuf_pool_bytes();
+    g->mem[MEM_GAMES] = game_table_bytes();
+    g->mem[MEM_BOARDS] = board_pool_bytes();
+    g->mem[MEM_MOVES] = game_moves_bytes();
+    g->mem[MEM_MATCH] = match_bytes();
+    g->mem[MEM_RATINGS] = rating_bytes();
+    g->mem[MEM_TT] = tt_bytes();
+    g->mem[MEM_BOT] = botpool_tree_bytes();
+}
+
+static void publish_dash(Client clients[]) {
+    MetricsGauges mg;
+    fill_gauges(clients, &mg);
+    DashSnapshot *s = dash_begin();
+    s->uptime_s = metrics_uptime_s();
+    s->bot_games = (uint32_t)mg.bot_games;
+    s->bot_queue = (uint32_t)mg.bot_queue;
+    s->seeks = (uint32_t)mg.seeks;
+    s->journal_records = mg.journal_records;
+    s->archive_games = mg.archive_games;
+    s->slow_logged = mg.slow_logged;
+    s->slow_dropped = mg.slow_dropped;
+
+    for (int i = 0; i < MAX_CLIENTS && s->nplayers < DASH_MAX_PLAYERS; i++) {
+        const Client *c = &clients[i];
+        if (c->fd == -1) continue;
+        DashPlayer *p = &s->players[s->nplayers];
+        p->fd = c->fd;
+        p->state = match_seeking(c->fd) ? DASH_SEEKING : DASH_IDLE;
+        p->subscribed = c->subscribed;
+        int running, games = games_of_fd(c->fd, &running);
+        p->games = (uint16_t)games;
+        if (running) p->state = DASH_PLAYING;
+        else if (games) p->state = DASH_HOSTING;
+        p->port = ntohs(c->addr.sin_port);
+        snprintf(p->nick, sizeof(p->nick), "%s", c->nick);
+        inet_ntop(AF_INET, &c->addr.sin_addr, p->ip, sizeof(p->ip));
+        s->nplayers++;
+    }
+
+    int n = game_total();
+    for (int i = 0; i < n && s->ngames < DASH_MAX_GAMES; i++) {
+        const Game *g = game_at(i);
+        DashGame *d = &s->games[s->ngames++];
+        d->id = g->id;
+        d->size = (uint8_t)g->size;
+        d->running = g->status == GAME_RUNNING;
+        d->vs_bot = (uint8_t)g->vs_bot;
+        d->to_move = (uint8_t)g->to_move;
+        d->ply = g->ply;
+        d->cap_black = (uint16_t)g->cap_black;
+        d->cap_white = (uint16_t)g->cap_white;
+        snprintf(d->host, sizeof(d->host), "%s", g->host_nick);
+        snprintf(d->guest, sizeof(d->guest), "%s", g->guest_nick);
+    }
+    dash_publish();
+}
+
+static int render_admin(FILE *f, const char *path, void *arg) {
+    if (strcmp(path, "/metrics") != 0) {
+        fprintf(f, "not found; try /metrics\n");
+        return 404;
+    }
+    MetricsGauges g;
+    fill_gauges(arg, &g);
+    metrics_write_prometheus(f, &g);
+    return 200;
+}
+
+// colour preference for host h against guest g: h's own, else the
+// opposite of g's
+static char host_pref(const Seek *h, const Seek *g) {
+    if (h->color != 'R') return h->color;
+    if (g->color == 'B') return 'W';
+    if (g->color == 'W') return 'B';
+    return 'R';
+}
+
+// A pair from the matchmaking pass: host a game for one seeker, seat the
+// other and start it, like HOST followed by JOIN.
+static void start_match(const Seek *a, const Seek *b, void *arg) {
+    Client *clients = arg;
+    if (!client_by_fd(clients, a->fd) || !client_by_fd(clients, b->fd)) return;
+
+    // a may have been given a restored game to host meanwhile
+    int gid = create_game(clients, a->fd, a->size, host_pref(a, b), NULL, 0);
+    if (gid == -2) {
+        const Seek *t = a;
+        a = b;
+        b = t;
+        gid = create_game(clients, a->fd, a->size, host_pref(a, b), NULL, 0);
+    }
+    if (gid < 0) {
+        send_str(a->fd, "ERR match failed\n");
+        send_str(b->fd, "ERR match failed\n");
+        return;
+    }
+    Game *g = find_game_by_id(gid);
+    game_seat_guest(g, b->fd, client_by_fd(clients, b->fd)->nick);
+    start_game(clients, g);
+}
+
+// If it is the engine's turn in game gid, queue a search on the bot pool.
+// Under load the per-move time budget shrinks so queued games still get
+// answered quickly; the pool splits its cores between running searches.
+// A refused search is counted and tried again on the pool's next wakeup
+// (or within a second when nothing is in flight); the game just waits.
+static void bot_reply(int gid) {
+    Game *g = find_game_by_id(gid);
+    if (!g || !g->vs_bot || g->status != GAME_RUNNING) return;
+
+    int bot_color = (g->host_color == 0 ? 1 : 0);
+    if (g->to_move != bot_color) return;
+
+    BotConfig cfg = bot_cfg;
+    int pending = botpool_pending();
+    int workers = botpool_workers();
+    if (cfg.time_ms > 0 && pending >= workers) {
+        cfg.time_ms = (int)((long)cfg.time_ms * workers / (pending + 1));
+        if (cfg.time_ms < BOT_MIN_MS) cfg.time_ms = BOT_MIN_MS;
+    }
+
+    if (botpool_submit(g, &cfg) < 0) {
+        metrics_bot_rejected();
+        for (int i = 0; i < nbot_retry; i++) {
+            if (bot_retry[i] == gid) return;
+        }
+        if (nbot_retry < MAX_GAMES) bot_retry[nbot_retry++] = gid;
+    }
+}
+
+static void bot_retry_pass(void) {
+    int n = nbot_retry;
+    int gids[MAX_GAMES];
+    memcpy(gids, bot_retry, (size_t)n * sizeof(int));
+    nbot_retry = 0;
+    for (int i = 0; i < n; i++) bot_reply(gids[i]);
+}
+
+// Play a finished search, unless the game ended or moved on meanwhile
+static void bot_apply(Client clients[], const BotResult *r) {
+    Game *g = find_game_by_id(r->gid);
+    if (!g || !g->vs_bot || g->status != GAME_RUNNING || g->ply != r->ply) return;
+
+    int bot_color = (g->host_color == 0 ? 1 : 0);
+    if (g->to_move != bot_color) return;
+
+    int mv = r->move;
+    if (mv >= 0 && game_play_move(g, bot_color, mv % g->size, mv / g->size) == MOVE_OK) {
+        journal_move(g->id, bot_color, mv % g->size, mv / g->size);
+        char msg[128];
+        snprintf(msg, sizeof(msg), "MOVED %d %d %d %s\n",
+                 g->id, mv % g->size, mv / g->size, color_name(bot_color));
+        send_str(game_host_fd(g), msg);
+
+        send_board_safe(clients, g);
+        g = find_game_by_id(r->gid);
+        if (g) send_captures_safe(clients, g);
+        return;
+    }
+
+    game_pass(g);
+    journal_pass(g->id, bot_color);
+    char m[64];
+    snprintf(m, sizeof(m), "PASSED %d %s\n", g->id, color_name(bot_color));
+    send_str(game_host_fd(g), m);
+    send_board(g);
+}
+
+// A player is back under a nick that restored games were waiting for:
+// seat them and send the current position (the board is not cleared).
+static void resume_games(Client *c) {
+    int gids[MAX_GAMES];
+    int n = attach_restored_games(c->fd, c->nick, gids, MAX_GAMES);
+    for (int i = 0; i < n; i++) {
+        Game *g = find_game_by_id(gids[i]);
+        if (!g) continue;
+        int myc = fd_color_in_game(g, c->fd);
+
+        char msg[64];
+        if (g->status == GAME_OPEN) {
+            snprintf(msg, sizeof(msg), "HOSTED %d %s\n", g->id, color_name(myc));
+            send_str(c->fd, msg);
+            continue;
+        }
+        snprintf(msg, sizeof(msg), "START %d %d %s\n", g->id, g->size, color_name(myc));
+        send_str(c->fd, msg);
+        send_board(g);
+        send_captures(g);
+        send_nicks(g, c->fd);
+        bot_reply(g->id);
+    }
+}
+
 // Handle a complete line from client idx
 static void handle_line(Client clients[], int idx, char *line) {
     Client *c = &clients[idx];
@@ -161,18 +567,24 @@ static void handle_line(Client clients[], int idx, char *line) {
         }
         snprintf(c->nick, sizeof(c->nick), "%s", name);
         send_fmt(c->fd, "OK ", "NICK set");
+        resume_games(c);
+        return;
+    }
+
+    if (strcmp(line, "PING") == 0 || strncmp(line, "PING ", 5) == 0) {
+        send_fmt(c->fd, "PONG", line + 4);
         return;
     }
 
     if (strcmp(line, "QUIT") == 0) {
         send_fmt(c->fd, "OK ", "bye");
-        remove_games_of_client(clients, c->fd, "QUIT");
-        client_close(c);
+        queue_close(c, "QUIT");
         return;
     }
 
     if (strcmp(line, "CANCEL") == 0) {
         int removed = cancel_open_games_of_host(clients, c->fd);
+        removed += match_cancel(c->fd);
         if (removed) send_str(c->fd, "OK CANCELLED\n");
         else send_str(c->fd, "ERR nothing to cancel\n");
         return;
@@ -184,29 +596,85 @@ static void handle_line(Client clients[], int idx, char *line) {
         return;
     }
 
+    if (strncmp(line, "HISTORY ", 8) == 0) {
+        char nick[NICK_SIZE];
+        int offset = 0, limit = HISTORY_DEFAULT_LIMIT;
+        if (sscanf(line, "HISTORY %31s %d %d", nick, &offset, &limit) < 1) {
+            send_str(c->fd, "ERR usage: HISTORY <nick> [offset limit]\n");
+            return;
+        }
+        if (!history_enabled()) { send_str(c->fd, "ERR history disabled\n"); return; }
+        if (offset < 0) { send_str(c->fd, "ERR offset must be >= 0\n"); return; }
+        if (limit <= 0 || limit > HISTORY_MAX_LIMIT) limit = HISTORY_MAX_LIMIT;
+        history_send(c->fd, nick, offset, limit);
+        return;
+    }
+
+    if (strncmp(line, "GAME_RECORD ", 12) == 0) {
+        int id;
+        char fmt[8] = "";
+        if (sscanf(line, "GAME_RECORD %d %7s", &id, fmt) < 1) {
+            send_str(c->fd, "ERR usage: GAME_RECORD <id> [SGF]\n");
+            return;
+        }
+        if (!history_enabled()) { send_str(c->fd, "ERR history disabled\n"); return; }
+        int rc = history_send_record(c->fd, id, strcmp(fmt, "SGF") == 0);
+        if (rc == -2) queue_close(c, "DISCONNECT");
+        else if (rc < 0) send_str(c->fd, "ERR no such record\n");
+        return;
+    }
+
+    if (strncmp(line, "RATING ", 7) == 0) {
+        char nick[NICK_SIZE];
+        if (sscanf(line, "RATING %31s", nick) != 1) {
+            send_str(c->fd, "ERR usage: RATING <nick>\n");
+            return;
+        }
+        if (!rating_enabled()) { send_str(c->fd, "ERR ratings disabled\n"); return; }
+        RatingEntry e;
+        rating_get(nick, &e);
+        char msg[160];
+        snprintf(msg, sizeof(msg), "RATING %s %.0f %.0f %.4f %u %u\n", nick, e.rating, e.rd, e.vol, e.games, e.wins);
+        send_str(c->fd, msg);
+        return;
+    }
+
 
 
-    if (strncmp(line, "HOST ", 5) == 0) {
+    int vs_bot = (strncmp(line, "HOST_BOT ", 9) == 0);
+    if (vs_bot || strncmp(line, "HOST ", 5) == 0) {
         int size = 0;
         char pref = 'R'; 
         char custom_name[GAME_NAME_SIZE] = {0};
+        const char *args = line + (vs_bot ? 9 : 5);
 
         // Parsuj: HOST <size> <B|W|R> [optional_name]
-        int n = sscanf(line, "HOST %d %c", &size, &pref);
+        int n = sscanf(args, "%d %c", &size, &pref);
         if (n < 1) {
-            send_str(c->fd, "ERR usage: HOST <size> <B|W|R> [name]\n");
+            send_str(c->fd, vs_bot ? "ERR usage: HOST_BOT <size> <B|W|R> [name]\n"
+                                   : "ERR usage: HOST <size> <B|W|R> [name]\n");
             return;
         }
 
         if (pref != 'B' && pref != 'W' && pref != 'R') pref = 'R';
 
-        if (size < 7 || size > 19 || size % 2 == 0) {
+        if (size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE) {
             send_str(c->fd, "ERR invalid board size\n");
             return;
         }
 
+        if (match_seeking(c->fd)) {
+            send_str(c->fd, "ERR already seeking\n");
+            return;
+        }
+
+        if (vs_bot && bot_game_count() >= bot_cpu * BOT_GAMES_PER_CPU) {
+            send_str(c->fd, "ERR bot capacity reached\n");
+            return;
+        }
+
         // Sprawdź czy jest custom nazwa
-        const char *name_start = strchr(line + 5, pref);
+        const char *name_start = strchr(args, pref);
         if (name_start) {
             name_start = strchr(name_start, ' ');
             if (name_start) {
@@ -220,7 +688,7 @@ static void handle_line(Client clients[], int idx, char *line) {
             }
         }
 
-        int gid = create_game(clients, c->fd, size, pref, custom_name);
+        int gid = create_game(clients, c->fd, size, pref, custom_name, vs_bot);
         if (gid == -1) {
             send_str(c->fd, "ERR server full\n");
             return;
@@ -229,6 +697,12 @@ static void handle_line(Client clients[], int idx, char *line) {
             send_str(c->fd, "ERR already hosting a game\n");
             return;
         }
+
+        if (vs_bot) {
+            Game *g = find_game_by_id(gid);
+            start_game(clients, g);
+            bot_reply(gid);
+        }
         return;
     }
 
@@ -243,49 +717,70 @@ static void handle_line(Client clients[], int idx, char *line) {
             return;
         }
 
-        if (g->status != GAME_OPEN || g->guest_fd != -1) {
+        if (g->status != GAME_OPEN || game_guest_fd(g) != -1) {
             send_str(c->fd, "ERR game not available\n");
             return;
         }
 
-        if (g->host_fd == c->fd) {
+        if (game_host_fd(g) == c->fd) {
             send_str(c->fd, "ERR cannot join own game\n");
             return;
         }
 
-        g->guest_fd = c->fd;
-        g->status = GAME_RUNNING;
-
-        const char *hc = (g->host_color == 0) ? "BLACK" : "WHITE";
-        const char *gc = (g->host_color == 0) ? "WHITE" : "BLACK";
-
-        game_clear_board(g);
-
-        // START do obu
-        char sh[64], sg[64];
-        snprintf(sh, sizeof(sh), "START %d %d %s\n", g->id, g->size, hc);
-        snprintf(sg, sizeof(sg), "START %d %d %s\n", g->id, g->size, gc);
-        send_str(g->host_fd, sh);
-        send_str(g->guest_fd, sg);
+        if (game_host_fd(g) == -1) {
+            send_str(c->fd, "ERR host offline\n");
+            return;
+        }
 
-        // pierwsza plansza (pusta)
-        send_board(g);
-        send_captures(g);
+        if (match_seeking(c->fd)) {
+            send_str(c->fd, "ERR already seeking\n");
+            return;
+        }
 
-        int black_fd = (g->host_color == 0) ? g->host_fd : g->guest_fd;
-        int white_fd = (g->host_color == 0) ? g->guest_fd : g->host_fd;
+        game_seat_guest(g, c->fd, c->nick);
+        start_game(clients, g);
+        return;
+    }
 
-        char nn[128];
-        snprintf(nn, sizeof(nn), "NICKS %d %s %s\n", g->id,
-                nick_of_fd(clients, black_fd),
-                nick_of_fd(clients, white_fd));
-        send_str(g->host_fd, nn);
-        send_str(g->guest_fd, nn);
+    if (strcmp(line, "STATS") == 0) {
+        MetricsGauges g;
+        fill_gauges(clients, &g);
+        char *text = NULL;
+        size_t len = 0;
+        FILE *f = open_memstream(&text, &len);
+        if (!f) { send_str(c->fd, "ERR out of memory\n"); return; }
+        metrics_write_stats(f, &g);
+        fclose(f);
+        send_str(c->fd, text);
+        free(text);
+        return;
+    }
 
-        char ev[64];
-        snprintf(ev, sizeof(ev), "EVENT GAME_STARTED %d\n", g->id);
-        broadcast_subscribed(clients, ev);
+    if (strncmp(line, "SEEK ", 5) == 0) {
+        int size = 0;
+        char pref = 'R';
+        if (sscanf(line, "SEEK %d %c", &size, &pref) < 1) {
+            send_str(c->fd, "ERR usage: SEEK <size> [B|W|R]\n");
+            return;
+        }
+        if (pref != 'B' && pref != 'W' && pref != 'R') pref = 'R';
+        if (size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE) {
+            send_str(c->fd, "ERR invalid board size\n");
+            return;
+        }
+        if (host_has_game(c->fd)) {
+            send_str(c->fd, "ERR already hosting a game\n");
+            return;
+        }
 
+        RatingEntry e;
+        rating_get(c->nick, &e);
+        int r = match_seek(c->fd, size, pref, e.rating, now_ms());
+        if (r == -1) { send_str(c->fd, "ERR already seeking\n"); return; }
+        if (r < 0) { send_str(c->fd, "ERR server full\n"); return; }
+        char msg[64];
+        snprintf(msg, sizeof(msg), "OK SEEKING %d %.0f\n", size, e.rating);
+        send_str(c->fd, msg);
         return;
     }
 
@@ -330,64 +825,24 @@ static void handle_line(Client clients[], int idx, char *line) {
         if (!in_bounds(g, x, y)) { send_str(c->fd, "ERR out of bounds\n"); return; }
         if (myc != g->to_move) { send_str(c->fd, "ERR not your turn\n"); return; }
 
-        int idxb = game_idx(g, x, y);
-        if (g->board[idxb] != 0) { send_str(c->fd, "ERR occupied\n"); return; }
-
-        unsigned char before[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-        copy_board(g, before, g->board);
-
-        g->board[idxb] = (myc == 0 ? 1 : 2);
-
-        unsigned char opp = (myc == 0 ? 2 : 1);
-        const int dx[4] = {1,-1,0,0};
-        const int dy[4] = {0,0,1,-1};
-
-        int stones[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-        for (int k = 0; k < 4; k++) {
-            int nx = x + dx[k], ny = y + dy[k];
-            if (!in_bounds(g, nx, ny)) continue;
-            int nidx = game_idx(g, nx, ny);
-            if (g->board[nidx] == opp) {
-                int libs = 0;
-                int cnt = collect_group(g, nx, ny, opp, stones,
-                                        (int)(BOARD_MAX_SIZE*BOARD_MAX_SIZE), &libs);
-                if (cnt > 0 && libs == 0) {
-                    int removed = remove_group(g, stones, cnt);
-                    if (myc == 0) g->cap_black += removed;
-                    else         g->cap_white += removed;
-                }
-            }
-        }
-
-        int mylibs = 0;
-        int mycnt = collect_group(g, x, y, (myc == 0 ? 1 : 2), stones,
-                                  (int)(BOARD_MAX_SIZE*BOARD_MAX_SIZE), &mylibs);
-        if (mycnt > 0 && mylibs == 0) {
-            copy_board(g, g->board, before);
-            send_str(c->fd, "ERR suicide\n");
-            return;
-        }
-
-        if (boards_equal(g, g->board, g->prev_board)) {
-            copy_board(g, g->board, before);
-            send_str(c->fd, "ERR ko\n");
-            return;
-        }
-
-        copy_board(g, g->prev_board, before);
-
-        g->to_move = (g->to_move == 0 ? 1 : 0);
+        int mr = game_play_move(g, myc, x, y);
+        if (mr == MOVE_OCCUPIED) { send_str(c->fd, "ERR occupied\n"); return; }
+        if (mr == MOVE_SUICIDE) { send_str(c->fd, "ERR suicide\n"); return; }
+        if (mr == MOVE_KO) { send_str(c->fd, "ERR ko\n"); return; }
+        journal_move(id, myc, x, y);
 
         char msg[128];
         snprintf(msg, sizeof(msg), "MOVED %d %d %d %s\n",
                  g->id, x, y, (myc==0?"BLACK":"WHITE"));
-        send_str(g->host_fd, msg);
-        send_str(g->guest_fd, msg);
+        send_str(game_host_fd(g), msg);
+        send_str(game_guest_fd(g), msg);
 
         // send_board(g);
         // send_captures(g);
         send_board_safe(clients, g);
-        send_captures_safe(clients, g);
+        g = find_game_by_id(id);
+        if (g) send_captures_safe(clients, g);
+        bot_reply(id);
         return;
     }
 
@@ -406,82 +861,242 @@ static void handle_line(Client clients[], int idx, char *line) {
         if (myc < 0) { send_str(c->fd, "ERR not in that game\n"); return; }
         if (myc != g->to_move) { send_str(c->fd, "ERR not your turn\n"); return; }
 
-        unsigned char before[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-        copy_board(g, before, g->board);
-        copy_board(g, g->prev_board, before);
-
-        g->to_move = (g->to_move == 0 ? 1 : 0);
+        game_pass(g);
+        journal_pass(id, myc);
 
         char m[64];
         snprintf(m, sizeof(m), "PASSED %d %s\n", g->id, (myc==0?"BLACK":"WHITE"));
-        send_str(g->host_fd, m);
-        send_str(g->guest_fd, m);
+        send_str(game_host_fd(g), m);
+        send_str(game_guest_fd(g), m);
 
         send_board(g);
+        bot_reply(id);
         return;
     }
 
     send_fmt(c->fd, "ERR ", "unknown command");
 }
 
+// Lines are parsed here: the client's partial line, if it has one, then
+// what recv() brought. Only a new partial line is copied out again.
+static char rx_area[BUF_SIZE];
+
 static void process_client_data(Client clients[], int idx) {
     Client *c = &clients[idx];
     if (c->fd < 0) return;
 
-    ssize_t r = recv(c->fd, c->buf + c->len, (size_t)(BUF_SIZE - c->len), 0);
-    if (r == 0) {
-        remove_games_of_client(clients, c->fd, "DISCONNECT");
-        client_close(c);
-        return;
-    }
-    if (r < 0) {
-        if (errno == EINTR) return;
-        remove_games_of_client(clients, c->fd, "DISCONNECT");
-        client_close(c);
+    size_t have = c->len;
+    if (have) memcpy(rx_area, c->buf, have);
+    ssize_t r = server_io->recv(c->fd, rx_area + have, BUF_SIZE - have);
+    if (r <= 0) {
+        if (r < 0 && errno == EINTR) return;
+        queue_close(c, "DISCONNECT");
         return;
     }
 
-    c->len += (size_t)r;
+    // the partial line is in rx_area now; handle_line may close c
+    rxbuf_free(c->buf, c->cap);
+    c->buf = NULL;
+    c->len = c->cap = 0;
+
+    size_t len = have + (size_t)r;
+    metrics_bytes_in((size_t)r);
     size_t start = 0;
-    for (size_t i = 0; i < c->len; i++) {
-        if (c->buf[i] == '\n') {
+    // each line ends where the next one starts: one tick read per line
+    uint64_t t0 = metrics_ticks();
+    for (size_t i = have; i < len; i++) {
+        if (rx_area[i] == '\n') {
             size_t line_len = i - start + 1;
             char line[BUF_SIZE];
             if (line_len >= sizeof(line)) line_len = sizeof(line) - 1;
-            memcpy(line, c->buf + start, line_len);
+            memcpy(line, rx_area + start, line_len);
             line[line_len] = '\0';
 
+            if (capture_enabled()) capture_line(c->conn_id, line, line_len);
+            MetricCmd cmd = metrics_command(line);
+            int fd = c->fd;
             handle_line(clients, idx, line);
+            uint64_t t1 = metrics_ticks();
+            uint64_t ns = metrics_ticks_to_ns(t1 - t0);
+            t0 = t1;
+            metrics_command_done(cmd, ns);
+            loop_lines++;
+            if (ns >= slowlog_threshold_ns())
+                slowlog_command(line, fd, clients[idx].fd == fd ? clients[idx].nick : "", ns);
 
-            if (clients[idx].fd == -1) return;
+            if (clients[idx].closing) return;
 
             start = i + 1;
         }
     }
 
-    if (start > 0) {
-        size_t remain = c->len - start;
-        memmove(c->buf, c->buf + start, remain);
-        c->len = remain;
+    size_t remain = len - start;
+    if (remain == BUF_SIZE) {
+        send_fmt(c->fd, "ERR ", "line too long");
+        return;
     }
+    if (remain == 0) return;
+    c->buf = rxbuf_alloc(remain, &c->cap);
+    if (!c->buf) {
+        send_fmt(c->fd, "ERR ", "out of memory");
+        return;
+    }
+    memcpy(c->buf, rx_area + start, remain);
+    c->len = remain;
+}
 
-    if (c->len == BUF_SIZE) {
-        c->len = 0;
-        send_fmt(c->fd, "ERR ", "line too long");
+void server_init(const ServerIo *io, int lfd, int bfd) {
+    server_io = io;
+    listen_fd = lfd;
+    bot_fd = bfd;
+    for (int i = 0; i < MAX_CLIENTS; i++) client_init(&client_table[i]);
+    last_pass = 0;
+}
+
+void server_step(void) {
+    Client *clients = client_table;
+
+    // wake for the next pairing pass while anyone seeks, for the next
+    // dashboard snapshot, and at least once a second for snapshot
+    // housekeeping and for bot searches the pool refused
+    int wake_ms = match_waiting() ? MATCH_PASS_MS : 1000;
+    if (dash_enabled() && DASH_PERIOD_MS < wake_ms) wake_ms = DASH_PERIOD_MS;
+    int rc = server_io->wait(clients, listen_fd, bot_fd,
+                             timed_jobs || nbot_retry || match_waiting() || dash_enabled() ? wake_ms : -1);
+    if (rc < 0) {
+        if (errno == EINTR) return;
+        fatal_error("select");
+    }
+    uint64_t busy_from = metrics_ticks();
+    loop_lines = 0;
+    journal_tick(now_ms());
+    if (match_waiting() && now_ms() - last_pass >= MATCH_PASS_MS) {
+        last_pass = now_ms();
+        match_pass(last_pass, start_match, clients);
+    }
+    if (dash_due(now_ms())) publish_dash(clients);
+
+    if (server_io->ready(listen_fd)) {
+        struct sockaddr_in peer;
+        int cfd = server_io->accept(listen_fd, &peer);
+        if (cfd >= 0) {
+            int idx = add_client(clients, cfd, &peer);
+            if (idx < 0) {
+                send_fmt(cfd, "ERR ", "server full");
+                server_io->close(cfd);
+            }
+        }
+    }
+
+    if (bot_fd >= 0 && server_io->ready(bot_fd)) {
+        BotResult r;
+        botpool_ack();
+        while (botpool_poll(&r)) bot_apply(clients, &r);
+        if (nbot_retry) bot_retry_pass();
+    } else if (nbot_retry && botpool_pending() == 0) {
+        bot_retry_pass();
     }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd != -1 && !clients[i].closing && server_io->ready(clients[i].fd)) {
+            process_client_data(clients, i);
+        }
+    }
+    close_pending(clients);
+    admin_handle(server_io->ready, render_admin, clients);
+    capture_tick();
+    uint64_t busy_ns = metrics_ticks_to_ns(metrics_ticks() - busy_from);
+    metrics_loop(busy_ns);
+    if (busy_ns >= slowlog_threshold_ns()) slowlog_loop(busy_ns, loop_lines);
 }
 
+#ifndef SERVER_NO_MAIN
 int main(int argc, char **argv) {
     signal(SIGPIPE, SIG_IGN);
-    srand((unsigned)time(NULL));
 
     int port = 1984;
-    if (argc >= 2) port = atoi(argv[1]);
+    const char *book_path = NULL;
+    const char *journal_path = NULL;
+    int snapshot_secs = 60;
+    const char *archive_dir = NULL;
+    int admin_port = 0;
+    const char *slow_log = NULL;
+    const char *dash_path = NULL;
+    const char *capture_path = NULL;
+    unsigned seed = (unsigned)time(NULL);
+    double slow_ms = SLOWLOG_DEFAULT_MS;
+    bot_config_default(&bot_cfg);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bot-ms") == 0 && i + 1 < argc) {
+            bot_cfg.time_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bot-playouts") == 0 && i + 1 < argc) {
+            bot_cfg.playouts = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bot-threads") == 0 && i + 1 < argc) {
+            bot_cfg.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bot-policy") == 0 && i + 1 < argc) {
+            i++;
+            bot_cfg.policy = (strcmp(argv[i], "light") == 0) ? BOT_POLICY_LIGHT : BOT_POLICY_PATTERN;
+        } else if (strcmp(argv[i], "--bot-tt-mb") == 0 && i + 1 < argc) {
+            bot_cfg.tt_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bot-cpu") == 0 && i + 1 < argc) {
+            bot_cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            book_path = argv[++i];
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--snapshot-secs") == 0 && i + 1 < argc) {
+            snapshot_secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) {
+            archive_dir = argv[++i];
+        } else if (strcmp(argv[i], "--admin-port") == 0 && i + 1 < argc) {
+            admin_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--slow-log") == 0 && i + 1 < argc) {
+            slow_log = argv[++i];
+        } else if (strcmp(argv[i], "--slow-ms") == 0 && i + 1 < argc) {
+            slow_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dash") == 0 && i + 1 < argc) {
+            dash_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            port = atoi(argv[i]);
+        }
+    }
     if (port <= 0 || port > 65535) {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <port> [--bot-ms N] [--bot-playouts N] [--bot-threads N] [--bot-policy light|pattern] [--bot-tt-mb N] [--bot-cpu N] [--book FILE] [--journal FILE] [--snapshot-secs N] [--archive DIR] [--admin-port N] [--slow-log FILE] [--slow-ms N] [--dash FILE] [--capture FILE] [--seed N]\n", argv[0]);
         return 1;
     }
 
+    if (book_path) {
+        if (book_open(book_path) < 0) return 1;
+        printf("Opening book: %llu entries\n", (unsigned long long)book_size());
+    }
+
+    if (archive_dir) {
+        if (archive_open(archive_dir) < 0 || history_open(archive_dir) < 0 ||
+            rating_open(archive_dir) < 0) return 1;
+        game_set_next_id(history_next_id());
+        ArchiveStats as;
+        archive_stats(&as);
+        printf("Archive: %s, segment %u\n", archive_dir, as.segment);
+    }
+
+    if (journal_path) {
+        if (journal_open(journal_path, snapshot_secs) < 0) return 1;
+        timed_jobs = true;
+        JournalStats js;
+        journal_stats(&js);
+        printf("Journal: %llu games from snapshot, replayed %llu records in %.1f ms\n",
+               (unsigned long long)js.restored, (unsigned long long)js.replayed, js.restore_ms);
+    }
+
+    if (bot_cpu <= 0) bot_cpu = bot_cpu_count();
+    int bot_fd = botpool_start(bot_cpu);
+    if (bot_fd < 0) fatal_error("botpool_start");
+
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) fatal_error("socket");
 
@@ -499,50 +1114,27 @@ int main(int argc, char **argv) {
     if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) fatal_error("bind");
     if (listen(server_fd, 64) < 0) fatal_error("listen");
 
-    Client clients[MAX_CLIENTS];
-    for (int i = 0; i < MAX_CLIENTS; i++) client_init(&clients[i]);
-
-    printf("Server listening: %d\n", port);
-
-    while (1) {
-        fd_set rfds;
-        FD_ZERO(&rfds);
-        FD_SET(server_fd, &rfds);
-
-        int maxfd = server_fd;
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].fd != -1) {
-                FD_SET(clients[i].fd, &rfds);
-                if (clients[i].fd > maxfd) maxfd = clients[i].fd;
-            }
-        }
-
-        int rc = select(maxfd + 1, &rfds, NULL, NULL, NULL);
-        if (rc < 0) {
-            if (errno == EINTR) continue;
-            fatal_error("select");
-        }
-
-        if (FD_ISSET(server_fd, &rfds)) {
-            struct sockaddr_in peer;
-            socklen_t peerlen = sizeof(peer);
-            int cfd = accept(server_fd, (struct sockaddr *)&peer, &peerlen);
-            if (cfd >= 0) {
-                int idx = add_client(clients, cfd, &peer);
-                if (idx < 0) {
-                    send_fmt(cfd, "ERR ", "server full");
-                    close(cfd);
-                }
-            }
-        }
-
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &rfds)) {
-                process_client_data(clients, i);
-            }
-        }
+    metrics_init();
+    if (admin_port > 0) {
+        if (admin_open(admin_port) < 0) return 1;
+        printf("Admin: 127.0.0.1:%d/metrics\n", admin_port);
+    }
+    if (slow_log) {
+        if (slowlog_open(slow_log, slow_ms) < 0) return 1;
+        printf("Slow log: %s (>= %g ms)\n", slow_log, slow_ms);
+    }
+    if (dash_path) {
+        if (dash_open(dash_path) < 0) return 1;
+        printf("Dashboard: %s\n", dash_path);
+    }
+    srand(seed);
+    if (capture_path) {
+        if (capture_open(capture_path, seed) < 0) return 1;
+        printf("Capturing to %s (seed %u)\n", capture_path, seed);
     }
 
-    close(server_fd);
-    return 0;
+    printf("Server listening: %d\n", port);
+    server_init(&io_os, server_fd, bot_fd);
+    for (;;) server_step();
 }
+#endif
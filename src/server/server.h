@@ -10,7 +10,7 @@
 #define MAX_CLIENTS 50
 #define BUF_SIZE 4096
 #define NICK_SIZE 32
-#define BOARD_MAX_SIZE 19
+#define BOARD_MAX_SIZE 32
 
 typedef struct {
     int fd;                  // -1 if unused
@@ -0,0 +1,135 @@
+// server_admin.c
+
+#include "server_admin.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+typedef struct
+{
+    int fd;
+    uint64_t opened;          // accept order, to evict the oldest
+    size_t len;
+    char req[ADMIN_REQ_MAX];
+} AdminConn;
+
+static int listen_fd = -1;
+static AdminConn conns[ADMIN_MAX_CONNS];
+static uint64_t accepted;
+
+int admin_open(int port) {
+    for (int i = 0; i < ADMIN_MAX_CONNS; i++) conns[i].fd = -1;
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("admin socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        perror("admin bind");
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int admin_fill_fds(fd_set *rfds, int maxfd) {
+    if (listen_fd < 0) return maxfd;
+    FD_SET(listen_fd, rfds);
+    if (listen_fd > maxfd) maxfd = listen_fd;
+    for (int i = 0; i < ADMIN_MAX_CONNS; i++) {
+        if (conns[i].fd < 0) continue;
+        FD_SET(conns[i].fd, rfds);
+        if (conns[i].fd > maxfd) maxfd = conns[i].fd;
+    }
+    return maxfd;
+}
+
+static void write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void respond(AdminConn *c, AdminRender render, void *arg) {
+    char path[256] = "/";
+    sscanf(c->req, "GET %255s", path);
+
+    char *body = NULL, *head = NULL;
+    size_t body_len = 0, head_len = 0;
+    FILE *f = open_memstream(&body, &body_len);
+    int status = f ? render(f, path, arg) : 500;
+    if (f) fclose(f);
+
+    FILE *h = open_memstream(&head, &head_len);
+    if (h) {
+        fprintf(h, "HTTP/1.0 %d %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                status, status == 200 ? "OK" : status == 404 ? "Not Found" : "Error", body_len);
+        fclose(h);
+        write_all(c->fd, head, head_len);
+        write_all(c->fd, body, body_len);
+    }
+    free(head);
+    free(body);
+    close(c->fd);
+    c->fd = -1;
+}
+
+void admin_handle(int (*ready)(int fd), AdminRender render, void *arg) {
+    if (listen_fd < 0) return;
+    if (ready(listen_fd)) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            int slot = 0;
+            for (int i = 0; i < ADMIN_MAX_CONNS; i++) {
+                if (conns[i].fd < 0) {
+                    slot = i;
+                    break;
+                }
+                if (conns[i].opened < conns[slot].opened) slot = i;
+            }
+            if (conns[slot].fd >= 0) close(conns[slot].fd);
+            conns[slot].fd = fd;
+            conns[slot].opened = accepted++;
+            conns[slot].len = 0;
+        }
+    }
+
+    for (int i = 0; i < ADMIN_MAX_CONNS; i++) {
+        AdminConn *c = &conns[i];
+        if (c->fd < 0 || !ready(c->fd)) continue;
+        ssize_t r = recv(c->fd, c->req + c->len, sizeof(c->req) - 1 - c->len, 0);
+        if (r < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (r <= 0 || c->len + (size_t)r >= sizeof(c->req) - 1) {
+            close(c->fd);
+            c->fd = -1;
+            continue;
+        }
+        c->len += (size_t)r;
+        c->req[c->len] = '\0';
+        // a blank line ends the request; a bare "GET /path" line is enough for nc
+        if (strstr(c->req, "\r\n\r\n") || strstr(c->req, "\n\n") ||
+            (strchr(c->req, '\n') && !strstr(c->req, "HTTP/")))
+            respond(c, render, arg);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdio.h>
+#include <sys/select.h>
+
+// Local admin endpoint: a minimal HTTP/1.0 server on 127.0.0.1, driven by
+// the main select() loop like the game sockets. Each connection sends one
+// GET, gets one response and is closed. Requests are read without blocking
+// the loop; an oversized request is dropped, and when every slot is taken
+// the oldest connection makes room for the new one.
+
+#define ADMIN_MAX_CONNS 8
+#define ADMIN_REQ_MAX 2048
+
+// write the body for path to f; returns the HTTP status (200, 404, ...)
+typedef int (*AdminRender)(FILE *f, const char *path, void *arg);
+
+// listen on 127.0.0.1:port; 0 on success
+int admin_open(int port);
+
+// add the admin sockets to rfds; returns the new maxfd
+int admin_fill_fds(fd_set *rfds, int maxfd);
+
+// accept and serve whatever ready() reports readable
+void admin_handle(int (*ready)(int fd), AdminRender render, void *arg);
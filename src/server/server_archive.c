@@ -0,0 +1,572 @@
+// server_archive.c
+// The same double-buffer writer as the journal. The loop decides segment
+// rolls itself, so it always knows where a record will land: a roll opens
+// the next segment and marks a cut in the batch, and the writer thread
+// switches files at the cut. Only one cut can be pending, so a segment may
+// overrun its nominal size by one batch.
+
+#include "server_archive.h"
+#include "server_crc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static int afd = -1;            // segment being written; the writer thread's once it runs
+static int active;
+static Buf fill, flush;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t written = PTHREAD_COND_INITIALIZER;
+static uint64_t queued_seq;     // bytes queued so far
+static uint64_t written_seq;    // bytes written so far
+static int cut_fd = -1;         // segment roll: move to this file ...
+static size_t cut_at;           // ... after this many bytes of fill
+static ArchiveStats stats;
+
+// writer thread only
+static uint32_t wseg;           // where the next written byte lands
+static uint64_t wlen;
+static ArchiveVisit indexers[ARCHIVE_MAX_INDEXERS];
+static void *indexer_args[ARCHIVE_MAX_INDEXERS];
+static int nindexers;
+
+// loop thread only
+static char adir[4096];
+static uint32_t seg;            // segment of the next record
+static uint64_t seg_len;        // its length, queued records included
+static unsigned char *scratch;
+static size_t scratch_cap;
+
+static void seg_path(char *out, size_t outsz, const char *dir, uint32_t s) {
+    snprintf(out, outsz, "%s/games.%06u", dir, s);
+}
+
+static size_t put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+static int get_varint(const unsigned char *p, size_t n, size_t *at, uint64_t *v) {
+    uint64_t r = 0;
+    for (int shift = 0; *at < n && shift < 64; shift += 7) {
+        unsigned char b = p[(*at)++];
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static size_t put_str(unsigned char *p, size_t at, const char *s, size_t max) {
+    size_t n = strlen(s);
+    if (n > max) n = max;
+    p[at] = (unsigned char)n;
+    memcpy(p + at + 1, s, n);
+    return at + 1 + n;
+}
+
+static int get_str(const unsigned char *p, size_t n, size_t *at, char *out, size_t outsz) {
+    if (*at >= n) return -1;
+    size_t len = p[*at];
+    if (*at + 1 + len > n || len >= outsz) return -1;
+    memcpy(out, p + *at + 1, len);
+    out[len] = '\0';
+    *at += 1 + len;
+    return 0;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// ---- decoding ----
+
+int archive_decode(const unsigned char *p, size_t n, ArchiveGame *out, size_t *used) {
+    size_t at = 0;
+    uint64_t len;
+    if (get_varint(p, n, &at, &len) < 0) return n < 10 ? 0 : -1;
+    if (len < 4 || len > ARCHIVE_REC_MAX) return -1;
+    if (at + len > n) return 0;
+
+    const unsigned char *body = p + at + 4;
+    size_t bn = (size_t)len - 4;
+    if (crc32_update(0, body, bn) != get_u32(p + at)) return -1;
+    *used = at + (size_t)len;
+    if (!out) return 1;
+
+    memset(out, 0, sizeof(*out));
+    size_t b = 0;
+    uint64_t id, when, ply;
+    if (get_varint(body, bn, &b, &id) < 0 || get_varint(body, bn, &b, &when) < 0 || b + 2 > bn) return -1;
+    out->id = (int)id;
+    out->end_time = (int64_t)when;
+    out->size = body[b];
+    int flags = body[b + 1];
+    b += 2;
+    out->vs_bot = flags & 1;
+    out->winner = (flags >> 1) & 1;
+    out->end = (ArchiveEnd)((flags >> 2) & 3);
+    if (get_str(body, bn, &b, out->black, sizeof(out->black)) < 0 ||
+        get_str(body, bn, &b, out->white, sizeof(out->white)) < 0 ||
+        get_str(body, bn, &b, out->name, sizeof(out->name)) < 0 || get_varint(body, bn, &b, &ply) < 0)
+        return -1;
+    if (out->size < BOARD_MIN_SIZE || out->size > BOARD_MAX_SIZE || ply > bn) return -1;
+
+    out->moves = malloc(((size_t)ply + 1) * sizeof(uint16_t));
+    if (!out->moves) return -1;
+    for (uint64_t i = 0; i < ply; i++) {
+        uint64_t code;
+        if (get_varint(body, bn, &b, &code) < 0 || code > (uint64_t)out->size * out->size) {
+            archive_game_free(out);
+            return -1;
+        }
+        out->moves[i] = (uint16_t)code;
+    }
+    out->ply = (int)ply;
+    return 1;
+}
+
+int archive_read(const char *dir, ArchivePos pos, ArchiveGame *out, ArchivePos *next) {
+    char path[4200];
+    seg_path(path, sizeof(path), dir, pos.segment);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+
+    // most records fit the first read; a long game needs a second one
+    unsigned char head[1024];
+    ssize_t r = pread(fd, head, sizeof(head), pos.offset);
+    int rc = -1;
+    size_t used;
+    if (r < 0) goto out;
+    rc = archive_decode(head, (size_t)r, out, &used);
+    if (rc == 0 && (size_t)r == sizeof(head)) {
+        size_t at = 0;
+        uint64_t len;
+        if (get_varint(head, (size_t)r, &at, &len) < 0 || len > ARCHIVE_REC_MAX) {
+            rc = -1;
+            goto out;
+        }
+        size_t total = at + (size_t)len;
+        unsigned char *big = malloc(total);
+        if (!big) {
+            rc = -1;
+            goto out;
+        }
+        r = pread(fd, big, total, pos.offset);
+        rc = r < 0 ? -1 : archive_decode(big, (size_t)r, out, &used);
+        free(big);
+    }
+    if (rc == 1 && next) {
+        next->segment = pos.segment;
+        next->offset = pos.offset + (uint32_t)used;
+    }
+out:
+    close(fd);
+    return rc;
+}
+
+void archive_game_free(ArchiveGame *ag) {
+    free(ag->moves);
+    ag->moves = NULL;
+    ag->ply = 0;
+}
+
+// ---- SGF ----
+
+static char sgf_coord(int v) {
+    return (char)(v < 26 ? 'a' + v : 'A' + (v - 26));
+}
+
+static void sgf_text(FILE *f, const char *prop, const char *s) {
+    fprintf(f, "%s[", prop);
+    for (; *s; s++) {
+        if (*s == ']' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc(']', f);
+}
+
+void archive_write_sgf(FILE *f, const ArchiveGame *ag) {
+    char date[16];
+    time_t t = (time_t)ag->end_time;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+
+    fprintf(f, "(;GM[1]FF[4]CA[UTF-8]AP[game_of_GO]SZ[%d]", ag->size);
+    sgf_text(f, "PB", ag->black);
+    sgf_text(f, "PW", ag->white);
+    sgf_text(f, "GN", ag->name);
+    fprintf(f, "DT[%s]RE[%c+%c]\n", date, ag->winner ? 'W' : 'B', ag->end == ARCHIVE_FORFEIT ? 'F' : 'R');
+    for (int i = 0; i < ag->ply; i++) {
+        char c = (i & 1) ? 'W' : 'B';
+        int code = ag->moves[i];
+        if (code == 0) fprintf(f, ";%c[]", c);
+        else fprintf(f, ";%c[%c%c]", c, sgf_coord((code - 1) % ag->size), sgf_coord((code - 1) / ag->size));
+        if (i % 10 == 9) fputc('\n', f);
+    }
+    fprintf(f, ")\n");
+}
+
+// ---- writer ----
+
+static void write_out(int fd, const unsigned char *p, size_t n) {
+    size_t off = 0;
+    while (off < n) {
+        ssize_t w = write(fd, p + off, n - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("archive write");
+            return;
+        }
+        off += (size_t)w;
+    }
+}
+
+// hand the records of a written piece to the indexers
+static void index_piece(const unsigned char *p, size_t n) {
+    size_t at = 0, used;
+    ArchiveGame ag;
+    while (nindexers > 0 && at < n && archive_decode(p + at, n - at, &ag, &used) == 1) {
+        ArchivePos pos = {wseg, (uint32_t)(wlen + at)};
+        for (int i = 0; i < nindexers; i++) indexers[i](&ag, pos, (uint32_t)used, indexer_args[i]);
+        archive_game_free(&ag);
+        at += used;
+    }
+    wlen += n;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (fill.len == 0) pthread_cond_wait(&wake, &lock);
+
+        Buf t = flush;
+        flush = fill;
+        fill = t;
+        fill.len = 0;
+        uint64_t seq = queued_seq;
+        int nfd = cut_fd;
+        size_t cut = cut_at;
+        cut_fd = -1;
+        pthread_mutex_unlock(&lock);
+
+        size_t start = 0;
+        if (nfd >= 0) {
+            write_out(afd, flush.data, cut);
+            if (fdatasync(afd) < 0) perror("archive fdatasync");
+            index_piece(flush.data, cut);
+            close(afd);
+            afd = nfd;
+            wseg++;
+            wlen = 0;
+            start = cut;
+        }
+        write_out(afd, flush.data + start, flush.len - start);
+        if (fdatasync(afd) < 0) perror("archive fdatasync");
+        index_piece(flush.data + start, flush.len - start);
+
+        pthread_mutex_lock(&lock);
+        stats.batches++;
+        stats.bytes += flush.len;
+        written_seq = seq;
+        pthread_cond_broadcast(&written);
+    }
+    return NULL;
+}
+
+int archive_game(const Game *g, int winner, ArchiveEnd end, uint64_t end_time, ArchivePos *pos) {
+    if (!active) return -1;
+
+    int ply = g->moves ? g->ply : 0;
+    size_t need = 16 + 2 * 10 + 2 + 3 * 256 + 10 + (size_t)ply * 2;
+    if (need > scratch_cap) {
+        unsigned char *s = realloc(scratch, need);
+        if (!s) return -1;
+        scratch = s;
+        scratch_cap = need;
+    }
+
+    // body first, leaving room in front for the length and CRC
+    unsigned char *body = scratch + 16;
+    size_t n = 0;
+    const char *black = g->host_color == 0 ? g->host_nick : g->guest_nick;
+    const char *white = g->host_color == 0 ? g->guest_nick : g->host_nick;
+    n += put_varint(body + n, (uint64_t)g->id);
+    n += put_varint(body + n, end_time);
+    body[n++] = (unsigned char)g->size;
+    body[n++] = (unsigned char)((g->vs_bot ? 1 : 0) | (winner & 1) << 1 | (end & 3) << 2);
+    n = put_str(body, n, black, NICK_SIZE - 1);
+    n = put_str(body, n, white, NICK_SIZE - 1);
+    n = put_str(body, n, g->game_name, GAME_NAME_SIZE - 1);
+    n += put_varint(body + n, (uint64_t)ply);
+    for (int i = 0; i < ply; i++) n += put_varint(body + n, g->moves[i]);
+
+    unsigned char pre[16];
+    size_t pn = put_varint(pre, n + 4);
+    put_u32(pre + pn, crc32_update(0, body, n));
+    pn += 4;
+    unsigned char *rec = body - pn;
+    memcpy(rec, pre, pn);
+    size_t len = pn + n;
+
+    pthread_mutex_lock(&lock);
+    int cut_pending = cut_fd >= 0;
+    pthread_mutex_unlock(&lock);
+
+    int nfd = -1;
+    if (!cut_pending && seg_len > 0 && seg_len + len > ARCHIVE_SEGMENT_BYTES) {
+        char path[4200];
+        seg_path(path, sizeof(path), adir, seg + 1);
+        nfd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (nfd < 0) perror(path);   // keep filling the current segment
+    }
+
+    pthread_mutex_lock(&lock);
+    if (fill.len + len > fill.cap) {
+        size_t cap = fill.cap ? fill.cap * 2 : 1 << 16;
+        while (cap < fill.len + len) cap *= 2;
+        unsigned char *d = realloc(fill.data, cap);
+        if (!d) {
+            pthread_mutex_unlock(&lock);
+            if (nfd >= 0) close(nfd);
+            perror("archive realloc");
+            return -1;
+        }
+        fill.data = d;
+        fill.cap = cap;
+    }
+    if (nfd >= 0) {
+        cut_fd = nfd;
+        cut_at = fill.len;
+        seg++;
+        seg_len = 0;
+        stats.segment = seg;
+    }
+    if (pos) {
+        pos->segment = seg;
+        pos->offset = (uint32_t)seg_len;
+    }
+    memcpy(fill.data + fill.len, rec, len);
+    fill.len += len;
+    seg_len += len;
+    queued_seq += len;
+    stats.games++;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+void archive_flush(void) {
+    if (!active) return;
+    pthread_mutex_lock(&lock);
+    uint64_t want = queued_seq;
+    while (written_seq < want) pthread_cond_wait(&written, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+int archive_enabled(void) {
+    return active;
+}
+
+void archive_stats(ArchiveStats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+int archive_add_indexer(ArchiveVisit fn, void *arg) {
+    pthread_mutex_lock(&lock);
+    int ok = nindexers < ARCHIVE_MAX_INDEXERS;
+    if (ok) {
+        indexers[nindexers] = fn;
+        indexer_args[nindexers] = arg;
+        nindexers++;
+    }
+    pthread_mutex_unlock(&lock);
+    return ok ? 0 : -1;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// segment numbers present in dir, ascending; returns count or -1
+int archive_segments(const char *dir, uint32_t **out) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    size_t n = 0, cap = 16;
+    uint32_t *segs = malloc(cap * sizeof(*segs));
+    struct dirent *e;
+    while (segs && (e = readdir(d)) != NULL) {
+        unsigned s;
+        char extra;
+        if (sscanf(e->d_name, "games.%6u%c", &s, &extra) != 1) continue;
+        if (n == cap) {
+            uint32_t *t = realloc(segs, (cap *= 2) * sizeof(*segs));
+            if (!t) free(segs);
+            segs = t;
+        }
+        if (segs) segs[n++] = s;
+    }
+    closedir(d);
+    if (!segs) return -1;
+    qsort(segs, n, sizeof(*segs), cmp_u32);
+    *out = segs;
+    return (int)n;
+}
+
+// visit the records of segment sg from byte off; -1 if it cannot be read
+static long scan_segment(const char *dir, uint32_t sg, size_t off, ArchiveVisit fn, void *arg) {
+    char path[4200];
+    seg_path(path, sizeof(path), dir, sg);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (off >= size) {
+        close(fd);
+        return 0;
+    }
+    const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    long visited = 0;
+    size_t used;
+    ArchiveGame ag;
+    while (off < size && archive_decode(map + off, size - off, &ag, &used) == 1) {
+        ArchivePos pos = {sg, (uint32_t)off};
+        fn(&ag, pos, (uint32_t)used, arg);
+        archive_game_free(&ag);
+        visited++;
+        off += used;
+    }
+    if (off < size) fprintf(stderr, "%s: stopped at damaged record, offset %zu\n", path, off);
+    munmap((void *)map, size);
+    return visited;
+}
+
+long archive_scan(const char *dir, ArchivePos from, ArchiveVisit fn, void *arg) {
+    uint32_t *segs;
+    int nsegs = archive_segments(dir, &segs);
+    if (nsegs < 0) return -1;
+
+    long visited = 0;
+    for (int i = 0; i < nsegs; i++) {
+        if (segs[i] < from.segment) continue;
+        long n = scan_segment(dir, segs[i], segs[i] == from.segment ? from.offset : 0, fn, arg);
+        if (n > 0) visited += n;
+    }
+    free(segs);
+    return visited;
+}
+
+long archive_scan_segment(const char *dir, uint32_t segment, ArchiveVisit fn, void *arg) {
+    return scan_segment(dir, segment, 0, fn, arg);
+}
+
+// ---- startup ----
+
+// length of the intact prefix of a segment
+static off_t intact_length(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    if (st.st_size == 0) return 0;
+    size_t size = (size_t)st.st_size;
+    const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return -1;
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    size_t off = 0, used;
+    while (off < size && archive_decode(map + off, size - off, NULL, &used) == 1) off += used;
+    munmap((void *)map, size);
+    if (off < size) fprintf(stderr, "archive: dropping %zu bytes of torn tail\n", size - off);
+    return (off_t)off;
+}
+
+int archive_open(const char *dir) {
+    snprintf(adir, sizeof(adir), "%s", dir);
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+    DIR *d = opendir(dir);
+    if (!d) {
+        perror(dir);
+        return -1;
+    }
+    seg = 1;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned s;
+        char extra;
+        if (sscanf(e->d_name, "games.%6u%c", &s, &extra) == 1 && s > seg) seg = s;
+    }
+    closedir(d);
+
+    char path[4200];
+    seg_path(path, sizeof(path), dir, seg);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    off_t end = intact_length(fd);
+    if (end < 0 || ftruncate(fd, end) < 0 || lseek(fd, end, SEEK_SET) < 0) {
+        perror("archive truncate");
+        close(fd);
+        return -1;
+    }
+    seg_len = (uint64_t)end;
+    stats.segment = seg;
+    wseg = seg;
+    wlen = seg_len;
+
+    pthread_t th;
+    afd = fd;
+    active = 1;
+    if (pthread_create(&th, NULL, writer_main, NULL) != 0) {
+        active = 0;
+        afd = -1;
+        close(fd);
+        return -1;
+    }
+    pthread_detach(th);
+    return 0;
+}
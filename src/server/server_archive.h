@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "server_game.h"
+
+// Archive of finished games.
+// Records are appended to segment files <dir>/games.NNNNNN of about
+// ARCHIVE_SEGMENT_BYTES each, so a record is addressed by (segment, byte
+// offset) and can be read with one pread. Like the journal, the loop only
+// encodes a record and copies it into a batch; a background thread writes
+// the batches, so archiving never waits for the disk.
+//
+// Record: varint length of the rest, u32 CRC-32 of the body, body:
+//   varint game id, varint end time (unix seconds), u8 size,
+//   u8 flags (bit 0 vs_bot, bit 1 white won, bits 2-3 ArchiveEnd),
+//   black nick, white nick, game name (u8 length + bytes each),
+//   varint move count, moves as varints (0 pass, else board index + 1:
+//   one byte up to 127, two bytes for the rest of a 32x32 board).
+
+#define ARCHIVE_SEGMENT_BYTES (64u << 20)
+#define ARCHIVE_REC_MAX (1u << 20)
+#define ARCHIVE_MAX_INDEXERS 4
+
+typedef enum
+{
+    ARCHIVE_RESIGN = 0,     // the loser left or quit
+    ARCHIVE_FORFEIT = 1     // the loser disconnected
+} ArchiveEnd;
+
+typedef struct
+{
+    uint32_t segment;       // 1, 2, ...
+    uint32_t offset;
+} ArchivePos;
+
+typedef struct
+{
+    int id;
+    int size;
+    int64_t end_time;
+    int vs_bot;
+    int winner;             // 0 black / 1 white
+    ArchiveEnd end;
+    char black[NICK_SIZE];
+    char white[NICK_SIZE];
+    char name[GAME_NAME_SIZE];
+    int ply;
+    uint16_t *moves;        // as Game.moves; owned, see archive_game_free
+} ArchiveGame;
+
+typedef struct
+{
+    uint64_t games;         // records appended since start
+    uint64_t batches;       // write rounds
+    uint64_t bytes;         // bytes written
+    uint32_t segment;       // segment being appended to
+} ArchiveStats;
+
+// find the newest segment in dir (created if missing), cut any torn tail,
+// start the writer thread; 0 on success. Without it archive_game is a no-op.
+int archive_open(const char *dir);
+
+int archive_enabled(void);
+
+// queue finished game g, which ended at end_time (Unix seconds); pos (if
+// not NULL) gets the record's address
+int archive_game(const Game *g, int winner, ArchiveEnd end, uint64_t end_time, ArchivePos *pos);
+
+// wait until every queued record is written
+void archive_flush(void);
+
+// read the record at pos in dir; 1 ok (next = the following record),
+// 0 no record there (end of segment), -1 damaged
+int archive_read(const char *dir, ArchivePos pos, ArchiveGame *out, ArchivePos *next);
+void archive_game_free(ArchiveGame *ag);
+
+// decode the record at p (out may be NULL to only check it);
+// 1 ok and *used = its length, 0 incomplete, -1 damaged
+int archive_decode(const unsigned char *p, size_t n, ArchiveGame *out, size_t *used);
+
+// ag as an SGF game tree
+void archive_write_sgf(FILE *f, const ArchiveGame *ag);
+
+void archive_stats(ArchiveStats *out);
+
+// called for every record once it is written, in archive order
+typedef void (*ArchiveVisit)(const ArchiveGame *ag, ArchivePos pos, uint32_t len, void *arg);
+
+// have the writer thread pass each record it writes to fn (for indexes),
+// after the ones added before it; -1 if ARCHIVE_MAX_INDEXERS are set
+int archive_add_indexer(ArchiveVisit fn, void *arg);
+
+// walk the records of dir from pos to the end of the newest segment;
+// returns the number visited, -1 if dir cannot be read
+long archive_scan(const char *dir, ArchivePos from, ArchiveVisit fn, void *arg);
+
+// the segment numbers in dir, ascending, in a malloc'd array; count or -1
+int archive_segments(const char *dir, uint32_t **out);
+
+// walk one whole segment; safe to run on several segments at once
+long archive_scan_segment(const char *dir, uint32_t segment, ArchiveVisit fn, void *arg);
@@ -0,0 +1,55 @@
+// server_boardpool.c
+// One free list per board size; a free block stores the next pointer in
+// its first bytes (the smallest block is far larger than a pointer).
+
+#include "server_boardpool.h"
+#include "server_game.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct FreeBlock
+{
+    struct FreeBlock *next;
+} FreeBlock;
+
+static FreeBlock *free_lists[BOARD_MAX_SIZE + 1];
+static size_t slab_bytes;
+
+static size_t block_size(int size) {
+    size_t n = 2 * (size_t)size * (size_t)size;
+    return (n + 63) & ~(size_t)63;
+}
+
+static int grow(int size) {
+    size_t bs = block_size(size);
+    unsigned char *slab = aligned_alloc(64, bs * BOARD_SLAB_BLOCKS);
+    if (!slab) return -1;
+    slab_bytes += bs * BOARD_SLAB_BLOCKS;
+    for (int i = BOARD_SLAB_BLOCKS - 1; i >= 0; i--) {
+        FreeBlock *b = (FreeBlock *)(slab + (size_t)i * bs);
+        b->next = free_lists[size];
+        free_lists[size] = b;
+    }
+    return 0;
+}
+
+unsigned char *board_alloc(int size) {
+    if (size < 2 || size > BOARD_MAX_SIZE) return NULL;
+    if (!free_lists[size] && grow(size) < 0) return NULL;
+
+    FreeBlock *b = free_lists[size];
+    free_lists[size] = b->next;
+    memset(b, 0, 2 * (size_t)size * (size_t)size);
+    return (unsigned char *)b;
+}
+
+void board_free(int size, unsigned char *block) {
+    if (!block) return;
+    FreeBlock *b = (FreeBlock *)block;
+    b->next = free_lists[size];
+    free_lists[size] = b;
+}
+
+size_t board_pool_bytes(void) {
+    return slab_bytes;
+}
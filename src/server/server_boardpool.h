@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+
+// Per-size pools for game boards. A block holds a game's board and
+// prev_board (2 * size * size bytes, rounded up to whole cache lines),
+// so a 9x9 game needs 192 bytes whatever BOARD_MAX_SIZE is. Blocks come
+// from slabs that are never returned to the system; freed blocks go on a
+// free list for their size. Used from the select() loop thread only.
+
+#define BOARD_SLAB_BLOCKS 32
+
+// zeroed block for a size x size game, NULL if out of memory
+unsigned char *board_alloc(int size);
+void board_free(int size, unsigned char *block);
+
+// bytes held in slabs, in use or free
+size_t board_pool_bytes(void);
@@ -0,0 +1,180 @@
+// server_book.c
+// Lookup is a binary search on the mapped entries for the first entry of
+// the canonical key, then a scan over that position's moves. In a position
+// with its own symmetry several orientations share the canonical key; the
+// builder stores the smallest image of a move over all of them, so mirror
+// moves are counted together, and mapping it back through any one of them
+// gives a move equivalent to the one played.
+
+#include "server_book.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BOOK_SEED 0x9b05688c2b3e6c1full
+#define BOOK_CAND_MAX 64
+
+static const BookEntry *entries;
+static uint64_t entry_count;
+static void *map_base;
+static size_t map_len;
+
+static uint64_t mix64(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t point_key(int size, int color, int idx) {
+    return mix64(BOOK_SEED ^ ((uint64_t)size << 40) ^ ((uint64_t)color << 32) ^ (uint64_t)idx);
+}
+
+int book_sym_move(int size, int sym, int idx) {
+    int x = idx % size, y = idx / size;
+    if (sym & 1) x = size - 1 - x;
+    if (sym & 2) y = size - 1 - y;
+    if (sym & 4) { int t = x; x = y; y = t; }
+    return y * size + x;
+}
+
+int book_unsym_move(int size, int sym, int idx) {
+    int x = idx % size, y = idx / size;
+    if (sym & 4) { int t = x; x = y; y = t; }
+    if (sym & 2) y = size - 1 - y;
+    if (sym & 1) x = size - 1 - x;
+    return y * size + x;
+}
+
+static void sym_hashes(const Game *g, uint64_t h[8]) {
+    uint64_t base = mix64(BOOK_SEED ^ (uint64_t)g->size) ^ (g->to_move ? mix64(~BOOK_SEED) : 0);
+    for (int s = 0; s < 8; s++) h[s] = base;
+
+    int n = g->size * g->size;
+    for (int i = 0; i < n; i++) {
+        int c = g->board[i];
+        if (!c) continue;
+        for (int s = 0; s < 8; s++) h[s] ^= point_key(g->size, c, book_sym_move(g->size, s, i));
+    }
+}
+
+uint64_t book_canonical(const Game *g, int *sym) {
+    uint64_t h[8];
+    sym_hashes(g, h);
+    int best = 0;
+    for (int s = 1; s < 8; s++) {
+        if (h[s] < h[best]) best = s;
+    }
+    if (sym) *sym = best;
+    return h[best];
+}
+
+int book_canonical_move(const Game *g, int idx) {
+    uint64_t h[8];
+    sym_hashes(g, h);
+    uint64_t key = book_canonical(g, NULL);
+    int best = -1;
+    for (int s = 0; s < 8; s++) {
+        if (h[s] != key) continue;
+        int m = book_sym_move(g->size, s, idx);
+        if (best < 0 || m < best) best = m;
+    }
+    return best;
+}
+
+void book_close(void) {
+    if (map_base) munmap(map_base, map_len);
+    map_base = NULL;
+    map_len = 0;
+    entries = NULL;
+    entry_count = 0;
+}
+
+int book_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BookHeader)) {
+        fprintf(stderr, "%s: not an opening book\n", path);
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    const BookHeader *hdr = p;
+    if (memcmp(hdr->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) != 0 || hdr->version != BOOK_VERSION ||
+        hdr->count > ((size_t)st.st_size - sizeof(BookHeader)) / sizeof(BookEntry)) {
+        fprintf(stderr, "%s: bad opening book header\n", path);
+        munmap(p, (size_t)st.st_size);
+        return -1;
+    }
+    madvise(p, (size_t)st.st_size, MADV_RANDOM);
+
+    book_close();
+    map_base = p;
+    map_len = (size_t)st.st_size;
+    entries = (const BookEntry *)((const char *)p + sizeof(BookHeader));
+    entry_count = hdr->count;
+    return 0;
+}
+
+uint64_t book_size(void) {
+    return entry_count;
+}
+
+int book_pick(const Game *g, unsigned *rng) {
+    if (!entries) return -1;
+
+    int sym;
+    uint64_t key = book_canonical(g, &sym);
+
+    uint64_t lo = 0, hi = entry_count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+
+    unsigned char scratch[2 * BOARD_CELLS_MAX];
+    int cand[BOOK_CAND_MAX];
+    unsigned weight[BOOK_CAND_MAX];
+    int ncand = 0;
+    unsigned total = 0;
+    int n = g->size * g->size;
+    for (uint64_t i = lo; i < entry_count && entries[i].key == key && ncand < BOOK_CAND_MAX; i++) {
+        const BookEntry *e = &entries[i];
+        if (e->plays < BOOK_MIN_PLAYS || e->move >= n) continue;
+
+        int mv = book_unsym_move(g->size, sym, e->move);
+        Game tmp;
+        game_copy(&tmp, g, scratch);
+        if (game_play_move(&tmp, g->to_move, mv % g->size, mv / g->size) != MOVE_OK) continue;
+
+        // favour moves that won, but keep every played move possible
+        cand[ncand] = mv;
+        weight[ncand] = (unsigned)e->plays + 2u * e->wins;
+        total += weight[ncand++];
+    }
+    if (ncand == 0) return -1;
+
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 17;
+    *rng ^= *rng << 5;
+    unsigned r = *rng % total;
+    for (int i = 0; i < ncand; i++) {
+        if (r < weight[i]) return cand[i];
+        r -= weight[i];
+    }
+    return cand[ncand - 1];
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include "server_game.h"
+
+// Opening book: a read-only file of move statistics keyed by position.
+// Positions are hashed with stateless keys (independent of the engine's
+// tables) under all 8 board symmetries and the smallest hash is the
+// canonical key; moves are stored in that canonical orientation. The file
+// is a header followed by entries sorted by (key, move), mapped with mmap
+// so every server process shares it through the page cache.
+// Multi-byte fields are little-endian (host order on x86/arm64).
+
+#define BOOK_MAGIC "GOBOOK1"
+#define BOOK_VERSION 1
+#define BOOK_MAX_PLY 30       // builder records this many moves per game
+#define BOOK_MIN_PLAYS 2      // a move needs this many games to be picked
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;           // entries that follow
+} BookHeader;
+
+typedef struct
+{
+    uint64_t key;             // canonical position hash, side to move included
+    uint16_t move;            // y * size + x in the canonical orientation
+    uint16_t plays;           // games that played it (saturating)
+    uint16_t wins;            // of those, games won by the player to move
+    uint16_t reserved;
+} BookEntry;
+
+_Static_assert(sizeof(BookHeader) == 24, "BookHeader layout");
+_Static_assert(sizeof(BookEntry) == 16, "BookEntry layout");
+
+// canonical key of g and the symmetry (0..7) that produces it
+uint64_t book_canonical(const Game *g, int *sym);
+
+// canonical form of move idx in g (smallest image over orientations
+// that give the canonical key); what the builder stores
+int book_canonical_move(const Game *g, int idx);
+
+// map board index idx through symmetry sym, and back
+int book_sym_move(int size, int sym, int idx);
+int book_unsym_move(int size, int sym, int idx);
+
+// map path read-only; 0 on success (replaces any open book)
+int book_open(const char *path);
+void book_close(void);
+
+// entries loaded (0 if no book)
+uint64_t book_size(void);
+
+// pick a book move for g->to_move weighted by plays; board index or -1 if out of book
+int book_pick(const Game *g, unsigned *rng);
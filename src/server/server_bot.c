@@ -0,0 +1,348 @@
+// server_bot.c
+// UCT/MCTS engine. The tree walk and playouts run on PlayoutBoard;
+// root moves are also checked against server_rules.c for exact ko.
+// Threads share one tree without locks: visit/win counters are atomics,
+// a descending thread adds a virtual loss (visit without win) so siblings
+// spread over different branches, and expansion is claimed with a CAS.
+// Every backed-up position is also added to the transposition table, and
+// selection uses the table's win rate when it has seen a child position
+// more often than this tree has (other move orders, earlier moves).
+
+#include "server_bot.h"
+#include "server_playout.h"
+#include "server_tt.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define UCT_C 0.8
+#define MAX_BOT_THREADS 64
+
+enum { NODE_LEAF = 0, NODE_EXPANDING = 1, NODE_EXPANDED = 2 };
+
+typedef struct
+{
+    int move;            // PlayoutBoard point or PB_PASS
+    int first_child;     // index in pool
+    int nchildren;
+    atomic_int state;    // NODE_*
+    atomic_int visits;   // includes virtual losses in flight
+    atomic_int wins;     // wins for the player who played move
+    _Atomic uint64_t hash; // position after move, 0 until first played
+} Node;
+
+struct BotTree
+{
+    Node *nodes;
+};
+
+typedef struct
+{
+    const Game *root;
+    PlayoutBoard root_pb;
+    PlayoutBoard scratch;   // root expansion only, before workers start
+    const BotConfig *cfg;
+    Node *nodes;
+    atomic_int node_count;
+    atomic_long playouts;
+    atomic_long tt_lookups;
+    atomic_long tt_hits;
+    atomic_int stop;
+    struct timespec start;
+} Search;
+
+typedef struct
+{
+    Search *s;
+    unsigned rng;
+    long tt_lookups;
+    long tt_hits;
+} Worker;
+
+static double elapsed_since(const struct timespec *t0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - t0->tv_sec) + (double)(now.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+void bot_config_default(BotConfig *cfg) {
+    cfg->threads = 0;
+    cfg->playouts = 0;
+    cfg->time_ms = 1000;
+    cfg->policy = BOT_POLICY_PATTERN;
+    cfg->tt_mb = TT_DEFAULT_MB;
+}
+
+BotTree *bot_tree_new(void) {
+    BotTree *t = malloc(sizeof(*t));
+    if (!t) return NULL;
+    t->nodes = malloc(sizeof(Node) * BOT_TREE_NODES);
+    if (!t->nodes) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void bot_tree_free(BotTree *t) {
+    if (!t) return;
+    free(t->nodes);
+    free(t);
+}
+
+size_t bot_tree_bytes(void) {
+    return sizeof(BotTree) + sizeof(Node) * BOT_TREE_NODES;
+}
+
+int bot_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (int)n;
+}
+
+// claim and fill children of node; returns 0 if another thread owns it
+static int expand(Search *s, Node *node, const PlayoutBoard *pos, const Game *root) {
+    int expected = NODE_LEAF;
+    if (!atomic_compare_exchange_strong(&node->state, &expected, NODE_EXPANDING))
+        return 0;
+
+    int me = (pos->to_move == 0 ? PB_BLACK : PB_WHITE);
+    int moves[BOARD_CELLS_MAX + 1];
+    int cnt = 0;
+    unsigned char storage[2 * BOARD_CELLS_MAX];
+
+    for (int i = 0; i < pos->empty_count; i++) {
+        int p = pos->empty[i];
+        if (pb_is_eye(pos, p, me) || !pb_is_legal(pos, p)) continue;
+        if (root) {
+            // PlayoutBoard only knows simple ko from its own moves
+            Game scratch;
+            game_copy(&scratch, root, storage);
+            int gi = pb_game_idx(pos, p);
+            if (game_play_move(&scratch, root->to_move, gi % root->size, gi / root->size) != MOVE_OK)
+                continue;
+        }
+        moves[cnt++] = p;
+    }
+    moves[cnt++] = PB_PASS;
+
+    int first = atomic_fetch_add(&s->node_count, cnt);
+    if (first + cnt > BOT_TREE_NODES) {
+        atomic_store(&node->state, NODE_LEAF); // tree full, keep as leaf
+        return 0;
+    }
+
+    for (int i = 0; i < cnt; i++) {
+        Node *ch = &s->nodes[first + i];
+        ch->move = moves[i];
+        ch->first_child = 0;
+        ch->nchildren = 0;
+        atomic_init(&ch->state, NODE_LEAF);
+        atomic_init(&ch->visits, 0);
+        atomic_init(&ch->wins, 0);
+        atomic_init(&ch->hash, 0);
+        if (root) {
+            // root children get their hash up front so earlier searches count at once
+            PlayoutBoard *after = &s->scratch;
+            pb_copy(after, pos);
+            pb_play(after, moves[i]);
+            atomic_init(&ch->hash, after->hash);
+        }
+    }
+    node->first_child = first;
+    node->nchildren = cnt;
+    atomic_store_explicit(&node->state, NODE_EXPANDED, memory_order_release);
+    return 1;
+}
+
+// win rate of ch, from the transposition table when it knows more
+static double child_value(Worker *w, Node *ch, int v) {
+    int wins = atomic_load_explicit(&ch->wins, memory_order_relaxed);
+    uint64_t h = atomic_load_explicit(&ch->hash, memory_order_relaxed);
+    if (h) {
+        w->tt_lookups++;
+        const TTEntry *e = tt_probe(h);
+        if (e) {
+            uint32_t tv = atomic_load_explicit(&e->visits, memory_order_relaxed);
+            uint32_t tw = atomic_load_explicit(&e->wins, memory_order_relaxed);
+            if (tv > (uint32_t)v && tw <= tv) {
+                w->tt_hits++;
+                return (double)tw / tv;
+            }
+        }
+    }
+    return v > 0 ? (double)wins / v : 0.5;
+}
+
+static Node *select_child(Worker *w, Node *node) {
+    Search *s = w->s;
+    int parent_visits = atomic_load_explicit(&node->visits, memory_order_relaxed);
+    double log_n = log((double)(parent_visits + 1));
+    Node *best = NULL;
+    double best_v = -1.0;
+
+    for (int i = 0; i < node->nchildren; i++) {
+        Node *ch = &s->nodes[node->first_child + i];
+        int v = atomic_load_explicit(&ch->visits, memory_order_relaxed);
+        if (v == 0 && !atomic_load_explicit(&ch->hash, memory_order_relaxed)) return ch;
+        double val = child_value(w, ch, v) + UCT_C * sqrt(log_n / (v + 1));
+        if (val > best_v) { best_v = val; best = ch; }
+    }
+    return best;
+}
+
+static void search_once(Worker *w) {
+    Search *s = w->s;
+    Node *path[BOARD_CELLS_MAX * 3];
+    int movers[BOARD_CELLS_MAX * 3];
+    int depth = 0;
+
+    PlayoutBoard pos;
+    pb_copy(&pos, &s->root_pb);
+    Node *node = &s->nodes[0];
+    atomic_fetch_add_explicit(&node->visits, 1, memory_order_relaxed);
+    path[depth] = node;
+    movers[depth++] = -1;
+
+    const int max_depth = (int)(sizeof(path) / sizeof(path[0]));
+    while (depth < max_depth && pos.passes < 2) {
+        if (atomic_load_explicit(&node->state, memory_order_acquire) != NODE_EXPANDED) {
+            if (atomic_load_explicit(&node->visits, memory_order_relaxed) < 2 || !expand(s, node, &pos, NULL))
+                break;
+        }
+        Node *ch = select_child(w, node);
+        if (!ch) break;
+        // virtual loss: count the visit now, the win only at backup
+        atomic_fetch_add_explicit(&ch->visits, 1, memory_order_relaxed);
+        int mover = pos.to_move;
+        pb_play(&pos, ch->move);
+        if (!atomic_load_explicit(&ch->hash, memory_order_relaxed))
+            atomic_store_explicit(&ch->hash, pos.hash, memory_order_relaxed);
+        node = ch;
+        path[depth] = node;
+        movers[depth++] = mover;
+    }
+
+    int winner = pb_playout(&pos, &w->rng, BOT_KOMI);
+    for (int i = 1; i < depth; i++) {
+        int win = (movers[i] == winner);
+        if (win) atomic_fetch_add_explicit(&path[i]->wins, 1, memory_order_relaxed);
+        uint64_t h = atomic_load_explicit(&path[i]->hash, memory_order_relaxed);
+        if (h) tt_update(h, i, win);
+    }
+    atomic_fetch_add_explicit(&s->playouts, 1, memory_order_relaxed);
+}
+
+static int budget_exhausted(Search *s) {
+    if (atomic_load_explicit(&s->stop, memory_order_relaxed)) return 1;
+    const BotConfig *cfg = s->cfg;
+    if (cfg->playouts > 0 &&
+        atomic_load_explicit(&s->playouts, memory_order_relaxed) >= cfg->playouts)
+        return 1;
+    if (cfg->time_ms > 0 && elapsed_since(&s->start) * 1000.0 >= cfg->time_ms)
+        return 1;
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = (Worker *)arg;
+    while (!budget_exhausted(w->s))
+        search_once(w);
+    atomic_store(&w->s->stop, 1);
+    atomic_fetch_add(&w->s->tt_lookups, w->tt_lookups);
+    atomic_fetch_add(&w->s->tt_hits, w->tt_hits);
+    return NULL;
+}
+
+int bot_genmove(const Game *g, const BotConfig *cfg, BotTree *tree, BotStats *st) {
+    BotConfig local = *cfg;
+    if (local.playouts <= 0 && local.time_ms <= 0) local.time_ms = 1000;
+
+    int threads = local.threads > 0 ? local.threads : bot_cpu_count();
+    if (threads > MAX_BOT_THREADS) threads = MAX_BOT_THREADS;
+
+    Search s;
+    s.root = g;
+    pb_from_game(&s.root_pb, g);
+    if (local.policy == BOT_POLICY_PATTERN) pb_enable_patterns(&s.root_pb);
+    s.cfg = &local;
+    BotTree *temp = NULL;
+    if (!tree && !(tree = temp = bot_tree_new())) return -1;
+    s.nodes = tree->nodes;   // every node is initialised when its parent expands
+    atomic_init(&s.node_count, 1);
+    atomic_init(&s.playouts, 0);
+    atomic_init(&s.tt_lookups, 0);
+    atomic_init(&s.tt_hits, 0);
+    atomic_init(&s.stop, 0);
+    if (local.tt_mb > 0) tt_ensure((size_t)local.tt_mb);
+    clock_gettime(CLOCK_MONOTONIC, &s.start);
+
+    Node *root = &s.nodes[0];
+    root->move = PB_PASS;
+    root->first_child = 0;
+    root->nchildren = 0;
+    atomic_init(&root->state, NODE_LEAF);
+    atomic_init(&root->visits, 0);
+    atomic_init(&root->wins, 0);
+    atomic_init(&root->hash, s.root_pb.hash);
+    expand(&s, root, &s.root_pb, g);
+
+    Worker workers[MAX_BOT_THREADS];
+    pthread_t tids[MAX_BOT_THREADS];
+    unsigned seed = (unsigned)time(NULL) ^ (unsigned)g->id * 2654435761u;
+    for (int i = 0; i < threads; i++) {
+        workers[i].s = &s;
+        workers[i].rng = (seed + (unsigned)i * 0x9e3779b9u) | 1u;
+        workers[i].tt_lookups = 0;
+        workers[i].tt_hits = 0;
+    }
+
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, worker_main, &workers[i]) != 0) break;
+        started++;
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < started; i++) pthread_join(tids[i], NULL);
+
+    int best = PB_PASS;
+    int best_visits = -1;
+    double winrate = 0.0;
+    for (int i = 0; i < root->nchildren; i++) {
+        Node *ch = &s.nodes[root->first_child + i];
+        int v = atomic_load(&ch->visits);
+        if (v > best_visits) {
+            best_visits = v;
+            best = ch->move;
+            winrate = v > 0 ? (double)atomic_load(&ch->wins) / v : 0.0;
+        }
+    }
+
+    if (st) {
+        st->playouts = atomic_load(&s.playouts);
+        st->nodes = atomic_load(&s.node_count);
+        if (st->nodes > BOT_TREE_NODES) st->nodes = BOT_TREE_NODES;
+        st->threads = started;
+        st->seconds = elapsed_since(&s.start);
+        st->winrate = winrate;
+        st->tt_lookups = atomic_load(&s.tt_lookups);
+        st->tt_hits = atomic_load(&s.tt_hits);
+        st->tt_bytes = local.tt_mb > 0 ? tt_bytes() : 0;
+    }
+
+    bot_tree_free(temp);
+    return best == PB_PASS ? -1 : pb_game_idx(&s.root_pb, best);
+}
+
+void bot_format_stats(const BotStats *st, char *out, size_t outsz) {
+    double pps = st->seconds > 0 ? (double)st->playouts / st->seconds : 0.0;
+    double hit = st->tt_lookups > 0 ? 100.0 * (double)st->tt_hits / (double)st->tt_lookups : 0.0;
+    snprintf(out, outsz, "playouts=%ld pps=%.0f nodes=%ld threads=%d time=%.3fs winrate=%.3f"
+             " tt_hit=%.1f%% tt_mb=%.1f",
+             st->playouts, pps, st->nodes, st->threads, st->seconds, st->winrate,
+             hit, (double)st->tt_bytes / (1024.0 * 1024.0));
+}
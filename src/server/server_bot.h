@@ -0,0 +1,54 @@
+#pragma once
+#include "server_game.h"
+
+// UCT/MCTS bot engine with lock-free tree parallelism
+
+#define BOT_KOMI 6.5
+#define BOT_TREE_NODES (1 << 20)
+
+typedef enum
+{
+    BOT_POLICY_LIGHT,    // uniform random playouts
+    BOT_POLICY_PATTERN   // 3x3 pattern weighted playouts
+} BotPolicy;
+
+typedef struct
+{
+    int threads;      // search threads, 0 = all cores
+    int playouts;     // playout budget per move, 0 = no limit
+    int time_ms;      // time budget per move, 0 = no limit
+    BotPolicy policy; // playout policy
+    int tt_mb;        // transposition table budget in MB, 0 = off
+} BotConfig;
+
+typedef struct
+{
+    long playouts;    // playouts run for the last move
+    long nodes;       // tree nodes allocated
+    int threads;      // threads actually used
+    double seconds;   // wall time spent searching
+    double winrate;   // root win rate of the chosen move
+    long tt_lookups;  // transposition table probes
+    long tt_hits;     // probes where the table knew more than the tree
+    size_t tt_bytes;  // transposition table footprint
+} BotStats;
+
+// node arena for one search at a time, reused across moves
+typedef struct BotTree BotTree;
+
+void bot_config_default(BotConfig *cfg);
+
+// number of online cores (at least 1)
+int bot_cpu_count(void);
+
+// BOT_TREE_NODES nodes; NULL on allocation failure
+BotTree *bot_tree_new(void);
+void bot_tree_free(BotTree *t);
+size_t bot_tree_bytes(void);
+
+// choose a move for g->to_move; returns board index or -1 for pass.
+// The search runs in tree, or in a temporary arena when tree is NULL.
+int bot_genmove(const Game *g, const BotConfig *cfg, BotTree *tree, BotStats *st);
+
+// one-line summary of st for logs and benchmarks
+void bot_format_stats(const BotStats *st, char *out, size_t outsz);
@@ -0,0 +1,198 @@
+// server_botpool.c
+// Worker threads for bot moves. The select() loop never runs a search:
+// it copies the Game into a job and pushes it onto a lock-free ring, then
+// bumps a semaphore eventfd so exactly one idle worker wakes up. Results
+// go back through a second ring; each one adds to a plain eventfd that is
+// part of the loop's read set, so one select() wakeup drains a whole batch.
+// Search threads are paid for with tokens: the pool holds one per worker,
+// a search takes what it may before starting and returns them when done,
+// so running searches never add up to more threads than the pool's cores.
+
+#include "server_botpool.h"
+#include "server_ring.h"
+#include "server_book.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+#define MAX_POOL_WORKERS 256
+
+typedef struct
+{
+    int gid;
+    int ply;
+    Game pos;
+    BotConfig cfg;
+    unsigned char boards[];   // pos.board and pos.prev_board
+} BotJob;
+
+static Ring jobs;
+static Ring results;
+static int job_efd = -1;     // EFD_SEMAPHORE: one read per queued job
+static int result_efd = -1;  // watched by the select() loop
+static int nworkers;
+static _Atomic int pending;  // submitted and not yet posted back
+static _Atomic int queued;   // submitted and not yet picked up by a worker
+
+static pthread_mutex_t token_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t token_cond = PTHREAD_COND_INITIALIZER;
+static int tokens_free;      // search threads not in use
+
+typedef struct
+{
+    int id;
+    BotTree *tree;           // this worker's search arena, reused every move
+} PoolWorker;
+
+static PoolWorker pool[MAX_POOL_WORKERS];
+
+static void efd_add(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+// Take up to want thread tokens, at least one; waits while none are free.
+// Jobs still queued behind this one keep a share of what is left.
+static int tokens_take(int want) {
+    pthread_mutex_lock(&token_lock);
+    while (tokens_free == 0) pthread_cond_wait(&token_cond, &token_lock);
+    int share = tokens_free / (1 + atomic_load(&queued));
+    if (share < 1) share = 1;
+    int n = want < share ? want : share;
+    tokens_free -= n;
+    pthread_mutex_unlock(&token_lock);
+    return n;
+}
+
+static void tokens_give(int n) {
+    pthread_mutex_lock(&token_lock);
+    tokens_free += n;
+    pthread_cond_broadcast(&token_cond);
+    pthread_mutex_unlock(&token_lock);
+}
+
+static void *worker_main(void *arg) {
+    PoolWorker *pw = (PoolWorker *)arg;
+    unsigned rng = ((unsigned)time(NULL) ^ (unsigned)pw->id * 2654435761u) | 1u;
+    for (;;) {
+        uint64_t n;
+        if (read(job_efd, &n, sizeof(n)) < 0) {
+            if (errno == EINTR) continue;
+            perror("botpool read");
+            return NULL;
+        }
+        BotJob *job = ring_pop(&jobs);
+        if (!job) continue;
+        atomic_fetch_sub(&queued, 1);
+
+        BotResult *r = malloc(sizeof(*r));
+        if (!r) {
+            free(job);
+            atomic_fetch_sub(&pending, 1);
+            continue;
+        }
+        memset(&r->stats, 0, sizeof(r->stats));
+        r->gid = job->gid;
+        r->ply = job->ply;
+        r->move = -1;
+        r->from_book = 0;
+        if (job->pos.ply < BOOK_MAX_PLY) r->move = book_pick(&job->pos, &rng);
+        if (r->move >= 0) r->from_book = 1;
+        else {
+            int want = job->cfg.threads;
+            if (want <= 0 || want > nworkers) want = nworkers;
+            job->cfg.threads = tokens_take(want);
+            r->move = bot_genmove(&job->pos, &job->cfg, pw->tree, &r->stats);
+            tokens_give(job->cfg.threads);
+        }
+        free(job);
+
+        // results ring is as large as the job ring, so this cannot fail
+        while (ring_push(&results, r) < 0) sched_yield();
+        efd_add(result_efd);
+    }
+    return NULL;
+}
+
+int botpool_start(int workers) {
+    if (workers < 1) workers = 1;
+    if (workers > MAX_POOL_WORKERS) workers = MAX_POOL_WORKERS;
+
+    if (ring_init(&jobs, BOT_QUEUE_CAP) < 0 || ring_init(&results, BOT_QUEUE_CAP) < 0) return -1;
+    job_efd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+    result_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (job_efd < 0 || result_efd < 0) return -1;
+
+    for (int i = 0; i < workers; i++) {
+        PoolWorker *pw = &pool[i];
+        pw->id = i + 1;
+        pw->tree = bot_tree_new();
+        if (!pw->tree) break;
+        pthread_t th;
+        if (pthread_create(&th, NULL, worker_main, pw) != 0) {
+            bot_tree_free(pw->tree);
+            pw->tree = NULL;
+            break;
+        }
+        pthread_detach(th);
+        nworkers++;
+    }
+    tokens_free = nworkers;
+    return nworkers > 0 ? result_efd : -1;
+}
+
+int botpool_workers(void) {
+    return nworkers;
+}
+
+size_t botpool_tree_bytes(void) {
+    return (size_t)nworkers * bot_tree_bytes();
+}
+
+int botpool_submit(const Game *g, const BotConfig *cfg) {
+    if (atomic_load(&pending) >= BOT_QUEUE_CAP) return -1;
+
+    BotJob *job = malloc(sizeof(*job) + 2 * (size_t)g->size * (size_t)g->size);
+    if (!job) return -1;
+    job->gid = g->id;
+    job->ply = g->ply;
+    game_copy(&job->pos, g, job->boards);
+    job->cfg = *cfg;
+
+    atomic_fetch_add(&pending, 1);
+    atomic_fetch_add(&queued, 1);
+    if (ring_push(&jobs, job) < 0) {
+        atomic_fetch_sub(&pending, 1);
+        atomic_fetch_sub(&queued, 1);
+        free(job);
+        return -1;
+    }
+    efd_add(job_efd);
+    return 0;
+}
+
+int botpool_pending(void) {
+    return atomic_load(&pending);
+}
+
+void botpool_ack(void) {
+    uint64_t n;
+    while (read(result_efd, &n, sizeof(n)) < 0 && errno == EINTR) {}
+}
+
+int botpool_poll(BotResult *out) {
+    BotResult *r = ring_pop(&results);
+    if (!r) return 0;
+    *out = *r;
+    free(r);
+    atomic_fetch_sub(&pending, 1);
+    return 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "server_bot.h"
+
+// Bot worker pool: engine searches run off the select() thread.
+// The loop submits a copy of the position; workers pick jobs from a
+// lock-free ring (woken through a semaphore eventfd) and post results to
+// a second ring, signalling an eventfd the loop watches with select().
+
+#define BOT_QUEUE_CAP 4096
+#define BOT_GAMES_PER_CPU 8   // humans think far longer than the bot
+#define BOT_MIN_MS 50         // floor for the per-move budget under load
+
+typedef struct
+{
+    int gid;
+    int ply;          // g->ply when submitted, stale results are dropped
+    int move;         // board index or -1 pass
+    int from_book;    // move came from the opening book, stats are empty
+    BotStats stats;
+} BotResult;
+
+// start workers; the worker count is also the budget of search threads
+// shared by all running searches (cfg.threads 0 = as many as are free).
+// Returns the eventfd to watch for results, -1 on error
+int botpool_start(int workers);
+
+int botpool_workers(void);
+
+// bytes held by the workers' search trees
+size_t botpool_tree_bytes(void);
+
+// queue a search of g with cfg; 0 on success, -1 if the queue is full
+int botpool_submit(const Game *g, const BotConfig *cfg);
+
+// jobs queued or being searched
+int botpool_pending(void);
+
+// clear the result eventfd, then call botpool_poll until it returns 0
+void botpool_ack(void);
+int botpool_poll(BotResult *out);
@@ -0,0 +1,218 @@
+// server_capture.c
+
+#include "server_capture.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static int cfd = -1;
+static int active;
+static Buf fill, flush;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static CaptureStats stats;
+
+// loop thread only
+static Buf stage;
+static uint64_t last_us;
+static uint64_t staged_records;
+
+static uint64_t mono_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000ull + (uint64_t)t.tv_nsec / 1000;
+}
+
+static size_t put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+static int reserve(Buf *b, size_t more) {
+    if (b->len + more <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap * 2 : 1 << 16;
+    while (cap < b->len + more) cap *= 2;
+    unsigned char *d = realloc(b->data, cap);
+    if (!d) return -1;
+    b->data = d;
+    b->cap = cap;
+    return 0;
+}
+
+static void write_out(const unsigned char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(cfd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            perror("capture write");
+            return;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (fill.len == 0) pthread_cond_wait(&wake, &lock);
+        Buf t = flush;
+        flush = fill;
+        fill = t;
+        fill.len = 0;
+        pthread_mutex_unlock(&lock);
+
+        write_out(flush.data, flush.len);
+
+        pthread_mutex_lock(&lock);
+        stats.bytes += flush.len;
+    }
+    return NULL;
+}
+
+int capture_open(const char *path, uint32_t seed) {
+    cfd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (cfd < 0) {
+        perror("capture open");
+        return -1;
+    }
+    CaptureHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    h.version = CAPTURE_VERSION;
+    h.seed = seed;
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    h.start_ns = (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+    write_out((const unsigned char *)&h, sizeof(h));
+    stats.bytes = sizeof(h);
+    last_us = mono_us();
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, writer_main, NULL) != 0) {
+        perror("capture thread");
+        close(cfd);
+        cfd = -1;
+        return -1;
+    }
+    pthread_detach(th);
+    active = 1;
+    return 0;
+}
+
+int capture_enabled(void) {
+    return active;
+}
+
+static void record(int kind, uint32_t conn, const char *line, size_t len) {
+    if (!active || reserve(&stage, 1 + 3 * 10 + len) < 0) return;
+    uint64_t now = mono_us();
+    unsigned char *p = stage.data + stage.len;
+    size_t n = 0;
+    p[n++] = (unsigned char)kind;
+    n += put_varint(p + n, now - last_us);
+    n += put_varint(p + n, conn);
+    if (kind == CAPTURE_LINE) {
+        n += put_varint(p + n, len);
+        memcpy(p + n, line, len);
+        n += len;
+    }
+    stage.len += n;
+    last_us = now;
+    staged_records++;
+}
+
+void capture_conn_open(uint32_t conn) {
+    record(CAPTURE_OPEN, conn, NULL, 0);
+}
+
+void capture_conn_close(uint32_t conn) {
+    record(CAPTURE_CLOSE, conn, NULL, 0);
+}
+
+void capture_line(uint32_t conn, const char *line, size_t len) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    record(CAPTURE_LINE, conn, line, len);
+}
+
+void capture_tick(void) {
+    if (!active || stage.len == 0) return;
+    pthread_mutex_lock(&lock);
+    if (fill.len == 0) {
+        // usual case: the writer is idle, swap buffers instead of copying
+        Buf t = fill;
+        fill = stage;
+        stage = t;
+    } else if (reserve(&fill, stage.len) == 0) {
+        memcpy(fill.data + fill.len, stage.data, stage.len);
+        fill.len += stage.len;
+    }
+    stage.len = 0;
+    stats.records += staged_records;
+    staged_records = 0;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+void capture_stats(CaptureStats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+// ---- reader ----
+
+int capture_read_header(FILE *f, CaptureHeader *h) {
+    if (fread(h, sizeof(*h), 1, f) != 1) return -1;
+    if (memcmp(h->magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || h->version != CAPTURE_VERSION) return -1;
+    return 0;
+}
+
+static int read_varint(FILE *f, uint64_t *v) {
+    uint64_t r = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(f);
+        if (c == EOF) return -1;
+        r |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *v = r;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int capture_next(FILE *f, CaptureRecord *r) {
+    int kind = getc(f);
+    if (kind == EOF) return 0;
+    uint64_t dt, conn, len = 0;
+    if (kind < CAPTURE_OPEN || kind > CAPTURE_CLOSE || read_varint(f, &dt) < 0 || read_varint(f, &conn) < 0)
+        return -1;
+    if (kind == CAPTURE_LINE) {
+        if (read_varint(f, &len) < 0 || len >= sizeof(r->line)) return -1;
+        if (fread(r->line, 1, (size_t)len, f) != (size_t)len) return -1;
+    }
+    r->line[len] = '\0';
+    r->kind = kind;
+    r->t_us += dt;
+    r->conn = (uint32_t)conn;
+    r->len = (size_t)len;
+    return 1;
+}
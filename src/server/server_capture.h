@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "server_game.h"
+
+// Traffic capture: every inbound protocol line with its time and
+// connection, for tools/replay to play back against a fresh server. The
+// loop encodes records into a staging buffer of its own and hands that
+// over once per iteration (capture_tick); a background thread writes the
+// batches, as the journal and the archive do, so capturing costs the loop
+// a few byte stores per line.
+//
+// File: header (CaptureHeader), then records:
+//   u8 kind (CaptureKind), varint microseconds since the previous record,
+//   varint connection id (1, 2, ... in accept order; fds are reused),
+//   LINE only: varint length, the line without its newline.
+// The rand() seed is kept so the replay target can be started with it and
+// make the same random choices (colours of HOST ... R).
+
+#define CAPTURE_MAGIC "GOCAP1"
+#define CAPTURE_VERSION 1
+#define CAPTURE_LINE_MAX BUF_SIZE
+
+typedef enum
+{
+    CAPTURE_OPEN = 1,
+    CAPTURE_LINE = 2,
+    CAPTURE_CLOSE = 3
+} CaptureKind;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;            // the server's srand() seed
+    uint64_t start_ns;        // wall clock at capture_open
+} CaptureHeader;
+
+_Static_assert(sizeof(CaptureHeader) == 24, "CaptureHeader layout");
+
+typedef struct
+{
+    int kind;
+    uint64_t t_us;            // since the start of the capture
+    uint32_t conn;
+    size_t len;
+    char line[CAPTURE_LINE_MAX];
+} CaptureRecord;
+
+typedef struct
+{
+    uint64_t records;
+    uint64_t bytes;           // written to the file
+} CaptureStats;
+
+// ---- server side ----
+
+// create path and start the writer; 0 on success
+int capture_open(const char *path, uint32_t seed);
+int capture_enabled(void);
+
+void capture_conn_open(uint32_t conn);
+void capture_conn_close(uint32_t conn);
+void capture_line(uint32_t conn, const char *line, size_t len);
+
+// hand what the loop staged to the writer; once per loop iteration
+void capture_tick(void);
+
+void capture_stats(CaptureStats *out);
+
+// ---- reader side ----
+
+// 0 on success
+int capture_read_header(FILE *f, CaptureHeader *h);
+
+// 1 with the next record, 0 at the end, -1 if the file is damaged;
+// t_us accumulates, so start from a zeroed record and keep reusing it
+int capture_next(FILE *f, CaptureRecord *r);
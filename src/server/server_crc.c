@@ -0,0 +1,24 @@
+// server_crc.c
+// Table-driven, one byte per step; the table is built on first use.
+
+#include "server_crc.h"
+#include <pthread.h>
+
+static uint32_t table[256];
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void init_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const void *p, size_t n) {
+    const unsigned char *b = p;
+    pthread_once(&once, init_table);
+    uint32_t c = crc ^ 0xffffffffu;
+    for (size_t i = 0; i < n; i++) c = table[(c ^ b[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 (IEEE, as zlib). Chainable: start with crc 0 and pass the
+// previous result to continue over more bytes.
+uint32_t crc32_update(uint32_t crc, const void *p, size_t n);
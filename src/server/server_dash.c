@@ -0,0 +1,147 @@
+// server_dash.c
+
+#include "server_dash.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define DASH_READ_TRIES 8
+
+static DashFile *file;
+static DashSlot *filling;
+static int64_t last_ms;
+static DashNote notes[DASH_NOTES];
+static unsigned note_next;          // notes written so far
+
+static uint64_t wall_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000 + (uint64_t)t.tv_nsec / 1000000;
+}
+
+int dash_open(const char *path) {
+    // a new inode rather than truncating: an attached reader would fault
+    unlink(path);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("dash open");
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)sizeof(DashFile)) < 0) {
+        perror("dash truncate");
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, sizeof(DashFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("dash mmap");
+        return -1;
+    }
+    file = p;
+    file->version = DASH_VERSION;
+    file->max_players = DASH_MAX_PLAYERS;
+    file->max_games = DASH_MAX_GAMES;
+    file->pid = (uint32_t)getpid();
+    atomic_store_explicit(&file->gen, 0, memory_order_relaxed);
+    // the magic last: a reader that sees it sees the rest of the header
+    atomic_thread_fence(memory_order_release);
+    memcpy(file->magic, DASH_MAGIC, sizeof(file->magic));
+    return 0;
+}
+
+int dash_enabled(void) {
+    return file != NULL;
+}
+
+int dash_due(int64_t now_ms) {
+    if (!file || now_ms - last_ms < DASH_PERIOD_MS) return 0;
+    last_ms = now_ms;
+    return 1;
+}
+
+DashSnapshot *dash_begin(void) {
+    uint64_t gen = atomic_load_explicit(&file->gen, memory_order_relaxed);
+    filling = &file->slots[(gen + 1) & 1];
+    uint64_t seq = atomic_load_explicit(&filling->seq, memory_order_relaxed);
+    atomic_store_explicit(&filling->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    DashSnapshot *s = &filling->snap;
+    memset(s, 0, offsetof(DashSnapshot, notes));
+    s->taken_ms = wall_ms();
+    unsigned n = note_next < DASH_NOTES ? note_next : DASH_NOTES;
+    for (unsigned i = 0; i < n; i++) s->notes[i] = notes[(note_next - n + i) % DASH_NOTES];
+    s->nnotes = n;
+    return s;
+}
+
+void dash_publish(void) {
+    uint64_t seq = atomic_load_explicit(&filling->seq, memory_order_relaxed);
+    atomic_store_explicit(&filling->seq, seq + 1, memory_order_release);
+    atomic_fetch_add_explicit(&file->gen, 1, memory_order_release);
+    filling = NULL;
+}
+
+void dash_note(const char *text) {
+    if (!file) return;
+    DashNote *n = &notes[note_next++ % DASH_NOTES];
+    n->at_ms = wall_ms();
+    size_t len = strcspn(text, "\r\n");
+    if (len >= sizeof(n->text)) len = sizeof(n->text) - 1;
+    memcpy(n->text, text, len);
+    n->text[len] = '\0';
+}
+
+// ---- reader ----
+
+const DashFile *dash_attach(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)sizeof(DashFile)) {
+        close(fd);
+        return NULL;
+    }
+    void *p = mmap(NULL, sizeof(DashFile), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    const DashFile *f = p;
+    if (memcmp(f->magic, DASH_MAGIC, sizeof(f->magic)) != 0 || f->version != DASH_VERSION ||
+        f->max_players != DASH_MAX_PLAYERS || f->max_games != DASH_MAX_GAMES) {
+        munmap(p, sizeof(DashFile));
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return f;
+}
+
+void dash_detach(const DashFile *f) {
+    munmap((void *)f, sizeof(DashFile));
+}
+
+int dash_read(const DashFile *f, DashSnapshot *out) {
+    DashFile *w = (DashFile *)f;   // atomics are read-only here, C11 wants them mutable
+    for (int t = 0; t < DASH_READ_TRIES; t++) {
+        uint64_t gen = atomic_load_explicit(&w->gen, memory_order_acquire);
+        if (gen == 0) return -1;    // nothing published yet
+        DashSlot *sl = &w->slots[gen & 1];
+        uint64_t s1 = atomic_load_explicit(&sl->seq, memory_order_acquire);
+        if (s1 & 1) continue;
+        memcpy(out, &sl->snap, offsetof(DashSnapshot, players));
+        uint32_t np = out->nplayers < DASH_MAX_PLAYERS ? out->nplayers : DASH_MAX_PLAYERS;
+        uint32_t ng = out->ngames < DASH_MAX_GAMES ? out->ngames : DASH_MAX_GAMES;
+        memcpy(out->players, sl->snap.players, np * sizeof(DashPlayer));
+        memcpy(out->games, sl->snap.games, ng * sizeof(DashGame));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sl->seq, memory_order_relaxed) == s1) {
+            out->nplayers = np;
+            out->ngames = ng;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "server_game.h"
+
+// Dashboard snapshots: the PLAYERS / GAMES / NOTIFICATIONS view of the
+// server, published by the event loop into a shared file for the admin
+// console (tools/admin_dash) to map read-only. The loop fills a snapshot
+// every DASH_PERIOD_MS; nothing ever waits on a reader. The file holds two
+// slots, each guarded by a sequence counter (a seqlock): the writer fills
+// the slot the header does not point at, its counter odd while it writes,
+// then flips the header's generation. A reader copies the current slot
+// and retries if its counter moved meanwhile, which only happens when the
+// writer lapped it. Only the used part of each table is written and read.
+// Multi-byte fields are host order; the file is for processes on this host.
+
+#define DASH_MAGIC "GODASH1"
+#define DASH_VERSION 1
+#define DASH_PERIOD_MS 250
+#define DASH_MAX_PLAYERS MAX_CLIENTS
+#define DASH_MAX_GAMES MAX_GAMES
+#define DASH_NOTES 64
+#define DASH_NOTE_SIZE 56
+
+enum { DASH_IDLE, DASH_HOSTING, DASH_PLAYING, DASH_SEEKING };
+
+typedef struct
+{
+    int32_t fd;
+    uint8_t state;            // DASH_IDLE ...
+    uint8_t subscribed;
+    uint16_t games;           // games the player sits in
+    uint16_t port;
+    uint16_t reserved;
+    char nick[NICK_SIZE];
+    char ip[20];
+} DashPlayer;
+
+typedef struct
+{
+    int32_t id;
+    uint8_t size;
+    uint8_t running;
+    uint8_t vs_bot;
+    uint8_t to_move;          // 0 black, 1 white
+    int32_t ply;
+    uint16_t cap_black;
+    uint16_t cap_white;
+    char host[NICK_SIZE];
+    char guest[NICK_SIZE];
+} DashGame;
+
+typedef struct
+{
+    uint64_t at_ms;           // wall clock
+    char text[DASH_NOTE_SIZE];
+} DashNote;
+
+typedef struct
+{
+    uint64_t taken_ms;        // wall clock of the snapshot
+    uint64_t uptime_s;
+    uint32_t nplayers;
+    uint32_t ngames;
+    uint32_t nnotes;          // notes[0] is the oldest
+    uint32_t bot_games;
+    uint32_t bot_queue;
+    uint32_t seeks;
+    uint64_t journal_records;
+    uint64_t archive_games;
+    uint64_t slow_logged;
+    uint64_t slow_dropped;
+    DashNote notes[DASH_NOTES];
+    DashPlayer players[DASH_MAX_PLAYERS];
+    DashGame games[DASH_MAX_GAMES];
+} DashSnapshot;
+
+typedef struct
+{
+    _Atomic uint64_t seq;     // odd while the writer is inside
+    uint64_t reserved;
+    DashSnapshot snap;
+} DashSlot;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t max_players;
+    uint32_t max_games;
+    uint32_t pid;             // of the publishing server
+    _Atomic uint64_t gen;     // slots[gen & 1] is the latest complete one
+    DashSlot slots[2];
+} DashFile;
+
+_Static_assert(sizeof(DashPlayer) == 64, "DashPlayer layout");
+_Static_assert(sizeof(DashGame) == 80, "DashGame layout");
+_Static_assert(sizeof(DashNote) == 64, "DashNote layout");
+_Static_assert(offsetof(DashFile, slots) == 32, "DashFile layout");
+
+// ---- server side ----
+
+// replace path with a fresh dashboard file; 0 on success. Readers of an
+// older file keep their mapping and notice it went stale.
+int dash_open(const char *path);
+
+int dash_enabled(void);
+
+// 1 when the next snapshot is due
+int dash_due(int64_t now_ms);
+
+// the slot to fill; counters and tables are zeroed, notes filled in
+DashSnapshot *dash_begin(void);
+
+// make the slot from dash_begin the current one
+void dash_publish(void);
+
+// add a line to the notification pane (loop thread only)
+void dash_note(const char *text);
+
+// ---- reader side ----
+
+// map path read-only; NULL on error
+const DashFile *dash_attach(const char *path);
+void dash_detach(const DashFile *f);
+
+// copy the latest snapshot; 0 on success, -1 if every retry was lapped
+int dash_read(const DashFile *f, DashSnapshot *out);
@@ -0,0 +1,17 @@
+// server_fdtab.c
+// Doubling from 64, so an fd costs one realloc per power of two.
+
+#include "server_fdtab.h"
+#include <stdlib.h>
+#include <string.h>
+
+void *fdtab_reserve(void *v, int *cap, size_t elem, int fill, int fd) {
+    if (fd < *cap) return v;
+    int n = *cap ? *cap : 64;
+    while (n <= fd) n *= 2;
+    unsigned char *t = realloc(v, (size_t)n * elem);
+    if (!t) return NULL;
+    memset(t + (size_t)*cap * elem, fill, (size_t)(n - *cap) * elem);
+    *cap = n;
+    return t;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+
+// Tables indexed by fd. The loop, the game table and the matchmaker each
+// keep one; they start empty and double when a connection arrives on an
+// fd at or past the end, so fds need not be small (simulated ones start
+// at 1000000). add_client reserves every table before it accepts an fd.
+
+// grow v, *cap entries of elem bytes, to hold fd; new entries get every
+// byte set to fill (0xff makes int entries -1). Returns the table, moved
+// or not, and updates *cap; NULL if out of memory, with v left as it was.
+void *fdtab_reserve(void *v, int *cap, size_t elem, int fill, int fd);
@@ -1,5 +1,9 @@
 #include "server_game.h"
 #include "server_proto.h"
+#include "server_boardpool.h"
+#include "server_journal.h"
+#include "server_archive.h"
+#include "server_fdtab.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -7,153 +11,183 @@
 static Game games[MAX_GAMES];
 static int game_count = 0;
 static int next_game_id = 1;
+static int bot_games;                // games in the table with vs_bot set
+
+// Hot columns, parallel to games[]: lookups by id scan these (12 bytes a
+// game, five games per cache line) and open a Game record only on a match.
+// Kept in step by create/restore/drop and the seating calls.
+static int game_ids[MAX_GAMES];
+static int seat_fds[MAX_GAMES][2];   // host, guest
+
+// The seats each fd holds form a list threaded through the seat columns,
+// so a player's games are found without a scan. A seat is game index * 2
+// (host) or * 2 + 1 (guest); -1 ends a list.
+static int seat_next[MAX_GAMES * 2], seat_prev[MAX_GAMES * 2];
+static int *fd_seats;                // first seat of each fd
+static int fd_seats_cap;
 
 const char* color_name(int c) { return c==0 ? "BLACK" : "WHITE"; }
 
+int game_host_fd(const Game *g) {
+    return seat_fds[g - games][0];
+}
+
+int game_guest_fd(const Game *g) {
+    return seat_fds[g - games][1];
+}
+
 int opponent_fd(const Game *g, int fd) {
-    if (g->host_fd == fd) return g->guest_fd;
-    if (g->guest_fd == fd) return g->host_fd;
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+    if (host == fd) return guest;
+    if (guest == fd) return host;
     return -1;
 }
 
 int fd_color_in_game(const Game *g, int fd) {
     // return 0 black / 1 white / -1 not in game
-    if (g->host_fd == fd) return g->host_color;
-    if (g->guest_fd == fd) return (g->host_color == 0 ? 1 : 0);
+    if (game_host_fd(g) == fd) return g->host_color;
+    if (game_guest_fd(g) == fd) return (g->host_color == 0 ? 1 : 0);
     return -1;
 }
 
-void game_clear_board(Game *g) {
-    int n = g->size * g->size;
-    for (int i = 0; i < n; i++) {
-        g->board[i] = 0;
-        g->prev_board[i] = 0;
+static int index_of_id(int id) {
+    for (int i = 0; i < game_count; i++) {
+        if (game_ids[i] == id) return i;
     }
-    g->to_move = 0; // black to move
-    g->cap_black = 0;
-    g->cap_white = 0;
-    g->consecutive_passes = 0;
+    return -1;
 }
 
-int game_idx(Game *g, int x, int y) {
-    return y * g->size + x;
+int game_reserve_fd(int fd) {
+    int *t = fdtab_reserve(fd_seats, &fd_seats_cap, sizeof(*fd_seats), 0xff, fd);
+    if (!t) return -1;
+    fd_seats = t;
+    return 0;
 }
 
-int in_bounds(Game *g, int x, int y) {
-    return x >= 0 && y >= 0 && x < g->size && y < g->size;
+static int seat_fd(int seat) {
+    return seat_fds[seat >> 1][seat & 1];
 }
 
-void copy_board(Game *g, unsigned char *dst, const unsigned char *src) {
-    int n = g->size * g->size;
-    for (int i = 0; i < n; i++) dst[i] = src[i];
+static int first_seat(int fd) {
+    return fd >= 0 && fd < fd_seats_cap ? fd_seats[fd] : -1;
 }
 
-int boards_equal(Game *g, const unsigned char *a, const unsigned char *b) {
-    int n = g->size * g->size;
-    for (int i = 0; i < n; i++) if (a[i] != b[i]) return 0;
-    return 1;
+// give seat to fd (-1: empty) at the head of fd's list; the seat must be unlinked
+static void seat_link(int seat, int fd) {
+    seat_fds[seat >> 1][seat & 1] = fd;
+    seat_prev[seat] = seat_next[seat] = -1;
+    if (fd < 0 || game_reserve_fd(fd) < 0) return;
+    seat_next[seat] = fd_seats[fd];
+    if (fd_seats[fd] >= 0) seat_prev[fd_seats[fd]] = seat;
+    fd_seats[fd] = seat;
 }
 
-Game *find_game_by_id(int id) {
-    for (int i = 0; i < game_count; i++) {
-        if (games[i].id == id)
-            return &games[i];
+static void seat_unlink(int seat) {
+    int fd = seat_fd(seat), p = seat_prev[seat], n = seat_next[seat];
+    if (fd < 0 || fd >= fd_seats_cap) return;
+    if (p >= 0) seat_next[p] = n;
+    else if (fd_seats[fd] == seat) fd_seats[fd] = n;
+    if (n >= 0) seat_prev[n] = p;
+}
+
+// seat `to` takes over `from` and its place in its fd's list
+static void seat_move(int from, int to) {
+    int fd = seat_fd(from), p = seat_prev[from], n = seat_next[from];
+    seat_fds[to >> 1][to & 1] = fd;
+    seat_prev[to] = p;
+    seat_next[to] = n;
+    if (fd < 0 || fd >= fd_seats_cap) return;
+    if (p >= 0) seat_next[p] = to;
+    else if (fd_seats[fd] == from) fd_seats[fd] = to;
+    if (n >= 0) seat_prev[n] = to;
+}
+
+// index of game gid if fd sits in it, else -1
+static int index_of_seated(int fd, int gid) {
+    for (int s = first_seat(fd); s >= 0; s = seat_next[s]) {
+        if (game_ids[s >> 1] == gid) return s >> 1;
     }
-    return NULL;
+    return -1;
+}
+
+Game *find_game_by_id(int id) {
+    int i = index_of_id(id);
+    return i < 0 ? NULL : &games[i];
 }
 
 int host_has_game(int fd) {
-    for (int i = 0; i < game_count; i++) {
-        if (games[i].host_fd == fd) return 1;
+    for (int s = first_seat(fd); s >= 0; s = seat_next[s]) {
+        if ((s & 1) == 0) return 1;
     }
     return 0;
 }
 
-// BFS group + liberties
-int collect_group(Game *g, int sx, int sy, unsigned char color,
-                  int *stones, int max_stones, int *out_liberties) {
-    int n = g->size * g->size;
-    unsigned char seen[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-    for (int i = 0; i < n; i++) seen[i] = 0;
-
-    int qx[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-    int qy[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
-    int qh = 0, qt = 0;
-
-    int start = game_idx(g, sx, sy);
-    if (g->board[start] != color) { *out_liberties = 0; return 0; }
-
-    qx[qt] = sx; qy[qt] = sy; qt++;
-    seen[start] = 1;
-
-    int count = 0;
-    int liberties = 0;
-
-    while (qh < qt) {
-        int x = qx[qh], y = qy[qh]; qh++;
-        int idx = game_idx(g, x, y);
-
-        if (count < max_stones) stones[count] = idx;
-        count++;
+int games_of_fd(int fd, int *running) {
+    int n = 0;
+    *running = 0;
+    for (int s = first_seat(fd); s >= 0; s = seat_next[s]) {
+        n++;
+        if (games[s >> 1].status == GAME_RUNNING) (*running)++;
+    }
+    return n;
+}
 
-        const int dx[4] = {1,-1,0,0};
-        const int dy[4] = {0,0,1,-1};
+void game_seat_guest(Game *g, int fd, const char *nick) {
+    int seat = (int)(g - games) * 2 + 1;
+    seat_unlink(seat);
+    seat_link(seat, fd);
+    snprintf(g->guest_nick, sizeof(g->guest_nick), "%s", nick);
+}
 
-        for (int k = 0; k < 4; k++) {
-            int nx = x + dx[k], ny = y + dy[k];
-            if (!in_bounds(g, nx, ny)) continue;
-            int nidx = game_idx(g, nx, ny);
+// archive a running game that fd walked out of; the opponent wins
+static void archive_finished(const Game *g, int fd, const char *reason) {
+    if (g->status != GAME_RUNNING) return;
+    int winner = fd_color_in_game(g, fd) == 0 ? 1 : 0;
+    archive_game(g, winner, strcmp(reason, "DISCONNECT") == 0 ? ARCHIVE_FORFEIT : ARCHIVE_RESIGN,
+                 (uint64_t)(wall_ms() / 1000), NULL);
+}
 
-            if (g->board[nidx] == 0) {
-                if (seen[nidx] != 3) { seen[nidx] = 3; liberties++; }
-            } else if (g->board[nidx] == color) {
-                if (!seen[nidx]) {
-                    seen[nidx] = 1;
-                    qx[qt] = nx; qy[qt] = ny; qt++;
-                }
-            }
-        }
+// free game i's boards and swap the last game into its slot
+static void drop_game(int i) {
+    journal_remove(games[i].id);
+    if (games[i].vs_bot) bot_games--;
+    board_free(games[i].size, games[i].board);
+    free(games[i].moves);
+    seat_unlink(2 * i);
+    seat_unlink(2 * i + 1);
+    int last = game_count - 1;
+    if (i != last) {
+        games[i] = games[last];
+        game_ids[i] = game_ids[last];
+        seat_move(2 * last, 2 * i);
+        seat_move(2 * last + 1, 2 * i + 1);
     }
-
-    *out_liberties = liberties;
-    return count;
+    game_count--;
 }
 
-int remove_group(Game *g, const int *stones, int count) {
-    int removed = 0;
-    int n = g->size * g->size;
-    for (int i = 0; i < count; i++) {
-        int idx = stones[i];
-        if (idx >= 0 && idx < n && g->board[idx] != 0) {
-            g->board[idx] = 0;
-            removed++;
-        }
-    }
-    return removed;
+int bot_game_count(void) {
+    return bot_games;
 }
 
 void remove_games_of_client(Client clients[], int fd, const char *reason) {
-    for (int i = 0; i < game_count; ) {
-        if (games[i].host_fd == fd || games[i].guest_fd == fd) {
-            int removed_id = games[i].id;
+    for (int s; (s = first_seat(fd)) >= 0;) {
+        int i = s >> 1;
+        int removed_id = games[i].id;
 
-            if (games[i].status == GAME_RUNNING) {
-                int opp = opponent_fd(&games[i], fd);
-                if (opp != -1) {
-                    int opp_color = fd_color_in_game(&games[i], opp);
-                    send_game_over(opp, removed_id, color_name(opp_color), reason);
-                }
+        if (games[i].status == GAME_RUNNING) {
+            int opp = opponent_fd(&games[i], fd);
+            if (opp != -1) {
+                int opp_color = fd_color_in_game(&games[i], opp);
+                send_game_over(opp, removed_id, color_name(opp_color), reason);
             }
+        }
 
-            games[i] = games[game_count - 1];
-            game_count--;
+        archive_finished(&games[i], fd, reason);
+        drop_game(i);
 
-            char ev[64];
-            snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
-            broadcast_subscribed(clients, ev);
-            continue;
-        }
-        i++;
+        char ev[64];
+        snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
+        broadcast_subscribed(clients, ev);
     }
 }
 
@@ -165,7 +199,7 @@ void list_games(Client clients[], int to_fd) {
         const char *status =
             (games[i].status == GAME_OPEN) ? "OPEN" : "RUNNING";
 
-        int players = (games[i].guest_fd == -1) ? 1 : 2;
+        int players = (seat_fds[i][1] == -1 && !games[i].vs_bot) ? 1 : 2;
 
         snprintf(buf, sizeof(buf),
                  "GAME %d %d %d %s %s\n",
@@ -184,52 +218,50 @@ void list_games(Client clients[], int to_fd) {
 int cancel_open_games_of_host(Client clients[], int host_fd) {
     int removed_any = 0;
 
-    for (int i = 0; i < game_count; ) {
-        if (games[i].host_fd == host_fd && games[i].status == GAME_OPEN) {
+    for (int s = first_seat(host_fd); s >= 0; ) {
+        int i = s >> 1;
+        if ((s & 1) == 0 && games[i].status == GAME_OPEN) {
             int removed_id = games[i].id;
 
-            games[i] = games[game_count - 1];
-            game_count--;
+            drop_game(i);   // may move another of our seats: start over
 
             char ev[64];
             snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
             broadcast_subscribed(clients, ev);
 
             removed_any = 1;
+            s = first_seat(host_fd);
             continue;
         }
-        i++;
+        s = seat_next[s];
     }
 
     return removed_any;
 }
 
 void remove_single_game_of_client(Client clients[], int fd, int gid, const char *reason) {
-    for (int i = 0; i < game_count; i++) {
-        if (games[i].id != gid) continue;
-        if (games[i].host_fd != fd && games[i].guest_fd != fd) return;
-
-        if (games[i].status == GAME_RUNNING) {
-            int opp = opponent_fd(&games[i], fd);
-            if (opp != -1) {
-                int opp_color = fd_color_in_game(&games[i], opp);
-                send_game_over(opp, games[i].id, color_name(opp_color), reason);
-            }
+    int i = index_of_seated(fd, gid);
+    if (i < 0) return;
+
+    if (games[i].status == GAME_RUNNING) {
+        int opp = opponent_fd(&games[i], fd);
+        if (opp != -1) {
+            int opp_color = fd_color_in_game(&games[i], opp);
+            send_game_over(opp, games[i].id, color_name(opp_color), reason);
         }
+    }
 
-        int removed_id = games[i].id;
-        games[i] = games[game_count - 1];
-        game_count--;
+    int removed_id = games[i].id;
+    archive_finished(&games[i], fd, reason);
+    drop_game(i);
 
-        char ev[64];
-        snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
-        broadcast_subscribed(clients, ev);
-        return;
-    }
+    char ev[64];
+    snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
+    broadcast_subscribed(clients, ev);
 }
 
 
-int create_game(Client clients[], int host_fd, int size, char pref, const char *custom_name) {
+int create_game(Client clients[], int host_fd, int size, char pref, const char *custom_name, int vs_bot) {
     if (game_count >= MAX_GAMES) return -1;
     if (host_has_game(host_fd)) return -2;
 
@@ -238,13 +270,33 @@ int create_game(Client clients[], int host_fd, int size, char pref, const char *
     else if (pref == 'W') host_color = 1;
     else host_color = rand() % 2;
 
+    unsigned char *boards = board_alloc(size);
+    if (!boards) return -1;
+
     Game *g = &games[game_count++];
     g->id = next_game_id++;
     g->size = size;
-    g->host_fd = host_fd;
-    g->guest_fd = -1;
+    game_use_storage(g, boards);
+    g->moves = NULL;
+    g->moves_cap = 0;
+    game_reserve_moves(g, 64);
     g->status = GAME_OPEN;
     g->host_color = host_color;
+    g->vs_bot = vs_bot;
+    if (vs_bot) bot_games++;
+    game_ids[game_count - 1] = g->id;
+    seat_link(2 * (game_count - 1), host_fd);
+    seat_link(2 * (game_count - 1) + 1, -1);
+
+    const char *host_nick = "player";
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd == host_fd) {
+            host_nick = clients[i].nick;
+            break;
+        }
+    }
+    snprintf(g->host_nick, sizeof(g->host_nick), "%s", host_nick);
+    snprintf(g->guest_nick, sizeof(g->guest_nick), "%s", vs_bot ? BOT_NICK : "");
     
     // Ustaw nazwę gry
     if (custom_name && custom_name[0]) {
@@ -253,15 +305,9 @@ int create_game(Client clients[], int host_fd, int size, char pref, const char *
         g->game_name[sizeof(g->game_name) - 1] = '\0';
     } else {
         // Użyj domyślnej nazwy "<nick> game"
-        const char *host_nick = "player";
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].fd == host_fd) {
-                host_nick = clients[i].nick;
-                break;
-            }
-        }
         snprintf(g->game_name, sizeof(g->game_name), "%s game", host_nick);
     }
+    journal_create(g);
 
     char buf[64];
     snprintf(buf, sizeof(buf), "HOSTED %d %s\n",
@@ -277,32 +323,101 @@ int create_game(Client clients[], int host_fd, int size, char pref, const char *
 }
 
 int leave_game(Client clients[], int fd, int gid, const char *reason) {
-    for (int i = 0; i < game_count; i++) {
-        if (games[i].id != gid) continue;
+    int i = index_of_seated(fd, gid);
+    if (i < 0) return index_of_id(gid) < 0 ? 0 : -2;   // no such game / not a player in it
 
-        // must be player in this game
-        if (games[i].host_fd != fd && games[i].guest_fd != fd) return -2;
+    int removed_id = games[i].id;
 
-        int removed_id = games[i].id;
-
-        if (games[i].status == GAME_RUNNING) {
-            int opp = opponent_fd(&games[i], fd);
-            if (opp != -1) {
-                int opp_color = fd_color_in_game(&games[i], opp);
-                send_game_over(opp, removed_id, color_name(opp_color), reason);
-            }
+    if (games[i].status == GAME_RUNNING) {
+        int opp = opponent_fd(&games[i], fd);
+        if (opp != -1) {
+            int opp_color = fd_color_in_game(&games[i], opp);
+            send_game_over(opp, removed_id, color_name(opp_color), reason);
         }
+    }
 
-        // remove game
-        games[i] = games[game_count - 1];
-        game_count--;
+    // remove game
+    archive_finished(&games[i], fd, reason);
+    drop_game(i);
 
-        char ev[64];
-        snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
-        broadcast_subscribed(clients, ev);
+    char ev[64];
+    snprintf(ev, sizeof(ev), "EVENT GAME_REMOVED %d\n", removed_id);
+    broadcast_subscribed(clients, ev);
+
+    return 1;
+}
+
+Game *game_restore(int id, int size, int host_color, int vs_bot, const char *host_nick, const char *name) {
+    if (game_count >= MAX_GAMES || find_game_by_id(id)) return NULL;
+    unsigned char *boards = board_alloc(size);
+    if (!boards) return NULL;
 
-        return 1;
+    Game *g = &games[game_count++];
+    memset(g, 0, sizeof(*g));
+    g->id = id;
+    g->size = size;
+    game_use_storage(g, boards);
+    game_reserve_moves(g, 64);
+    g->status = GAME_OPEN;
+    g->host_color = host_color;
+    g->vs_bot = vs_bot;
+    if (vs_bot) bot_games++;
+    game_ids[game_count - 1] = id;
+    seat_link(2 * (game_count - 1), -1);
+    seat_link(2 * (game_count - 1) + 1, -1);
+    snprintf(g->host_nick, sizeof(g->host_nick), "%s", host_nick);
+    snprintf(g->guest_nick, sizeof(g->guest_nick), "%s", vs_bot ? BOT_NICK : "");
+    snprintf(g->game_name, sizeof(g->game_name), "%s", name);
+    if (id >= next_game_id) next_game_id = id + 1;
+    return g;
+}
+
+void game_forget(int id) {
+    int i = index_of_id(id);
+    if (i >= 0) drop_game(i);
+}
+
+int attach_restored_games(int fd, const char *nick, int *gids, int max) {
+    int n = 0;
+    for (int i = 0; i < game_count && n < max; i++) {
+        if (seat_fds[i][0] != -1 && seat_fds[i][1] != -1) continue;
+        Game *g = &games[i];
+        int seated = 0;
+        if (seat_fds[i][0] == -1 && strcmp(g->host_nick, nick) == 0) {
+            seat_link(2 * i, fd);
+            seated = 1;
+        } else if (g->status == GAME_RUNNING && !g->vs_bot && seat_fds[i][1] == -1 &&
+                   strcmp(g->guest_nick, nick) == 0) {
+            seat_link(2 * i + 1, fd);
+            seated = 1;
+        }
+        if (seated) gids[n++] = g->id;
     }
-    return 0; // no such game
+    return n;
+}
+
+int game_total(void) {
+    return game_count;
 }
 
+Game *game_at(int i) {
+    return &games[i];
+}
+
+size_t game_table_bytes(void) {
+    return sizeof(games);
+}
+
+size_t game_moves_bytes(void) {
+    size_t n = 0;
+    for (int i = 0; i < game_count; i++) n += (size_t)games[i].moves_cap * sizeof(*games[i].moves);
+    return n;
+}
+
+int game_next_id(void) {
+    return next_game_id;
+}
+
+void game_set_next_id(int id) {
+    if (id > next_game_id) next_game_id = id;
+}
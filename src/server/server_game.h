@@ -2,13 +2,19 @@
 #include <netinet/in.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
-#define MAX_CLIENTS 50
+#ifndef MAX_CLIENTS
+#define MAX_CLIENTS 50      // tools/sim builds with thousands
+#endif
 #define BUF_SIZE 4096
 #define NICK_SIZE 32
-#define MAX_GAMES 25
-#define BOARD_MAX_SIZE 19
+#define MAX_GAMES 10000
+#define BOARD_MIN_SIZE 7
+#define BOARD_MAX_SIZE 32
+#define BOARD_CELLS_MAX (BOARD_MAX_SIZE * BOARD_MAX_SIZE)
 #define GAME_NAME_SIZE 64
+#define BOT_NICK "bot"
 
 typedef enum
 {
@@ -21,36 +27,65 @@ typedef struct
 {
     int id;
     int size;
-    int host_fd;
-    int guest_fd;
     int host_color;
     GameStatus status;
-    unsigned char board[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    unsigned char *board;            // size * size cells
     int to_move;
-    unsigned char prev_board[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    unsigned char *prev_board;       // follows board in the same block
     int cap_black;
     int cap_white;
     int consecutive_passes;
+    int ply;                         // moves and passes played
+    uint16_t *moves;                 // ply entries, 0 pass / board index + 1; NULL = not kept
+    int moves_cap;
+    int vs_bot;                      // guest seat is the built-in engine
     char game_name[GAME_NAME_SIZE];  
+    char host_nick[NICK_SIZE];       // seats are matched by nick after a restart
+    char guest_nick[NICK_SIZE];
 } Game;
 
 typedef struct
 {
     int fd;                  // -1 if unused
     char nick[NICK_SIZE];    // nickname
-    char buf[BUF_SIZE];      // receive buffer
-    size_t len;              // length of data in buffer
+    char *buf;               // partial line received so far (server_rxpool), NULL if none
+    size_t len;              // bytes in buf
+    size_t cap;              // size of buf
     struct sockaddr_in addr; // client address
     bool subscribed;
+    uint32_t conn_id;        // accept order, never reused (fds are)
+    const char *closing;     // reason once queued to close at the end of the pass, else NULL
 } Client;
 
 Game *find_game_by_id(int id);
+
+// games fd sits in are kept on a list per fd: room for fd in that index,
+// -1 if out of memory (take it when accepting, so seating cannot fail)
+int game_reserve_fd(int fd);
+
+// these walk fd's own games only
 void remove_games_of_client(Client clients[], int fd, const char *reason);
 int host_has_game(int fd);
+// games fd sits in; how many of them are running in *running
+int games_of_fd(int fd, int *running);
+int bot_game_count(void);
 
 // core Helpers
 void game_clear_board(Game *g);
+
+// point g's boards at caller storage of 2 * size * size bytes (set size first)
+void game_use_storage(Game *g, unsigned char *storage);
+
+// dst becomes a copy of src whose boards live in storage (without the move list)
+void game_copy(Game *dst, const Game *src, unsigned char *storage);
+
+// grow g's move list to hold n entries; starts keeping one if it had none
+int game_reserve_moves(Game *g, int n);
 int game_idx(Game *g, int x, int y);
+// fd in g's host or guest seat, -1 if empty; seats live in the game
+// table's hot columns, so g must be a table entry, not a copy
+int game_host_fd(const Game *g);
+int game_guest_fd(const Game *g);
 int fd_color_in_game(const Game *g, int fd);
 int opponent_fd(const Game *g, int fd);
 const char *color_name(int c);
@@ -62,8 +97,42 @@ int in_bounds(Game *g, int x, int y);
 int collect_group(Game *g, int sx, int sy, unsigned char color, int *stones, int max_stones, int *out_liberties);
 int remove_group(Game *g, const int *stones, int count);
 
+// rules (server_rules.c)
+typedef enum
+{
+    MOVE_OK = 0,
+    MOVE_OUT_OF_BOUNDS = -1,
+    MOVE_OCCUPIED = -2,
+    MOVE_SUICIDE = -3,
+    MOVE_KO = -4
+} MoveResult;
+
+// color: 0 black / 1 white; on error the board is left untouched
+int game_play_move(Game *g, int color, int x, int y);
+void game_pass(Game *g);
+
 void list_games(Client clients[], int to_fd);
 int cancel_open_games_of_host(Client clients[], int host_fd);
-int create_game(Client clients[], int host_fd, int size, char pref, const char *custom_name);
+int create_game(Client clients[], int host_fd, int size, char pref, const char *custom_name, int vs_bot);
 void remove_single_game_of_client(Client clients[], int fd, int gid, const char *reason);
 int leave_game(Client clients[], int fd, int gid, const char *reason);
+
+// journal replay: add a game with empty seats (fds -1), or drop one silently
+Game *game_restore(int id, int size, int host_color, int vs_bot, const char *host_nick, const char *name);
+void game_forget(int id);
+
+// take g's guest seat; seats are only changed through server_game.c
+void game_seat_guest(Game *g, int fd, const char *nick);
+
+// seat fd in every restored game waiting for nick; fills gids, returns count
+int attach_restored_games(int fd, const char *nick, int *gids, int max);
+
+// registry walk for snapshots: games are packed at indices 0 .. game_total()-1
+int game_total(void);
+Game *game_at(int i);
+
+// bytes held by the game table and by the move lists of the games in it
+size_t game_table_bytes(void);
+size_t game_moves_bytes(void);
+int game_next_id(void);
+void game_set_next_id(int id);
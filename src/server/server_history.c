@@ -0,0 +1,405 @@
+// server_history.c
+// Index entries are written with pwrite at computed offsets by the archive
+// writer thread (or by history_open while catching up). The loop reads
+// them with pread; the player head table is the only shared state and is
+// guarded by a mutex held for a lookup or an update.
+
+#include "server_history.h"
+#include "server_proto.h"
+#include "server_io.h"
+#include "server_metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define TIME_ENTRY 32
+#define PLAYER_ENTRY 16
+
+typedef struct
+{
+    uint64_t hash;      // 0 = empty slot
+    uint32_t head;      // newest player entry + 1
+    uint32_t count;
+} Head;
+
+static char hdir[4096];
+static int time_fd = -1, player_fd = -1, nick_fd = -1, skip_fd = -1, id_fd = -1;
+static int active;
+static uint32_t time_count, player_count;   // writer side
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static Head *heads;
+static size_t head_cap, head_used;
+
+static void put_u16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+// FNV-1a, never 0
+static uint64_t nick_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 0x100000001b3ull;
+    return h ? h : 1;
+}
+
+// ---- head table (lock held) ----
+
+static Head *head_find(uint64_t h) {
+    if (!head_cap) return NULL;
+    for (size_t i = (size_t)h & (head_cap - 1);; i = (i + 1) & (head_cap - 1)) {
+        if (heads[i].hash == h) return &heads[i];
+        if (heads[i].hash == 0) return NULL;
+    }
+}
+
+static Head *head_insert(uint64_t h) {
+    if ((head_used + 1) * 2 > head_cap) {
+        size_t cap = head_cap ? head_cap * 2 : 1024;
+        Head *t = calloc(cap, sizeof(Head));
+        if (!t) return NULL;
+        for (size_t i = 0; i < head_cap; i++) {
+            if (!heads[i].hash) continue;
+            size_t j = (size_t)heads[i].hash & (cap - 1);
+            while (t[j].hash) j = (j + 1) & (cap - 1);
+            t[j] = heads[i];
+        }
+        free(heads);
+        heads = t;
+        head_cap = cap;
+    }
+    size_t i = (size_t)h & (head_cap - 1);
+    while (heads[i].hash && heads[i].hash != h) i = (i + 1) & (head_cap - 1);
+    if (!heads[i].hash) {
+        heads[i].hash = h;
+        head_used++;
+    }
+    return &heads[i];
+}
+
+// ---- skip pointers ----
+// A player's games are numbered 0 (oldest) up. Game n has a skip pointer
+// to game skip_height(n) of the same player; the heights are chosen so a
+// walk from the newest game to any older one takes O(log n) reads.
+
+static uint32_t clear_lowest_bit(uint32_t n) {
+    return n & (n - 1);
+}
+
+static uint32_t skip_height(uint32_t n) {
+    if (n < 2) return 0;
+    return (n & 1) ? clear_lowest_bit(clear_lowest_bit(n - 1)) + 1 : clear_lowest_bit(n);
+}
+
+// player entry + 1 of game want, walking down from entry + 1 e, which is
+// game n of the same player; 0 on a read error
+static uint32_t player_game(uint32_t e, uint32_t n, uint32_t want) {
+    while (e && n > want) {
+        uint32_t sk = skip_height(n), sk_prev = skip_height(n - 1);
+        unsigned char b[4];
+        // take the skip unless it overshoots by more than stepping once and
+        // skipping from there would
+        if (sk == want || (sk > want && !(sk_prev + 2 < sk && sk_prev >= want))) {
+            if (pread(skip_fd, b, 4, (off_t)(e - 1) * 4) != 4) return 0;
+            n = sk;
+        } else {
+            if (pread(player_fd, b, 4, (off_t)(e - 1) * PLAYER_ENTRY + 12) != 4) return 0;
+            n--;
+        }
+        e = get_u32(b);
+    }
+    return e;
+}
+
+// ---- writing ----
+
+static void add_player(uint64_t h, uint32_t tentry) {
+    pthread_mutex_lock(&lock);
+    Head *hd = head_insert(h);
+    uint32_t prev = hd ? hd->head : 0;
+    uint32_t n = hd ? hd->count : 0;   // this is the player's game n
+    pthread_mutex_unlock(&lock);
+
+    unsigned char se[4];
+    put_u32(se, n > 0 ? player_game(prev, n - 1, skip_height(n)) : 0);
+    if (pwrite(skip_fd, se, sizeof(se), (off_t)player_count * 4) != (ssize_t)sizeof(se))
+        perror("skips.idx");
+
+    unsigned char pe[PLAYER_ENTRY];
+    put_u64(pe, h);
+    put_u32(pe + 8, tentry);
+    put_u32(pe + 12, prev);
+    if (pwrite(player_fd, pe, sizeof(pe), (off_t)player_count * PLAYER_ENTRY) != (ssize_t)sizeof(pe))
+        perror("players.idx");
+
+    pthread_mutex_lock(&lock);
+    hd = head_find(h);
+    if (hd) {
+        hd->head = player_count + 1;
+        hd->count++;
+    }
+    pthread_mutex_unlock(&lock);
+    player_count++;
+}
+
+static void index_game(const ArchiveGame *ag, ArchivePos pos, uint32_t len, void *arg) {
+    (void)arg;
+    unsigned char te[TIME_ENTRY];
+    memset(te, 0, sizeof(te));
+    put_u64(te, (uint64_t)ag->end_time);
+    put_u32(te + 8, (uint32_t)ag->id);
+    put_u32(te + 12, pos.segment);
+    put_u32(te + 16, pos.offset);
+    put_u32(te + 20, len);
+    put_u16(te + 24, (uint16_t)(ag->ply > 0xffff ? 0xffff : ag->ply));
+    te[26] = (unsigned char)ag->size;
+    te[27] = (unsigned char)(ag->vs_bot | ag->winner << 1 | ag->end << 2);
+    if (pwrite(time_fd, te, sizeof(te), (off_t)time_count * TIME_ENTRY) != (ssize_t)sizeof(te))
+        perror("time.idx");
+
+    char nicks[2][NICK_SIZE];
+    memset(nicks, 0, sizeof(nicks));
+    snprintf(nicks[0], NICK_SIZE, "%s", ag->black);
+    snprintf(nicks[1], NICK_SIZE, "%s", ag->white);
+    if (pwrite(nick_fd, nicks, sizeof(nicks), (off_t)time_count * sizeof(nicks)) != (ssize_t)sizeof(nicks))
+        perror("nicks.idx");
+
+    add_player(nick_hash(ag->black), time_count);
+    add_player(nick_hash(ag->white), time_count);
+
+    unsigned char ie[4];
+    put_u32(ie, time_count + 1);
+    if (ag->id > 0 && pwrite(id_fd, ie, sizeof(ie), (off_t)ag->id * 4) != (ssize_t)sizeof(ie))
+        perror("ids.idx");
+    time_count++;
+}
+
+// ---- queries ----
+
+static int read_time_entry(uint32_t e, ArchivePos *pos, uint32_t *len) {
+    unsigned char te[TIME_ENTRY];
+    if (pread(time_fd, te, sizeof(te), (off_t)e * TIME_ENTRY) != (ssize_t)sizeof(te)) return -1;
+    pos->segment = get_u32(te + 12);
+    pos->offset = get_u32(te + 16);
+    if (len) *len = get_u32(te + 20);
+    return 0;
+}
+
+void history_send(int fd, const char *nick, int offset, int limit) {
+    uint64_t h = nick_hash(nick);
+    pthread_mutex_lock(&lock);
+    Head *hd = head_find(h);
+    uint32_t e = hd ? hd->head : 0;
+    uint32_t total = hd ? hd->count : 0;
+    pthread_mutex_unlock(&lock);
+
+    char line[256];
+    snprintf(line, sizeof(line), "HISTORY_BEGIN %s %u\n", nick, total);
+    send_str(fd, line);
+    if (offset < 0 || (uint32_t)offset >= total) {
+        send_str(fd, "HISTORY_END\n");
+        return;
+    }
+
+    // newest first: game total - 1 - offset is the first one listed
+    e = player_game(e, total - 1, total - 1 - (uint32_t)offset);
+    int sent = 0;
+    while (e && sent < limit) {
+        unsigned char pe[PLAYER_ENTRY];
+        if (pread(player_fd, pe, sizeof(pe), (off_t)(e - 1) * PLAYER_ENTRY) != (ssize_t)sizeof(pe)) break;
+        int color = (int)((e - 1) & 1);   // entries 2k black, 2k+1 white
+        uint32_t tentry = get_u32(pe + 8);
+        e = get_u32(pe + 12);
+
+        unsigned char te[TIME_ENTRY];
+        char nicks[2][NICK_SIZE];
+        if (pread(time_fd, te, sizeof(te), (off_t)tentry * TIME_ENTRY) != (ssize_t)sizeof(te) ||
+            pread(nick_fd, nicks, sizeof(nicks), (off_t)tentry * sizeof(nicks)) != (ssize_t)sizeof(nicks))
+            continue;
+        nicks[0][NICK_SIZE - 1] = nicks[1][NICK_SIZE - 1] = '\0';
+        if (strcmp(nicks[color], nick) != 0) continue;   // another nick with the same hash
+
+        int winner = te[27] >> 1 & 1;
+        int end = te[27] >> 2 & 3;
+        snprintf(line, sizeof(line), "HGAME %u %d %s %s %c %u %lld %s\n", get_u32(te + 8), te[26],
+                 color == 0 ? "BLACK" : "WHITE", winner == color ? "WIN" : "LOSS",
+                 end == ARCHIVE_FORFEIT ? 'F' : 'R', get_u16(te + 24), (long long)get_u64(te),
+                 nicks[1 - color]);
+        send_str(fd, line);
+        sent++;
+    }
+    send_str(fd, "HISTORY_END\n");
+}
+
+static int send_raw(int fd, int id, ArchivePos pos, uint32_t len) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/games.%06u", hdir, pos.segment);
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return -1;
+
+    char line[64];
+    snprintf(line, sizeof(line), "RECORD %d RAW %u\n", id, len);
+    off_t off = pos.offset;
+    size_t left = len;
+    if (send_str(fd, line) == 0) {
+        while (left > 0) {
+            ssize_t w = server_io->sendfile(fd, in, &off, left);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            left -= (size_t)w;
+            metrics_bytes_out((size_t)w);
+        }
+    }
+    close(in);
+    return left > 0 ? -2 : 0;
+}
+
+static int send_sgf(int fd, int id, ArchivePos pos) {
+    ArchiveGame ag;
+    if (archive_read(hdir, pos, &ag, NULL) != 1) return -1;
+    char *text = NULL;
+    size_t n = 0;
+    FILE *f = open_memstream(&text, &n);
+    if (!f) {
+        archive_game_free(&ag);
+        return -1;
+    }
+    archive_write_sgf(f, &ag);
+    fclose(f);
+    archive_game_free(&ag);
+
+    char line[64];
+    snprintf(line, sizeof(line), "RECORD %d SGF %zu\n", id, n);
+    int rc = (send_str(fd, line) < 0 || send_str(fd, text) < 0) ? -2 : 0;
+    free(text);
+    return rc;
+}
+
+int history_send_record(int fd, int id, int sgf) {
+    unsigned char ie[4];
+    if (id <= 0 || pread(id_fd, ie, sizeof(ie), (off_t)id * 4) != (ssize_t)sizeof(ie)) return -1;
+    uint32_t e = get_u32(ie);
+    ArchivePos pos;
+    uint32_t len;
+    if (e == 0 || read_time_entry(e - 1, &pos, &len) < 0) return -1;
+    return sgf ? send_sgf(fd, id, pos) : send_raw(fd, id, pos, len);
+}
+
+int history_enabled(void) {
+    return active;
+}
+
+int history_next_id(void) {
+    struct stat st;
+    if (id_fd < 0 || fstat(id_fd, &st) < 0 || st.st_size < 4) return 1;
+    return (int)(st.st_size / 4);
+}
+
+// ---- startup ----
+
+static int open_index(const char *name) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/%s", hdir, name);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) perror(path);
+    return fd;
+}
+
+int history_open(const char *dir) {
+    snprintf(hdir, sizeof(hdir), "%s", dir);
+    time_fd = open_index("time.idx");
+    player_fd = open_index("players.idx");
+    nick_fd = open_index("nicks.idx");
+    skip_fd = open_index("skips.idx");
+    id_fd = open_index("ids.idx");
+    if (time_fd < 0 || player_fd < 0 || nick_fd < 0 || skip_fd < 0 || id_fd < 0) return -1;
+
+    // keep whole games only: a crash can leave a time entry without its
+    // players, nicks or skips (a directory from before nicks.idx or
+    // skips.idx is reindexed)
+    struct stat ts, ps, ns, ss;
+    if (fstat(time_fd, &ts) < 0 || fstat(player_fd, &ps) < 0 || fstat(nick_fd, &ns) < 0 ||
+        fstat(skip_fd, &ss) < 0)
+        return -1;
+    uint32_t games = (uint32_t)(ps.st_size / (2 * PLAYER_ENTRY));
+    if ((uint32_t)(ts.st_size / TIME_ENTRY) < games) games = (uint32_t)(ts.st_size / TIME_ENTRY);
+    if ((uint32_t)(ns.st_size / (2 * NICK_SIZE)) < games) games = (uint32_t)(ns.st_size / (2 * NICK_SIZE));
+    if ((uint32_t)(ss.st_size / (2 * 4)) < games) games = (uint32_t)(ss.st_size / (2 * 4));
+    if (ftruncate(time_fd, (off_t)games * TIME_ENTRY) < 0 ||
+        ftruncate(player_fd, (off_t)games * 2 * PLAYER_ENTRY) < 0 ||
+        ftruncate(nick_fd, (off_t)games * 2 * NICK_SIZE) < 0 ||
+        ftruncate(skip_fd, (off_t)games * 2 * 4) < 0) {
+        perror("history truncate");
+        return -1;
+    }
+
+    // player heads, oldest to newest
+    unsigned char buf[PLAYER_ENTRY * 4096];
+    for (uint32_t i = 0; i < games * 2;) {
+        uint32_t n = games * 2 - i;
+        if (n > 4096) n = 4096;
+        if (pread(player_fd, buf, (size_t)n * PLAYER_ENTRY, (off_t)i * PLAYER_ENTRY) != (ssize_t)n * PLAYER_ENTRY) {
+            perror("players.idx");
+            return -1;
+        }
+        for (uint32_t k = 0; k < n; k++) {
+            Head *hd = head_insert(get_u64(buf + k * PLAYER_ENTRY));
+            if (!hd) return -1;
+            hd->head = i + k + 1;
+            hd->count++;
+        }
+        i += n;
+    }
+    time_count = games;
+    player_count = games * 2;
+
+    // records written after the last indexed one
+    ArchivePos from = {0, 0};
+    if (games > 0) {
+        uint32_t len;
+        unsigned char te[TIME_ENTRY], ie[4];
+        if (read_time_entry(games - 1, &from, &len) < 0 ||
+            pread(time_fd, te, sizeof(te), (off_t)(games - 1) * TIME_ENTRY) != (ssize_t)sizeof(te))
+            return -1;
+        from.offset += len;
+        // its ids.idx slot is written last, so may be missing
+        put_u32(ie, games);
+        if (pwrite(id_fd, ie, sizeof(ie), (off_t)get_u32(te + 8) * 4) != (ssize_t)sizeof(ie)) perror("ids.idx");
+    }
+    long added = archive_scan(dir, from, index_game, NULL);
+    if (added < 0) {
+        perror(dir);
+        return -1;
+    }
+    if (added > 0) fprintf(stderr, "history: indexed %ld archived games\n", added);
+
+    if (archive_add_indexer(index_game, NULL) < 0) return -1;
+    active = 1;
+    return 0;
+}
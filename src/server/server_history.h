@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include "server_archive.h"
+
+// Secondary indexes over the game archive, kept next to it in its directory:
+//   time.idx     one 32-byte entry per archived game, in archive (end time)
+//                order: end time, id, segment, offset, length, moves, size, flags
+//   players.idx  entries 2k and 2k+1 are the black and white player of
+//                time entry k: nick hash, time entry, previous entry + 1 of
+//                the same player (16 bytes)
+//   nicks.idx    black and white nick of time entry k, NUL padded to
+//                NICK_SIZE each, so HISTORY never reads the archive itself
+//   skips.idx    per player entry, u32 skip pointer: player entry + 1 of an
+//                older game of the same player, so HISTORY reaches any
+//                offset in O(log n) reads instead of walking the chain
+//   ids.idx      time entry + 1 as u32 at byte 4 * game id (sparse file)
+// The archive writer thread adds entries after each batch is on disk, so
+// an index never points past written data; on open, records the indexes
+// missed are indexed from the archive. Memory holds only each player's
+// newest entry and game count.
+
+#define HISTORY_DEFAULT_LIMIT 20
+#define HISTORY_MAX_LIMIT 100
+
+// open or create the indexes in dir, catch up and hook into the archive
+// writer; call after archive_open, before any game is archived
+int history_open(const char *dir);
+
+int history_enabled(void);
+
+// one past the highest archived game id, so new ids never collide with it
+int history_next_id(void);
+
+// HISTORY_BEGIN <nick> <total>, then newest first from offset, up to limit:
+// HGAME <id> <size> <BLACK|WHITE> <WIN|LOSS> <R|F> <moves> <end time> <opponent>
+// and HISTORY_END
+void history_send(int fd, const char *nick, int offset, int limit);
+
+// RECORD <id> RAW <len> and the archive record, sent with server_io's
+// sendfile, or RECORD <id> SGF <len> and the game as SGF; 0 sent, -1 no
+// such game, -2 the header went out but not all of the record (the
+// client's stream is out of step and it has to be closed)
+int history_send_record(int fd, int id, int sgf);
@@ -0,0 +1,80 @@
+// server_io.c
+
+#include "server_io.h"
+#include "server_admin.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+static fd_set os_rfds;   // readable at the last os_wait
+
+static int64_t os_now_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static int64_t os_wall_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (int64_t)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static int os_wait(const Client clients[], int listen_fd, int bot_fd, int timeout_ms) {
+    FD_ZERO(&os_rfds);
+    FD_SET(listen_fd, &os_rfds);
+    int maxfd = listen_fd;
+    if (bot_fd >= 0) {
+        FD_SET(bot_fd, &os_rfds);
+        if (bot_fd > maxfd) maxfd = bot_fd;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd != -1) {
+            FD_SET(clients[i].fd, &os_rfds);
+            if (clients[i].fd > maxfd) maxfd = clients[i].fd;
+        }
+    }
+    maxfd = admin_fill_fds(&os_rfds, maxfd);
+
+    struct timeval tick = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    int rc = select(maxfd + 1, &os_rfds, NULL, NULL, timeout_ms >= 0 ? &tick : NULL);
+    if (rc < 0) FD_ZERO(&os_rfds);
+    return rc;
+}
+
+static int os_ready(int fd) {
+    return fd >= 0 && fd < FD_SETSIZE && FD_ISSET(fd, &os_rfds);
+}
+
+static int os_accept(int listen_fd, struct sockaddr_in *peer) {
+    socklen_t peerlen = sizeof(*peer);
+    int fd = accept(listen_fd, (struct sockaddr *)peer, &peerlen);
+    // a reply is several small sends (MOVED, BOARD, CAPTURES); with Nagle the
+    // later ones wait for the peer's delayed ACK, up to 40 ms on Linux
+    int one = 1;
+    if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static ssize_t os_recv(int fd, void *buf, size_t n) {
+    return recv(fd, buf, n, 0);
+}
+
+static ssize_t os_send(int fd, const void *buf, size_t n) {
+    return send(fd, buf, n, 0);
+}
+
+static ssize_t os_sendfile(int fd, int in_fd, off_t *off, size_t n) {
+    return sendfile(fd, in_fd, off, n);
+}
+
+static void os_close(int fd) {
+    close(fd);
+}
+
+const ServerIo io_os = {os_now_ms, os_wall_ms, os_wait, os_ready, os_accept, os_recv, os_send, os_sendfile, os_close};
+const ServerIo *server_io = &io_os;
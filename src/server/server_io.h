@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include "server_game.h"
+
+// Sockets and the clock as the loop sees them. server.c and server_proto.c
+// reach clients only through server_io, so a simulation (tools/sim) can run
+// the whole server in one process over in-memory connections and a virtual
+// clock. io_os is the real thing: select(), BSD sockets, CLOCK_MONOTONIC
+// and CLOCK_REALTIME.
+
+typedef struct
+{
+    int64_t (*now_ms)(void);    // monotonic
+    int64_t (*wall_ms)(void);   // Unix time, for what is stored (archive end times)
+    // block until listen_fd, bot_fd or a client has input, or timeout_ms
+    // passes (-1: no timeout); -1 on error with errno set
+    int (*wait)(const Client clients[], int listen_fd, int bot_fd, int timeout_ms);
+    int (*ready)(int fd);       // fd had input at the last wait
+    int (*accept)(int listen_fd, struct sockaddr_in *peer);
+    ssize_t (*recv)(int fd, void *buf, size_t n);
+    ssize_t (*send)(int fd, const void *buf, size_t n);
+    // up to n bytes of in_fd from *off, which is advanced (sendfile(2))
+    ssize_t (*sendfile)(int fd, int in_fd, off_t *off, size_t n);
+    void (*close)(int fd);
+} ServerIo;
+
+extern const ServerIo io_os;
+extern const ServerIo *server_io;   // io_os unless server_init was given another
+
+// server.c: the loop for a simulation to drive; build server.c with
+// -DSERVER_NO_MAIN to leave its main() out. bot_fd may be -1 (no bot pool).
+void server_init(const ServerIo *io, int listen_fd, int bot_fd);
+
+// one pass: wait for input or the next timer, then serve whatever is ready
+void server_step(void);
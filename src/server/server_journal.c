@@ -0,0 +1,501 @@
+// server_journal.c
+// Two byte buffers: the loop appends to `fill` under a mutex held only for
+// a memcpy, the I/O thread swaps it with `flush` and writes that one out
+// without the lock. An epoch switch marks a cut in `fill`; the I/O thread
+// syncs and closes the old file at the cut and writes the rest to the new
+// one. Replay stops at the first record that is short or fails its CRC
+// (a write torn by a crash); startup always moves to a new file anyway.
+
+#include "server_journal.h"
+#include "server_snapshot.h"
+#include "server_crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define REC_HEADER 8
+#define REC_MAX 256
+#define EPOCH_REC (REC_HEADER + 13)   // bytes of the epoch record opening a file
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+static int jfd = -1;            // current file; the I/O thread's once it runs
+static int active;
+static Buf fill, flush;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;    // data to write
+static pthread_cond_t synced = PTHREAD_COND_INITIALIZER;  // a batch hit the disk
+static uint64_t appended_seq;   // bytes appended so far
+static uint64_t durable_seq;    // bytes known to be on disk
+static int cut_fd = -1;         // epoch switch: move to this file ...
+static size_t cut_at;           // ... after this many bytes of fill
+static JournalStats stats;
+
+// loop thread only
+static char jpath[4096], next_path[4096], snap_path[4096];
+static uint64_t epoch;
+static uint64_t epoch_seq;      // appended_seq at the end of the epoch record
+static uint64_t snap_seq;       // appended_seq covered by the last snapshot
+static uint64_t child_seq;      // ... and by the one being written
+static int snap_secs;
+static pid_t snap_pid = -1;
+static int need_rename;         // next_path holds the live epoch
+static int64_t last_snap_ms = -1; // loop clock; -1 until the first tick
+
+static uint32_t crc32(const unsigned char *p, size_t n) {
+    return crc32_update(0, p, n);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+// ---- writer ----
+
+static void write_out(int fd, const unsigned char *p, size_t n) {
+    size_t off = 0;
+    while (off < n) {
+        ssize_t w = write(fd, p + off, n - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("journal write");
+            return;
+        }
+        off += (size_t)w;
+    }
+}
+
+static void *io_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (fill.len == 0) pthread_cond_wait(&wake, &lock);
+
+        Buf t = flush;
+        flush = fill;
+        fill = t;
+        fill.len = 0;
+        uint64_t seq = appended_seq;
+        int nfd = cut_fd;
+        size_t cut = cut_at;
+        cut_fd = -1;
+        pthread_mutex_unlock(&lock);
+
+        if (nfd >= 0) {
+            write_out(jfd, flush.data, cut);
+            if (fdatasync(jfd) < 0) perror("journal fdatasync");
+            close(jfd);
+            jfd = nfd;
+            write_out(jfd, flush.data + cut, flush.len - cut);
+        } else {
+            write_out(jfd, flush.data, flush.len);
+        }
+        if (fdatasync(jfd) < 0) perror("journal fdatasync");
+
+        pthread_mutex_lock(&lock);
+        stats.batches++;
+        stats.bytes += flush.len;
+        durable_seq = seq;
+        pthread_cond_broadcast(&synced);
+    }
+    return NULL;
+}
+
+// header + payload into out; returns the record length
+static size_t frame(unsigned char *out, const unsigned char *payload, size_t n) {
+    put_u32(out, (uint32_t)n);
+    put_u32(out + 4, crc32(payload, n));
+    memcpy(out + REC_HEADER, payload, n);
+    return REC_HEADER + n;
+}
+
+// lock held
+static int push(const unsigned char *rec, size_t n) {
+    if (fill.len + n > fill.cap) {
+        size_t cap = fill.cap ? fill.cap * 2 : 4096;
+        while (cap < fill.len + n) cap *= 2;
+        unsigned char *d = realloc(fill.data, cap);
+        if (!d) {
+            perror("journal realloc");
+            return -1;
+        }
+        fill.data = d;
+        fill.cap = cap;
+    }
+    memcpy(fill.data + fill.len, rec, n);
+    fill.len += n;
+    appended_seq += n;
+    stats.records++;
+    pthread_cond_signal(&wake);
+    return 0;
+}
+
+static void append(const unsigned char *payload, size_t n) {
+    if (!active) return;
+
+    unsigned char rec[REC_HEADER + REC_MAX];
+    size_t len = frame(rec, payload, n);
+    pthread_mutex_lock(&lock);
+    push(rec, len);
+    pthread_mutex_unlock(&lock);
+}
+
+// payload builder: type and game id, then fields
+static size_t begin(unsigned char *p, int type, int gid) {
+    p[0] = (unsigned char)type;
+    put_u32(p + 1, (uint32_t)gid);
+    return 5;
+}
+
+static size_t put_str(unsigned char *p, size_t at, const char *s, size_t max) {
+    size_t n = strlen(s);
+    if (n > max) n = max;
+    p[at] = (unsigned char)n;
+    memcpy(p + at + 1, s, n);
+    return at + 1 + n;
+}
+
+void journal_create(const Game *g) {
+    unsigned char p[REC_MAX];
+    size_t n = begin(p, J_CREATE, g->id);
+    p[n++] = (unsigned char)g->size;
+    p[n++] = (unsigned char)g->host_color;
+    p[n++] = (unsigned char)g->vs_bot;
+    n = put_str(p, n, g->host_nick, NICK_SIZE - 1);
+    n = put_str(p, n, g->game_name, GAME_NAME_SIZE - 1);
+    append(p, n);
+}
+
+void journal_join(const Game *g) {
+    unsigned char p[REC_MAX];
+    size_t n = begin(p, J_JOIN, g->id);
+    n = put_str(p, n, g->guest_nick, NICK_SIZE - 1);
+    append(p, n);
+}
+
+void journal_move(int gid, int color, int x, int y) {
+    unsigned char p[16];
+    size_t n = begin(p, J_MOVE, gid);
+    p[n++] = (unsigned char)color;
+    p[n++] = (unsigned char)x;
+    p[n++] = (unsigned char)y;
+    append(p, n);
+}
+
+void journal_pass(int gid, int color) {
+    unsigned char p[16];
+    size_t n = begin(p, J_PASS, gid);
+    p[n++] = (unsigned char)color;
+    append(p, n);
+}
+
+void journal_remove(int gid) {
+    unsigned char p[16];
+    append(p, begin(p, J_REMOVE, gid));
+}
+
+static size_t epoch_record(unsigned char *rec, uint64_t e) {
+    unsigned char p[16];
+    size_t n = begin(p, J_EPOCH, 0);
+    put_u64(p + n, e);
+    return frame(rec, p, n + 8);
+}
+
+// start epoch+1 in next_path, effective after everything appended so far
+static int rotate(void) {
+    int fd = open(next_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(next_path);
+        return -1;
+    }
+    unsigned char rec[EPOCH_REC];
+    epoch_record(rec, epoch + 1);
+
+    pthread_mutex_lock(&lock);
+    cut_fd = fd;
+    cut_at = fill.len;
+    if (push(rec, sizeof(rec)) < 0) {
+        cut_fd = -1;
+        pthread_mutex_unlock(&lock);
+        close(fd);
+        return -1;
+    }
+    pthread_mutex_unlock(&lock);
+
+    epoch++;
+    epoch_seq = appended_seq;
+    return 0;
+}
+
+void journal_tick(int64_t now_ms) {
+    if (!active) return;
+    if (last_snap_ms < 0) last_snap_ms = now_ms;   // the startup snapshot
+
+    if (snap_pid > 0) {
+        int st;
+        pid_t r = waitpid(snap_pid, &st, WNOHANG);
+        if (r == 0) return;
+        snap_pid = -1;
+        last_snap_ms = now_ms;
+        if (r < 0 || !WIFEXITED(st) || WEXITSTATUS(st) != 0) {
+            fprintf(stderr, "journal: snapshot failed, keeping the journal\n");
+            return;
+        }
+        if (need_rename) {
+            if (rename(next_path, jpath) < 0 || sync_parent_dir(jpath) < 0) {
+                perror("journal rename");
+                return;
+            }
+            need_rename = 0;
+        }
+        snap_seq = child_seq;
+        pthread_mutex_lock(&lock);
+        stats.snapshots++;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    if (snap_secs <= 0 || now_ms - last_snap_ms < (int64_t)snap_secs * 1000 || appended_seq == snap_seq) return;
+
+    // after a failed child the live epoch is already in next_path
+    if (!need_rename) {
+        if (rotate() < 0) return;
+        need_rename = 1;
+    }
+    child_seq = appended_seq;
+    snap_pid = snapshot_fork(snap_path, epoch, EPOCH_REC + appended_seq - epoch_seq);
+    if (snap_pid < 0) perror("snapshot fork");
+    last_snap_ms = now_ms;
+}
+
+void journal_sync(void) {
+    if (!active) return;
+    pthread_mutex_lock(&lock);
+    uint64_t want = appended_seq;
+    while (durable_seq < want) pthread_cond_wait(&synced, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+int journal_enabled(void) {
+    return active;
+}
+
+void journal_stats(JournalStats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+// ---- replay ----
+
+static int get_str(const unsigned char *p, size_t n, size_t *at, char *out, size_t outsz) {
+    if (*at >= n) return -1;
+    size_t len = p[*at];
+    if (*at + 1 + len > n || len >= outsz) return -1;
+    memcpy(out, p + *at + 1, len);
+    out[len] = '\0';
+    *at += 1 + len;
+    return 0;
+}
+
+static int apply(const unsigned char *p, size_t n) {
+    if (n < 5) return -1;
+    int type = p[0];
+    int gid = (int)get_u32(p + 1);
+    size_t at = 5;
+
+    if (type == J_CREATE) {
+        char nick[NICK_SIZE], name[GAME_NAME_SIZE];
+        if (n < at + 3) return -1;
+        int size = p[at], host_color = p[at + 1], vs_bot = p[at + 2];
+        at += 3;
+        if (get_str(p, n, &at, nick, sizeof(nick)) < 0 || get_str(p, n, &at, name, sizeof(name)) < 0)
+            return -1;
+        if (size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE) return -1;
+        return game_restore(gid, size, host_color & 1, vs_bot != 0, nick, name) ? 0 : -1;
+    }
+
+    if (type == J_EPOCH) return 0;
+
+    Game *g = find_game_by_id(gid);
+    if (!g) return -1;
+
+    switch (type) {
+    case J_JOIN:
+        if (get_str(p, n, &at, g->guest_nick, sizeof(g->guest_nick)) < 0) return -1;
+        g->status = GAME_RUNNING;
+        game_clear_board(g);
+        return 0;
+    case J_MOVE:
+        if (n < at + 3) return -1;
+        return game_play_move(g, p[at], p[at + 1], p[at + 2]) == MOVE_OK ? 0 : -1;
+    case J_PASS:
+        game_pass(g);
+        return 0;
+    case J_REMOVE:
+        game_forget(gid);
+        return 0;
+    }
+    return -1;
+}
+
+// epoch named by the first record of fd; 0 for an empty or pre-epoch file
+static uint64_t file_epoch(int fd) {
+    unsigned char rec[EPOCH_REC];
+    if (pread(fd, rec, sizeof(rec), 0) != (ssize_t)sizeof(rec)) return 0;
+    if (get_u32(rec) != EPOCH_REC - REC_HEADER || rec[REC_HEADER] != J_EPOCH) return 0;
+    if (crc32(rec + REC_HEADER, EPOCH_REC - REC_HEADER) != get_u32(rec + 4)) return 0;
+    return get_u64(rec + REC_HEADER + 5);
+}
+
+// apply every intact record from byte `from` on; 0 or -1 on a read error
+static int replay(int fd, uint64_t from) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    if ((uint64_t)st.st_size <= from) return 0;
+
+    size_t len = (size_t)st.st_size - (size_t)from;
+    unsigned char *data = malloc(len);
+    if (!data) return -1;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(fd, data + got, len - got, (off_t)(from + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            free(data);
+            return -1;
+        }
+        if (r == 0) break;
+        got += (size_t)r;
+    }
+
+    size_t off = 0;
+    long bad = 0;
+    while (off + REC_HEADER <= got) {
+        uint32_t n = get_u32(data + off);
+        if (n > REC_MAX || off + REC_HEADER + n > got) break;
+        if (crc32(data + off + REC_HEADER, n) != get_u32(data + off + 4)) break;
+        if (apply(data + off + REC_HEADER, n) < 0) bad++;
+        stats.replayed++;
+        off += REC_HEADER + n;
+    }
+    if (off < got) fprintf(stderr, "journal: dropping %zu bytes of torn tail\n", got - off);
+    if (bad) fprintf(stderr, "journal: %ld records did not apply\n", bad);
+    free(data);
+    return 0;
+}
+
+// replay path and path.next, oldest epoch first, skipping what the
+// snapshot already holds; returns the newest epoch seen or -1
+static int64_t replay_files(const SnapInfo *si) {
+    const char *names[2] = {jpath, next_path};
+    int fds[2];
+    uint64_t eps[2];
+    for (int i = 0; i < 2; i++) {
+        fds[i] = open(names[i], O_RDONLY | O_CLOEXEC);
+        if (fds[i] < 0 && errno != ENOENT) {
+            perror(names[i]);
+            if (i == 1) close(fds[0]);
+            return -1;
+        }
+        eps[i] = fds[i] >= 0 ? file_epoch(fds[i]) : 0;
+    }
+
+    int order[2] = {0, 1};
+    if (fds[0] >= 0 && fds[1] >= 0 && eps[1] < eps[0]) {
+        order[0] = 1;
+        order[1] = 0;
+    }
+
+    int64_t top = (int64_t)si->epoch;
+    int rc = 0;
+    for (int k = 0; k < 2; k++) {
+        int i = order[k];
+        if (fds[i] < 0) continue;
+        if (rc == 0 && eps[i] >= si->epoch) {
+            if (replay(fds[i], eps[i] == si->epoch ? si->offset : 0) < 0) {
+                perror(names[i]);
+                rc = -1;
+            }
+            if ((int64_t)eps[i] > top) top = (int64_t)eps[i];
+        }
+        close(fds[i]);
+    }
+    return rc < 0 ? -1 : top;
+}
+
+int journal_open(const char *path, int secs) {
+    snprintf(jpath, sizeof(jpath), "%s", path);
+    snprintf(next_path, sizeof(next_path), "%s.next", path);
+    snprintf(snap_path, sizeof(snap_path), "%s.snap", path);
+    snap_secs = secs;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    SnapInfo si;
+    if (snapshot_load(snap_path, &si) < 0) return -1;
+    stats.restored = si.games;
+    int64_t top = replay_files(&si);
+    if (top < 0) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats.restore_ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+    // new epoch: empty file, snapshot of everything so far, then the swap
+    epoch = (uint64_t)top + 1;
+    int fd = open(next_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(next_path);
+        return -1;
+    }
+    unsigned char rec[EPOCH_REC];
+    epoch_record(rec, epoch);
+    write_out(fd, rec, sizeof(rec));
+    if (fdatasync(fd) < 0 || snapshot_write(snap_path, epoch, EPOCH_REC) < 0 ||
+        rename(next_path, jpath) < 0 || sync_parent_dir(jpath) < 0) {
+        perror("journal snapshot");
+        close(fd);
+        return -1;
+    }
+    stats.snapshots = 1;
+    last_snap_ms = -1;
+
+    pthread_t th;
+    jfd = fd;
+    active = 1;
+    if (pthread_create(&th, NULL, io_main, NULL) != 0) {
+        active = 0;
+        jfd = -1;
+        close(fd);
+        return -1;
+    }
+    pthread_detach(th);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include "server_game.h"
+
+// Write-ahead journal of game events.
+// The select() loop appends small binary records to an in-memory batch;
+// a dedicated I/O thread writes each batch with one write() and one
+// fdatasync(), so records that arrive while a sync is running share the
+// next one (group commit) and the loop never waits for the disk. A crash
+// loses at most the batch in flight. On startup the file is replayed into
+// the game registry; restored games wait with empty seats until their
+// players reconnect under the same nick.
+//
+// Every journal file begins with an epoch record. Periodically the loop
+// switches appends to a new epoch in <path>.next at a record boundary
+// and forks a child that writes <path>.snap (server_snapshot.h) for that
+// boundary; once the child succeeds, <path>.next is renamed over <path>
+// and the old history is gone. Startup loads the snapshot and replays
+// only records after it, from whichever of the two files are newer.
+//
+// Record: u32 payload length, u32 CRC-32 of payload, payload
+// (u8 type, u32 game id, type-specific fields). Little-endian.
+
+typedef enum
+{
+    J_CREATE = 1,   // size, host colour, vs_bot, host nick, game name
+    J_JOIN = 2,     // guest nick; the game starts
+    J_MOVE = 3,     // colour, x, y
+    J_PASS = 4,     // colour
+    J_REMOVE = 5,   // game left, cancelled or abandoned
+    J_EPOCH = 6     // u64 epoch, first record of a file (game id 0)
+} JournalType;
+
+typedef struct
+{
+    uint64_t records;     // records appended since start
+    uint64_t batches;     // write + fdatasync rounds
+    uint64_t bytes;       // bytes written
+    uint64_t replayed;    // records applied at startup
+    uint64_t restored;    // games loaded from the snapshot at startup
+    uint64_t snapshots;   // snapshots completed, including the one at startup
+    double restore_ms;    // snapshot load plus replay
+} JournalStats;
+
+// load the snapshot, replay the journal after it, start a fresh epoch with
+// a new snapshot and start the I/O thread; 0 on success. snap_secs is the
+// interval for journal_tick, 0 = only at startup. Without a call to this
+// every append is a no-op.
+int journal_open(const char *path, int snap_secs);
+
+// call from the loop about once a second with its clock (server_io's
+// now_ms): reaps a finished snapshot child and starts the next one when due
+void journal_tick(int64_t now_ms);
+
+int journal_enabled(void);
+
+void journal_create(const Game *g);
+void journal_join(const Game *g);
+void journal_move(int gid, int color, int x, int y);
+void journal_pass(int gid, int color);
+void journal_remove(int gid);
+
+// flush everything appended so far and wait for it to be on disk
+void journal_sync(void);
+
+void journal_stats(JournalStats *out);
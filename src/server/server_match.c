@@ -0,0 +1,165 @@
+// server_match.c
+// Queues are plain arrays (swap-remove on cancel); each fd's position is
+// kept in a table indexed by fd. A pass collects its pairs first and
+// reports them once the queues are consistent again, so the callback may
+// seek or cancel freely (e.g. when a send fails and a client is closed).
+
+#include "server_match.h"
+#include "server_fdtab.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    Seek *seeks;
+    int len, cap;
+} Queue;
+
+typedef struct
+{
+    int size;                        // 0 = not seeking
+    int idx;
+} Where;
+
+static Queue queues[BOARD_MAX_SIZE + 1];
+static Where *where;
+static int where_cap;
+static uint64_t next_seq;
+static int waiting;
+
+static Seek (*pairs)[2];
+static int pairs_cap;
+static unsigned char *paired;
+static int paired_cap;
+
+int match_reserve_fd(int fd) {
+    Where *t = fdtab_reserve(where, &where_cap, sizeof(*where), 0, fd);
+    if (!t) return -1;
+    where = t;
+    return 0;
+}
+
+int match_seeking(int fd) {
+    return fd >= 0 && fd < where_cap && where[fd].size != 0;
+}
+
+int match_waiting(void) {
+    return waiting;
+}
+
+int match_seek(int fd, int size, char color, double rating, int64_t now_ms) {
+    if (match_seeking(fd)) return -1;
+    if (match_reserve_fd(fd) < 0) return -2;
+    Queue *q = &queues[size];
+    if (q->len == q->cap) {
+        int cap = q->cap ? q->cap * 2 : 16;
+        Seek *t = realloc(q->seeks, (size_t)cap * sizeof(*t));
+        if (!t) return -2;
+        q->seeks = t;
+        q->cap = cap;
+    }
+    Seek *s = &q->seeks[q->len];
+    s->fd = fd;
+    s->size = size;
+    s->color = color;
+    s->rating = rating;
+    s->since_ms = now_ms;
+    s->seq = next_seq++;
+    where[fd].size = size;
+    where[fd].idx = q->len++;
+    waiting++;
+    return 0;
+}
+
+int match_cancel(int fd) {
+    if (!match_seeking(fd)) return 0;
+    Queue *q = &queues[where[fd].size];
+    int i = where[fd].idx;
+    q->seeks[i] = q->seeks[--q->len];
+    if (i < q->len) where[q->seeks[i].fd].idx = i;
+    where[fd].size = 0;
+    waiting--;
+    return 1;
+}
+
+static int by_rating(const void *a, const void *b) {
+    const Seek *x = a, *y = b;
+    if (x->rating != y->rating) return x->rating < y->rating ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static double band(const Seek *s, int64_t now_ms) {
+    double b = MATCH_BAND + MATCH_BAND_GROWTH * (double)(now_ms - s->since_ms) / 1000.0;
+    return b < MATCH_BAND_MAX ? b : MATCH_BAND_MAX;
+}
+
+static int colors_clash(char a, char b) {
+    return a != 'R' && a == b;
+}
+
+// pair within one sorted queue, appending to pairs; returns pairs made
+static int pair_queue(Queue *q, int64_t now_ms, int npairs) {
+    int n = q->len;
+    if (n > paired_cap) {
+        unsigned char *t = realloc(paired, (size_t)n);
+        if (!t) return npairs;
+        paired = t;
+        paired_cap = n;
+    }
+    memset(paired, 0, (size_t)n);
+    qsort(q->seeks, (size_t)n, sizeof(Seek), by_rating);
+
+    for (int i = 0; i < n; i++) {
+        if (paired[i]) continue;
+        const Seek *a = &q->seeks[i];
+        double ba = band(a, now_ms);
+        for (int j = i + 1; j < n && j <= i + MATCH_LOOKAHEAD; j++) {
+            const Seek *b = &q->seeks[j];
+            double diff = b->rating - a->rating;
+            if (diff > ba) break;
+            if (paired[j] || diff > band(b, now_ms) || colors_clash(a->color, b->color)) continue;
+            if (npairs == pairs_cap) {
+                int cap = pairs_cap ? pairs_cap * 2 : 64;
+                void *t = realloc(pairs, (size_t)cap * sizeof(*pairs));
+                if (!t) return npairs;
+                pairs = t;
+                pairs_cap = cap;
+            }
+            pairs[npairs][0] = a->seq < b->seq ? *a : *b;
+            pairs[npairs][1] = a->seq < b->seq ? *b : *a;
+            npairs++;
+            paired[i] = paired[j] = 1;
+            break;
+        }
+    }
+
+    // keep the rest, in rating order
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        if (paired[i]) {
+            where[q->seeks[i].fd].size = 0;
+            waiting--;
+            continue;
+        }
+        q->seeks[k] = q->seeks[i];
+        where[q->seeks[k].fd].idx = k;
+        k++;
+    }
+    q->len = k;
+    return npairs;
+}
+
+int match_pass(int64_t now_ms, MatchPair fn, void *arg) {
+    int npairs = 0;
+    for (int size = BOARD_MIN_SIZE; size <= BOARD_MAX_SIZE; size++) {
+        if (queues[size].len >= 2) npairs = pair_queue(&queues[size], now_ms, npairs);
+    }
+    for (int i = 0; i < npairs; i++) fn(&pairs[i][0], &pairs[i][1], arg);
+    return npairs;
+}
+
+size_t match_bytes(void) {
+    size_t n = (size_t)where_cap * sizeof(*where) + (size_t)pairs_cap * sizeof(*pairs) + (size_t)paired_cap;
+    for (int size = 0; size <= BOARD_MAX_SIZE; size++) n += (size_t)queues[size].cap * sizeof(Seek);
+    return n;
+}
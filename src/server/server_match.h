@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "server_game.h"
+
+// Matchmaking queue for SEEK. Seeks wait in one queue per board size; a
+// pairing pass, run by the loop every MATCH_PASS_MS while anyone waits,
+// sorts each queue by rating (ties in arrival order) and pairs neighbours
+// whose ratings are within both players' bands. A band starts at
+// MATCH_BAND and widens by MATCH_BAND_GROWTH per second of waiting, so
+// nobody waits forever for an equal opponent. Sorting makes a pass
+// O(n log n), i.e. O(log n) per waiting seeker; SEEK and cancel are O(1).
+
+#define MATCH_PASS_MS 100
+#define MATCH_BAND 100.0
+#define MATCH_BAND_GROWTH 25.0       // points per second waited
+#define MATCH_BAND_MAX 700.0
+#define MATCH_LOOKAHEAD 4            // neighbours tried for a colour clash
+
+typedef struct
+{
+    int fd;
+    int size;
+    char color;                      // B, W or R
+    double rating;
+    int64_t since_ms;
+    uint64_t seq;                    // arrival order
+} Seek;
+
+// a pair made by match_pass; a is the earlier seeker
+typedef void (*MatchPair)(const Seek *a, const Seek *b, void *arg);
+
+// queue fd; 0 ok, -1 already seeking, -2 out of memory
+int match_seek(int fd, int size, char color, double rating, int64_t now_ms);
+
+// drop fd's seek; 1 if it had one
+int match_cancel(int fd);
+
+// room for fd in the seek position table, -1 if out of memory (taken
+// when accepting; match_seek takes it too for callers that never accept)
+int match_reserve_fd(int fd);
+
+int match_seeking(int fd);
+
+// seeks waiting
+int match_waiting(void);
+
+// pair what can be paired; returns the number of pairs
+int match_pass(int64_t now_ms, MatchPair fn, void *arg);
+
+// bytes held by the queues and the per-fd table
+size_t match_bytes(void);
@@ -0,0 +1,238 @@
+// server_metrics.c
+
+#include "server_metrics.h"
+#include <string.h>
+#include <time.h>
+
+static const char *cmd_names[CMD_COUNT] = {
+    "NICK", "SUB", "GAMES", "HOST", "HOST_BOT", "JOIN", "SEEK", "MOVE", "PASS",
+    "LEAVE", "CANCEL", "QUIT", "HISTORY", "GAME_RECORD", "RATING", "STATS", "PING", "OTHER"
+};
+
+static const char *mem_names[MEM_COUNT] = {
+    "clients", "rxbufs", "games", "boards", "moves", "match", "ratings", "tt", "bot"
+};
+
+static size_t cmd_len[CMD_COUNT];
+static Histogram cmd_hist[CMD_COUNT];
+static uint64_t cmd_count[CMD_COUNT];
+static Histogram loop_hist;
+static uint64_t bytes_in, bytes_out;
+static uint64_t bot_rejected;
+static uint64_t start_ns;
+static double ns_per_tick = 1.0;
+
+// perfect hash of the command words: first letter * 14 + last letter +
+// length, mod 32, collision-free for cmd_names (checked in metrics_init)
+#define CMD_HASH(first, last, n) (((unsigned)(unsigned char)(first) * 14u + (unsigned char)(last) + (unsigned)(n)) & 31u)
+
+static signed char cmd_by_hash[32];
+
+uint64_t metrics_now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+void metrics_init(void) {
+    start_ns = metrics_now_ns();
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t t0 = metrics_ticks(), n0 = metrics_now_ns();
+    struct timespec wait = {0, 20 * 1000 * 1000};
+    nanosleep(&wait, NULL);
+    uint64_t t1 = metrics_ticks(), n1 = metrics_now_ns();
+    if (t1 > t0) ns_per_tick = (double)(n1 - n0) / (double)(t1 - t0);
+#endif
+    memset(cmd_by_hash, -1, sizeof(cmd_by_hash));
+    for (int c = 0; c < CMD_OTHER; c++) {
+        size_t n = strlen(cmd_names[c]);
+        unsigned h = CMD_HASH(cmd_names[c][0], cmd_names[c][n - 1], n);
+        if (cmd_by_hash[h] >= 0) fprintf(stderr, "metrics: %s and %s share a hash\n", cmd_names[c], cmd_names[(int)cmd_by_hash[h]]);
+        cmd_by_hash[h] = (signed char)c;
+        cmd_len[c] = n;
+    }
+}
+
+uint64_t metrics_uptime_s(void) {
+    return (metrics_now_ns() - start_ns) / 1000000000ull;
+}
+
+MetricCmd metrics_command(const char *line) {
+    size_t n = 0;
+    while (line[n] && line[n] != ' ' && line[n] != '\r' && line[n] != '\n') n++;
+    if (n == 0) return CMD_OTHER;
+    int c = cmd_by_hash[CMD_HASH(line[0], line[n - 1], n)];
+    if (c < 0 || cmd_len[c] != n || memcmp(cmd_names[c], line, n) != 0) return CMD_OTHER;
+    return (MetricCmd)c;
+}
+
+uint64_t metrics_ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)((double)ticks * ns_per_tick);
+}
+
+const char *metrics_command_name(MetricCmd cmd) {
+    return cmd_names[cmd];
+}
+
+void metrics_command_done(MetricCmd cmd, uint64_t ns) {
+    cmd_count[cmd]++;
+    hist_record(&cmd_hist[cmd], ns);
+}
+
+void metrics_loop(uint64_t ns) {
+    hist_record(&loop_hist, ns);
+}
+
+void metrics_bytes_in(size_t n) {
+    bytes_in += n;
+}
+
+void metrics_bytes_out(size_t n) {
+    bytes_out += n;
+}
+
+void metrics_bot_rejected(void) {
+    bot_rejected++;
+}
+
+// ---- histograms ----
+
+static int bucket_of(uint64_t v) {
+    if (v < (1u << HIST_SUB_BITS)) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift << HIST_SUB_BITS) + (int)(v >> shift);
+}
+
+static uint64_t bucket_low(int b) {
+    if (b < (1 << (HIST_SUB_BITS + 1))) return (uint64_t)b;
+    int shift = (b >> HIST_SUB_BITS) - 1;
+    return (uint64_t)((b & ((1 << HIST_SUB_BITS) - 1)) + (1 << HIST_SUB_BITS)) << shift;
+}
+
+static uint64_t bucket_width(int b) {
+    if (b < (1 << (HIST_SUB_BITS + 1))) return 1;
+    return 1ull << ((b >> HIST_SUB_BITS) - 1);
+}
+
+void hist_record(Histogram *h, uint64_t v) {
+    h->count++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+    h->buckets[bucket_of(v)]++;
+}
+
+uint64_t hist_quantile(const Histogram *h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count);
+    if (rank >= h->count) rank = h->count - 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen > rank) {
+            uint64_t mid = bucket_low(b) + bucket_width(b) / 2;
+            return mid < h->max ? mid : h->max;
+        }
+    }
+    return h->max;
+}
+
+// ---- output ----
+
+static double us(uint64_t ns) {
+    return (double)ns / 1000.0;
+}
+
+void metrics_write_stats(FILE *f, const MetricsGauges *g) {
+    fprintf(f, "STATS_BEGIN\n");
+    fprintf(f, "STAT uptime_s %llu\n", (unsigned long long)metrics_uptime_s());
+    fprintf(f, "STAT clients %d\n", g->clients);
+    fprintf(f, "STAT games %d\n", g->games);
+    fprintf(f, "STAT bot_games %d\n", g->bot_games);
+    fprintf(f, "STAT bot_queue %d\n", g->bot_queue);
+    fprintf(f, "STAT bot_rejected %llu\n", (unsigned long long)bot_rejected);
+    fprintf(f, "STAT seeks %d\n", g->seeks);
+    fprintf(f, "STAT bytes_in %llu\n", (unsigned long long)bytes_in);
+    fprintf(f, "STAT bytes_out %llu\n", (unsigned long long)bytes_out);
+    fprintf(f, "STAT journal_records %llu\n", (unsigned long long)g->journal_records);
+    fprintf(f, "STAT journal_batches %llu\n", (unsigned long long)g->journal_batches);
+    fprintf(f, "STAT archive_games %llu\n", (unsigned long long)g->archive_games);
+    fprintf(f, "STAT archive_bytes %llu\n", (unsigned long long)g->archive_bytes);
+    fprintf(f, "STAT slow_logged %llu\n", (unsigned long long)g->slow_logged);
+    fprintf(f, "STAT slow_dropped %llu\n", (unsigned long long)g->slow_dropped);
+    uint64_t mem_total = 0;
+    for (int m = 0; m < MEM_COUNT; m++) {
+        fprintf(f, "STAT mem_%s %llu\n", mem_names[m], (unsigned long long)g->mem[m]);
+        mem_total += g->mem[m];
+    }
+    fprintf(f, "STAT mem_total %llu\n", (unsigned long long)mem_total);
+    // <name> <count> <p50> <p90> <p99> <max>, microseconds
+    fprintf(f, "LOOP %llu %.1f %.1f %.1f %.1f\n", (unsigned long long)loop_hist.count,
+            us(hist_quantile(&loop_hist, 0.5)), us(hist_quantile(&loop_hist, 0.9)),
+            us(hist_quantile(&loop_hist, 0.99)), us(loop_hist.max));
+    for (int c = 0; c < CMD_COUNT; c++) {
+        const Histogram *h = &cmd_hist[c];
+        if (!cmd_count[c]) continue;
+        fprintf(f, "CMD %s %llu %.1f %.1f %.1f %.1f\n", cmd_names[c], (unsigned long long)cmd_count[c],
+                us(hist_quantile(h, 0.5)), us(hist_quantile(h, 0.9)), us(hist_quantile(h, 0.99)), us(h->max));
+    }
+    fprintf(f, "STATS_END\n");
+}
+
+static void prom_summary(FILE *f, const char *name, const char *label, const Histogram *h) {
+    static const double qs[] = {0.5, 0.9, 0.99, 0.999};
+    for (size_t i = 0; i < sizeof(qs) / sizeof(qs[0]); i++)
+        fprintf(f, "%s{%s%squantile=\"%g\"} %.9f\n", name, label, *label ? "," : "", qs[i],
+                (double)hist_quantile(h, qs[i]) / 1e9);
+    const char *open = *label ? "{" : "", *close = *label ? "}" : "";
+    fprintf(f, "%s_sum%s%s%s %.9f\n", name, open, label, close, (double)h->sum / 1e9);
+    fprintf(f, "%s_count%s%s%s %llu\n", name, open, label, close, (unsigned long long)h->count);
+}
+
+void metrics_write_prometheus(FILE *f, const MetricsGauges *g) {
+    fprintf(f, "# TYPE goserver_uptime_seconds gauge\ngoserver_uptime_seconds %.3f\n",
+            (double)(metrics_now_ns() - start_ns) / 1e9);
+    fprintf(f, "# TYPE goserver_clients gauge\ngoserver_clients %d\n", g->clients);
+    fprintf(f, "# TYPE goserver_games gauge\ngoserver_games %d\n", g->games);
+    fprintf(f, "# TYPE goserver_bot_games gauge\ngoserver_bot_games %d\n", g->bot_games);
+    fprintf(f, "# TYPE goserver_bot_queue gauge\ngoserver_bot_queue %d\n", g->bot_queue);
+    fprintf(f, "# TYPE goserver_bot_rejected_total counter\ngoserver_bot_rejected_total %llu\n",
+            (unsigned long long)bot_rejected);
+    fprintf(f, "# TYPE goserver_seeks gauge\ngoserver_seeks %d\n", g->seeks);
+    fprintf(f, "# TYPE goserver_received_bytes_total counter\ngoserver_received_bytes_total %llu\n",
+            (unsigned long long)bytes_in);
+    fprintf(f, "# TYPE goserver_sent_bytes_total counter\ngoserver_sent_bytes_total %llu\n",
+            (unsigned long long)bytes_out);
+    fprintf(f, "# TYPE goserver_journal_records_total counter\ngoserver_journal_records_total %llu\n",
+            (unsigned long long)g->journal_records);
+    fprintf(f, "# TYPE goserver_journal_batches_total counter\ngoserver_journal_batches_total %llu\n",
+            (unsigned long long)g->journal_batches);
+    fprintf(f, "# TYPE goserver_archived_games_total counter\ngoserver_archived_games_total %llu\n",
+            (unsigned long long)g->archive_games);
+    fprintf(f, "# TYPE goserver_archived_bytes_total counter\ngoserver_archived_bytes_total %llu\n",
+            (unsigned long long)g->archive_bytes);
+    fprintf(f, "# TYPE goserver_slow_events_total counter\ngoserver_slow_events_total %llu\n",
+            (unsigned long long)g->slow_logged);
+    fprintf(f, "# TYPE goserver_slow_events_dropped_total counter\ngoserver_slow_events_dropped_total %llu\n",
+            (unsigned long long)g->slow_dropped);
+    fprintf(f, "# TYPE goserver_memory_bytes gauge\n");
+    for (int m = 0; m < MEM_COUNT; m++)
+        fprintf(f, "goserver_memory_bytes{subsystem=\"%s\"} %llu\n", mem_names[m], (unsigned long long)g->mem[m]);
+
+    fprintf(f, "# TYPE goserver_loop_iteration_seconds summary\n");
+    prom_summary(f, "goserver_loop_iteration_seconds", "", &loop_hist);
+
+    fprintf(f, "# TYPE goserver_commands_total counter\n");
+    for (int c = 0; c < CMD_COUNT; c++) {
+        if (cmd_count[c])
+            fprintf(f, "goserver_commands_total{cmd=\"%s\"} %llu\n", cmd_names[c], (unsigned long long)cmd_count[c]);
+    }
+
+    fprintf(f, "# TYPE goserver_command_seconds summary\n");
+    for (int c = 0; c < CMD_COUNT; c++) {
+        if (!cmd_hist[c].count) continue;
+        char label[48];
+        snprintf(label, sizeof(label), "cmd=\"%s\"", cmd_names[c]);
+        prom_summary(f, "goserver_command_seconds", label, &cmd_hist[c]);
+    }
+}
@@ -0,0 +1,136 @@
+// server_pattern.c
+// Hand-made playout weights: the classic MoGo/Michi 3x3 shapes (hane,
+// cut, edge) get a boost, captures and atari escapes get a larger one,
+// own eyes and suicides get zero. Everything is folded into lookup
+// tables so a playout only does two loads per point update.
+
+#include "server_pattern.h"
+#include <pthread.h>
+
+enum { C_EMPTY = 0, C_BLACK = 1, C_WHITE = 2, C_OFF = 3 };
+
+uint8_t pattern_shape_w[2][1 << 16];
+int16_t pattern_atari_w[2][1 << 12];
+
+static uint8_t shape_bits[(1 << 16) / 8];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+// X/O are the two colours (either way round), x = not X, o = not O,
+// ' ' = off board, ? = anything; the move is the centre point
+static const char *shapes[][3] = {
+    {"XOX", "...", "???"},   // hane - enclosing
+    {"XO.", "...", "?.?"},   // hane - non-cutting
+    {"XO?", "X..", "x.?"},   // hane - magari
+    {".O.", "X..", "..."},   // katatsuke / diagonal attachment
+    {"XO?", "O.o", "?o?"},   // cut1 - unprotected
+    {"XO?", "O.X", "???"},   // cut1 - peeped
+    {"?X?", "O.O", "ooo"},   // cut2
+    {"OX?", "o.O", "???"},   // cut keima
+    {"X.?", "O.?", "   "},   // side - chase
+    {"OX?", "X.O", "   "},   // side - block side cut
+    {"?X?", "x.O", "   "},   // side - block side connection
+    {"?XO", "x.x", "   "},   // side - sagari
+    {"?OX", "X.O", "   "},   // side - cut
+};
+
+// relative (dx,dy) of neighbour j
+static const int pat_dx[8] = { 0, 1, 0, -1,  1, 1, -1, -1};
+static const int pat_dy[8] = {-1, 0, 1,  0, -1, 1,  1, -1};
+
+static void decode(uint16_t code, int grid[3][3]) {
+    grid[1][1] = C_EMPTY;
+    for (int j = 0; j < 8; j++)
+        grid[1 + pat_dy[j]][1 + pat_dx[j]] = pattern_color(code, j);
+}
+
+static int cell_matches(char p, int c, int x_color) {
+    int o_color = (x_color == C_BLACK ? C_WHITE : C_BLACK);
+    switch (p) {
+    case 'X': return c == x_color;
+    case 'O': return c == o_color;
+    case 'x': return c != x_color;
+    case 'o': return c != o_color;
+    case '.': return c == C_EMPTY;
+    case ' ': return c == C_OFF;
+    default:  return 1;
+    }
+}
+
+static int shape_matches(const char *rows[3], int grid[3][3]) {
+    for (int t = 0; t < 8; t++) {
+        for (int x_color = C_BLACK; x_color <= C_WHITE; x_color++) {
+            int ok = 1;
+            for (int r = 0; r < 3 && ok; r++) {
+                for (int col = 0; col < 3 && ok; col++) {
+                    int dx = col - 1, dy = r - 1;
+                    if (t & 4) dx = -dx;
+                    for (int k = 0; k < (t & 3); k++) {
+                        int tmp = dx; dx = -dy; dy = tmp;
+                    }
+                    ok = cell_matches(rows[r][col], grid[1 + dy][1 + dx], x_color);
+                }
+            }
+            if (ok) return 1;
+        }
+    }
+    return 0;
+}
+
+// same rule as pb_is_eye, on a code
+static int code_is_eye(uint16_t code, int me) {
+    for (int j = PAT_N; j <= PAT_W; j++) {
+        int c = pattern_color(code, j);
+        if (c != me && c != C_OFF) return 0;
+    }
+    int opp = 0, off = 0;
+    for (int j = PAT_NE; j <= PAT_NW; j++) {
+        int c = pattern_color(code, j);
+        if (c == C_OFF) off = 1;
+        else if (c != me && c != C_EMPTY) opp++;
+    }
+    return opp + off < 2;
+}
+
+static int atari_bonus(int to_move, int index) {
+    int me = (to_move == 0 ? C_BLACK : C_WHITE);
+    int legal = 0, capture = 0, escape = 0;
+    for (int j = PAT_N; j <= PAT_W; j++) {
+        int c = (index >> (2 * j)) & 3;
+        int atari = (index >> (8 + j)) & 1;
+        if (c == C_EMPTY) legal = 1;
+        else if (c == me && !atari) legal = 1;
+        else if (c == me && atari) escape = 1;
+        else if (c != C_OFF && atari) legal = capture = 1;
+    }
+    if (!legal) return -1;
+    return (capture ? PAT_CAPTURE_WEIGHT : 0) + (escape ? PAT_ESCAPE_WEIGHT : 0);
+}
+
+static void build_tables(void) {
+    int grid[3][3];
+    for (int code = 0; code < (1 << 16); code++) {
+        decode((uint16_t)code, grid);
+        int shape = 0;
+        for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]) && !shape; i++)
+            shape = shape_matches(shapes[i], grid);
+        if (shape) shape_bits[code >> 3] |= (uint8_t)(1u << (code & 7));
+
+        for (int tm = 0; tm < 2; tm++) {
+            int me = (tm == 0 ? C_BLACK : C_WHITE);
+            if (code_is_eye((uint16_t)code, me)) pattern_shape_w[tm][code] = 0;
+            else pattern_shape_w[tm][code] = shape ? PAT_MATCH_WEIGHT : PAT_BASE_WEIGHT;
+        }
+    }
+    for (int tm = 0; tm < 2; tm++) {
+        for (int i = 0; i < (1 << 12); i++)
+            pattern_atari_w[tm][i] = (int16_t)atari_bonus(tm, i);
+    }
+}
+
+void pattern_init(void) {
+    pthread_once(&tables_once, build_tables);
+}
+
+int pattern_is_shape(uint16_t code) {
+    return (shape_bits[code >> 3] >> (code & 7)) & 1;
+}
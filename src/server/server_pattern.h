@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+
+// 3x3 pattern codes and the playout move-weight table.
+// A point's code packs its 8 neighbours, 2 bits each (PB_EMPTY, PB_BLACK,
+// PB_WHITE, PB_OFF): bits 0-7 are N,E,S,W and bits 8-15 are NE,SE,SW,NW.
+// Atari bits are kept next to it, one per orthogonal neighbour (N,E,S,W)
+// whose group has a single liberty.
+
+#define PAT_N 0
+#define PAT_E 1
+#define PAT_S 2
+#define PAT_W 3
+#define PAT_NE 4
+#define PAT_SE 5
+#define PAT_SW 6
+#define PAT_NW 7
+
+#define PAT_BASE_WEIGHT 10
+#define PAT_MATCH_WEIGHT 100
+#define PAT_CAPTURE_WEIGHT 300
+#define PAT_ESCAPE_WEIGHT 150
+
+// filled by pattern_init(), indexed by to_move (0 black / 1 white)
+extern uint8_t pattern_shape_w[2][1 << 16];   // by code; 0 for own eyes
+extern int16_t pattern_atari_w[2][1 << 12];   // by (code & 0xff) | atari << 8; -1 if suicide
+
+// build the tables once; safe to call from any thread
+void pattern_init(void);
+
+// colour of neighbour j (PAT_*) in code
+static inline int pattern_color(uint16_t code, int j) {
+    return (code >> (2 * j)) & 3;
+}
+
+// playout weight of an empty point; 0 means never play it
+static inline int pattern_weight(int to_move, uint16_t code, uint8_t atari) {
+    int a = pattern_atari_w[to_move][(code & 0xff) | (atari << 8)];
+    int w = pattern_shape_w[to_move][code];
+    return (a < 0 || w == 0) ? 0 : w + a;
+}
+
+// 1 if code matches one of the built-in shape patterns
+int pattern_is_shape(uint16_t code);
@@ -0,0 +1,463 @@
+// server_playout.c
+// Incremental playout board: no BFS and no board copies per move.
+// With patterns enabled every stone change also patches the 3x3 codes of
+// its 8 neighbours, groups whose liberties changed refresh the atari bits
+// of their liberties, and the Fenwick trees follow each weight change.
+
+#include "server_playout.h"
+#include "server_pattern.h"
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define MAX_TOUCHED 64
+
+typedef struct
+{
+    int n;
+    int head[MAX_TOUCHED];
+    int overflow;
+} Touched;
+
+uint64_t pb_zobrist[2][PB_CELLS];
+uint64_t pb_zobrist_white_to_move;
+uint64_t pb_zobrist_size[BOARD_MAX_SIZE + 1];
+
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t *s) {
+    uint64_t z = (*s += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void zobrist_build(void) {
+    uint64_t seed = 0x60b0a2d5u;
+    for (int c = 0; c < 2; c++)
+        for (int p = 0; p < PB_CELLS; p++) pb_zobrist[c][p] = splitmix64(&seed);
+    pb_zobrist_white_to_move = splitmix64(&seed);
+    for (int n = 0; n <= BOARD_MAX_SIZE; n++) pb_zobrist_size[n] = splitmix64(&seed);
+}
+
+static void empty_add(PlayoutBoard *pb, int p) {
+    pb->empty_pos[p] = (uint16_t)pb->empty_count;
+    pb->empty[pb->empty_count++] = (uint16_t)p;
+}
+
+static void empty_remove(PlayoutBoard *pb, int p) {
+    int i = pb->empty_pos[p];
+    int last = pb->empty[--pb->empty_count];
+    pb->empty[i] = (uint16_t)last;
+    pb->empty_pos[last] = (uint16_t)i;
+}
+
+static void add_lib(PlayoutBoard *pb, int head, int p) {
+    pb->libs[head]++;
+    pb->lib_sum[head] += p;
+    pb->lib_sq[head] += (int64_t)p * p;
+}
+
+static void del_lib(PlayoutBoard *pb, int head, int p) {
+    pb->libs[head]--;
+    pb->lib_sum[head] -= p;
+    pb->lib_sq[head] -= (int64_t)p * p;
+}
+
+// exactly one distinct liberty: every pseudo-liberty is the same point
+static int in_atari(const PlayoutBoard *pb, int head) {
+    int64_t n = pb->libs[head];
+    int64_t s = pb->lib_sum[head];
+    return n > 0 && n * pb->lib_sq[head] == s * s;
+}
+
+static void touch(Touched *t, int head) {
+    for (int i = 0; i < t->n; i++) if (t->head[i] == head) return;
+    if (t->n < MAX_TOUCHED) t->head[t->n++] = head;
+    else t->overflow = 1;
+}
+
+static void fen_add(PlayoutBoard *pb, int tm, int p, int32_t delta) {
+    pb->weight_sum[tm] += delta;
+    for (int i = p + 1; i <= pb->fen_size; i += i & -i)
+        pb->fen[tm][i] += delta;
+}
+
+// point whose prefix weight passes r (0 <= r < weight_sum)
+static int fen_find(const PlayoutBoard *pb, int tm, int32_t r) {
+    int pos = 0;
+    for (int step = pb->fen_size; step > 0; step >>= 1) {
+        if (pos + step <= pb->fen_size && pb->fen[tm][pos + step] <= r) {
+            pos += step;
+            r -= pb->fen[tm][pos];
+        }
+    }
+    return pos;
+}
+
+static void pat_refresh(PlayoutBoard *pb, int p) {
+    for (int tm = 0; tm < 2; tm++) {
+        int32_t w = 0;
+        if (pb->color[p] == PB_EMPTY && p != pb->ko_point)
+            w = pattern_weight(tm, pb->pat[p], pb->atari[p]);
+        if (w != pb->weight[tm][p]) {
+            fen_add(pb, tm, p, w - pb->weight[tm][p]);
+            pb->weight[tm][p] = w;
+        }
+    }
+}
+
+// p changed colour: patch the code of every point that sees it
+static void pat_set_color(PlayoutBoard *pb, int p, int c) {
+    for (int j = 0; j < 8; j++) {
+        int n = p - pb->pat_off[j];
+        if (pb->color[n] == PB_OFF) continue;
+        pb->pat[n] = (uint16_t)((pb->pat[n] & ~(3u << (2 * j))) | ((unsigned)c << (2 * j)));
+        pat_refresh(pb, n);
+    }
+    pat_refresh(pb, p);
+}
+
+// set the atari bit of every liberty of group head
+static void pat_update_atari(PlayoutBoard *pb, int head) {
+    int a = in_atari(pb, head);
+    int s = head;
+    do {
+        for (int j = PAT_N; j <= PAT_W; j++) {
+            int n = s + pb->pat_off[j];
+            if (pb->color[n] != PB_EMPTY) continue;
+            uint8_t bit = (uint8_t)(1u << ((j + 2) & 3)); // n sees s in the opposite direction
+            uint8_t v = a ? (uint8_t)(pb->atari[n] | bit) : (uint8_t)(pb->atari[n] & ~bit);
+            if (v != pb->atari[n]) {
+                pb->atari[n] = v;
+                pat_refresh(pb, n);
+            }
+        }
+        s = pb->next[s];
+    } while (s != head);
+}
+
+static void pat_rebuild(PlayoutBoard *pb) {
+    int cells = pb->stride * pb->stride;
+    for (int tm = 0; tm < 2; tm++) {
+        memset(pb->weight[tm], 0, (size_t)cells * sizeof(pb->weight[tm][0]));
+        memset(pb->fen[tm], 0, (size_t)(pb->fen_size + 1) * sizeof(pb->fen[tm][0]));
+    }
+    pb->weight_sum[0] = pb->weight_sum[1] = 0;
+
+    for (int p = 0; p < cells; p++) {
+        pb->pat[p] = 0;
+        pb->atari[p] = 0;
+        if (pb->color[p] == PB_OFF) continue;
+        for (int j = 0; j < 8; j++)
+            pb->pat[p] |= (uint16_t)(pb->color[p + pb->pat_off[j]] << (2 * j));
+    }
+    for (int p = 0; p < cells; p++) {
+        if (pb->color[p] != PB_EMPTY) continue;
+        for (int j = PAT_N; j <= PAT_W; j++) {
+            int c = pb->color[p + pb->pat_off[j]];
+            if ((c == PB_BLACK || c == PB_WHITE) && in_atari(pb, pb->group[p + pb->pat_off[j]]))
+                pb->atari[p] |= (uint8_t)(1u << j);
+        }
+        pat_refresh(pb, p);
+    }
+}
+
+void pb_enable_patterns(PlayoutBoard *pb) {
+    pattern_init();
+    pb->patterns = 1;
+    pat_rebuild(pb);
+}
+
+void pb_init(PlayoutBoard *pb, int size) {
+    pthread_once(&zobrist_once, zobrist_build);
+    pb->size = size;
+    pb->hash = pb_zobrist_size[size];
+    pb->stride = size + 2;
+    pb->to_move = 0;
+    pb->passes = 0;
+    pb->ko_point = -1;
+    pb->caps[0] = pb->caps[1] = 0;
+    pb->empty_count = 0;
+    pb->patterns = 0;
+    pb->fen_size = 1;
+    while (pb->fen_size < (size + 2) * (size + 2)) pb->fen_size *= 2;
+
+    const int dx[8] = { 0, 1, 0, -1,  1, 1, -1, -1};
+    const int dy[8] = {-1, 0, 1,  0, -1, 1,  1, -1};
+    for (int j = 0; j < 8; j++) pb->pat_off[j] = dy[j] * pb->stride + dx[j];
+
+    int cells = pb->stride * pb->stride;
+    for (int p = 0; p < cells; p++) {
+        int x = p % pb->stride, y = p / pb->stride;
+        int off = (x == 0 || y == 0 || x == pb->stride - 1 || y == pb->stride - 1);
+        pb->color[p] = off ? PB_OFF : PB_EMPTY;
+        pb->group[p] = 0;
+        if (!off) empty_add(pb, p);
+    }
+}
+
+void pb_copy(PlayoutBoard *dst, const PlayoutBoard *src) {
+    size_t cells = (size_t)src->stride * (size_t)src->stride;
+    memcpy(dst, src, offsetof(PlayoutBoard, color));
+    memcpy(dst->color, src->color, cells * sizeof(src->color[0]));
+    memcpy(dst->group, src->group, cells * sizeof(src->group[0]));
+    memcpy(dst->next, src->next, cells * sizeof(src->next[0]));
+    memcpy(dst->stones, src->stones, cells * sizeof(src->stones[0]));
+    memcpy(dst->libs, src->libs, cells * sizeof(src->libs[0]));
+    memcpy(dst->lib_sum, src->lib_sum, cells * sizeof(src->lib_sum[0]));
+    memcpy(dst->lib_sq, src->lib_sq, cells * sizeof(src->lib_sq[0]));
+    memcpy(dst->empty, src->empty, (size_t)src->empty_count * sizeof(src->empty[0]));
+    memcpy(dst->empty_pos, src->empty_pos, cells * sizeof(src->empty_pos[0]));
+    if (!src->patterns) return;
+
+    memcpy(dst->pat, src->pat, cells * sizeof(src->pat[0]));
+    memcpy(dst->atari, src->atari, cells * sizeof(src->atari[0]));
+    for (int tm = 0; tm < 2; tm++) {
+        memcpy(dst->weight[tm], src->weight[tm], cells * sizeof(src->weight[tm][0]));
+        memcpy(dst->fen[tm], src->fen[tm], (size_t)(src->fen_size + 1) * sizeof(src->fen[tm][0]));
+    }
+}
+
+static void merge(PlayoutBoard *pb, int a, int b) {
+    if (pb->stones[a] < pb->stones[b]) { int t = a; a = b; b = t; }
+
+    int s = b;
+    do {
+        pb->group[s] = (uint16_t)a;
+        s = pb->next[s];
+    } while (s != b);
+
+    uint16_t t = pb->next[a];
+    pb->next[a] = pb->next[b];
+    pb->next[b] = t;
+
+    pb->stones[a] += pb->stones[b];
+    pb->libs[a] += pb->libs[b];
+    pb->lib_sum[a] += pb->lib_sum[b];
+    pb->lib_sq[a] += pb->lib_sq[b];
+}
+
+static int remove_stones(PlayoutBoard *pb, int head, Touched *t) {
+    int count = 0;
+    int s = head;
+    do {
+        pb->hash ^= pb_zobrist[pb->color[s] - 1][s];
+        pb->color[s] = PB_EMPTY;
+        empty_add(pb, s);
+        count++;
+        const int nb[4] = {s - 1, s + 1, s - pb->stride, s + pb->stride};
+        for (int k = 0; k < 4; k++) {
+            int c = pb->color[nb[k]];
+            if ((c == PB_BLACK || c == PB_WHITE) && pb->group[nb[k]] != head) {
+                add_lib(pb, pb->group[nb[k]], s);
+                touch(t, pb->group[nb[k]]);
+            }
+        }
+        if (pb->patterns) {
+            pb->atari[s] = 0;
+            pat_set_color(pb, s, PB_EMPTY);
+        }
+        s = pb->next[s];
+    } while (s != head);
+    return count;
+}
+
+// place a stone without capture or ko bookkeeping
+static void place_stone(PlayoutBoard *pb, int p, int me) {
+    empty_remove(pb, p);
+    pb->color[p] = (unsigned char)me;
+    pb->hash ^= pb_zobrist[me - 1][p];
+    pb->group[p] = (uint16_t)p;
+    pb->next[p] = (uint16_t)p;
+    pb->stones[p] = 1;
+    pb->libs[p] = 0;
+    pb->lib_sum[p] = 0;
+    pb->lib_sq[p] = 0;
+
+    const int nb[4] = {p - 1, p + 1, p - pb->stride, p + pb->stride};
+    for (int k = 0; k < 4; k++) {
+        int c = pb->color[nb[k]];
+        if (c == PB_EMPTY) add_lib(pb, p, nb[k]);
+        else if (c != PB_OFF) del_lib(pb, pb->group[nb[k]], p);
+    }
+    for (int k = 0; k < 4; k++) {
+        if (pb->color[nb[k]] == me && pb->group[nb[k]] != pb->group[p])
+            merge(pb, pb->group[p], pb->group[nb[k]]);
+    }
+}
+
+void pb_from_game(PlayoutBoard *pb, const Game *g) {
+    pb_init(pb, g->size);
+    int n = g->size * g->size;
+    for (int i = 0; i < n; i++) {
+        if (g->board[i] != 0)
+            place_stone(pb, pb_point(pb, i % g->size, i / g->size), g->board[i]);
+    }
+    pb->to_move = g->to_move;
+    if (pb->to_move) pb->hash ^= pb_zobrist_white_to_move;
+    pb->passes = g->consecutive_passes;
+    pb->caps[0] = g->cap_black;
+    pb->caps[1] = g->cap_white;
+}
+
+int pb_is_legal(const PlayoutBoard *pb, int p) {
+    if (pb->color[p] != PB_EMPTY || p == pb->ko_point) return 0;
+
+    int me = (pb->to_move == 0 ? PB_BLACK : PB_WHITE);
+    const int nb[4] = {p - 1, p + 1, p - pb->stride, p + pb->stride};
+    for (int k = 0; k < 4; k++) {
+        int c = pb->color[nb[k]];
+        if (c == PB_EMPTY) return 1;
+        if (c == PB_OFF) continue;
+        int atari = in_atari(pb, pb->group[nb[k]]);
+        if (c == me && !atari) return 1;  // joins a group with another liberty
+        if (c != me && atari) return 1;   // captures
+    }
+    return 0;
+}
+
+int pb_is_eye(const PlayoutBoard *pb, int p, int me) {
+    const int s = pb->stride;
+    const int nb[4] = {p - 1, p + 1, p - s, p + s};
+    for (int k = 0; k < 4; k++) {
+        int c = pb->color[nb[k]];
+        if (c != me && c != PB_OFF) return 0;
+    }
+
+    const int diag[4] = {p - s - 1, p - s + 1, p + s - 1, p + s + 1};
+    int opp = 0, off = 0;
+    for (int k = 0; k < 4; k++) {
+        int c = pb->color[diag[k]];
+        if (c == PB_OFF) off = 1;
+        else if (c != me && c != PB_EMPTY) opp++;
+    }
+    return opp + off < 2;
+}
+
+static void set_ko(PlayoutBoard *pb, int ko) {
+    int old = pb->ko_point;
+    pb->ko_point = ko;
+    if (pb->patterns) {
+        if (old > 0) pat_refresh(pb, old);
+        if (ko > 0) pat_refresh(pb, ko);
+    }
+}
+
+void pb_play(PlayoutBoard *pb, int p) {
+    set_ko(pb, -1);
+    pb->hash ^= pb_zobrist_white_to_move;
+    if (p == PB_PASS) {
+        pb->passes++;
+        pb->to_move ^= 1;
+        return;
+    }
+    pb->passes = 0;
+
+    int me = (pb->to_move == 0 ? PB_BLACK : PB_WHITE);
+    int opp = (me == PB_BLACK ? PB_WHITE : PB_BLACK);
+    place_stone(pb, p, me);
+    if (pb->patterns) pat_set_color(pb, p, me);
+
+    Touched t;
+    t.n = 0;
+    t.overflow = 0;
+    int captured = 0, last = -1;
+    const int nb[4] = {p - 1, p + 1, p - pb->stride, p + pb->stride};
+    for (int k = 0; k < 4; k++) {
+        int c = pb->color[nb[k]];
+        if (c == opp && pb->libs[pb->group[nb[k]]] == 0) {
+            captured += remove_stones(pb, pb->group[nb[k]], &t);
+            last = nb[k];
+        } else if (c == opp) {
+            touch(&t, pb->group[nb[k]]);
+        }
+    }
+
+    int head = pb->group[p];
+    touch(&t, head);
+
+    if (pb->patterns) {
+        if (t.overflow) {
+            pat_rebuild(pb);
+        } else {
+            for (int i = 0; i < t.n; i++) {
+                // a touched group may since have been captured or merged
+                int h = t.head[i];
+                if (pb->color[h] != PB_EMPTY && pb->group[h] == h) pat_update_atari(pb, h);
+            }
+        }
+    }
+
+    if (captured == 1 && pb->stones[head] == 1 && pb->libs[head] == 1)
+        set_ko(pb, last);
+
+    pb->caps[pb->to_move] += captured;
+    pb->to_move ^= 1;
+}
+
+int pb_random_move(PlayoutBoard *pb, unsigned *rng) {
+    int n = pb->empty_count;
+    int me = (pb->to_move == 0 ? PB_BLACK : PB_WHITE);
+    if (n > 0) {
+        int i = (int)(pb_rand(rng) % (unsigned)n);
+        for (int k = 0; k < n; k++, i++) {
+            if (i == n) i = 0;
+            int p = pb->empty[i];
+            if (!pb_is_eye(pb, p, me) && pb_is_legal(pb, p)) {
+                pb_play(pb, p);
+                return p;
+            }
+        }
+    }
+    pb_play(pb, PB_PASS);
+    return PB_PASS;
+}
+
+int pb_pattern_move(PlayoutBoard *pb, unsigned *rng) {
+    int tm = pb->to_move;
+    if (pb->weight_sum[tm] > 0) {
+        int p = fen_find(pb, tm, (int32_t)(pb_rand(rng) % (unsigned)pb->weight_sum[tm]));
+        if (pb_is_legal(pb, p)) {
+            pb_play(pb, p);
+            return p;
+        }
+    }
+    return pb_random_move(pb, rng);
+}
+
+int pb_playout(PlayoutBoard *pb, unsigned *rng, double komi) {
+    int max_moves = pb->size * pb->size * 3;
+    if (pb->patterns) {
+        for (int m = 0; m < max_moves && pb->passes < 2; m++)
+            pb_pattern_move(pb, rng);
+    } else {
+        for (int m = 0; m < max_moves && pb->passes < 2; m++)
+            pb_random_move(pb, rng);
+    }
+    return pb_score(pb, komi) > 0 ? 0 : 1;
+}
+
+double pb_score(const PlayoutBoard *pb, double komi) {
+    int score = 0;
+    for (int y = 0; y < pb->size; y++) {
+        for (int x = 0; x < pb->size; x++) {
+            int p = pb_point(pb, x, y);
+            int c = pb->color[p];
+            if (c == PB_EMPTY) {
+                // at the end of a playout empties are single-point eyes
+                int b = 0, w = 0;
+                const int nb[4] = {p - 1, p + 1, p - pb->stride, p + pb->stride};
+                for (int k = 0; k < 4; k++) {
+                    if (pb->color[nb[k]] == PB_BLACK) b++;
+                    else if (pb->color[nb[k]] == PB_WHITE) w++;
+                }
+                if (b && !w) c = PB_BLACK;
+                else if (w && !b) c = PB_WHITE;
+            }
+            if (c == PB_BLACK) score++;
+            else if (c == PB_WHITE) score--;
+        }
+    }
+    return (double)score - komi;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include "server_game.h"
+
+// Fast board for random playouts.
+// Points are indices into a (size+2)^2 grid with an off-board border, so
+// neighbours are p±1 and p±stride without bounds checks. Groups keep
+// pseudo-liberty counts plus sum and sum of squares of liberty points,
+// which is enough to detect atari exactly without walking the group.
+
+#define PB_STRIDE_MAX (BOARD_MAX_SIZE + 2)
+#define PB_CELLS (PB_STRIDE_MAX * PB_STRIDE_MAX)
+#define PB_PASS 0 // top-left border point, never a legal move
+#define PB_FEN_SIZE 2048 // power of two >= PB_CELLS
+
+_Static_assert(PB_FEN_SIZE >= PB_CELLS, "PB_FEN_SIZE too small");
+
+enum { PB_EMPTY = 0, PB_BLACK = 1, PB_WHITE = 2, PB_OFF = 3 };
+
+// Arrays are sized for the largest board but only the first stride^2
+// entries are used; pb_copy copies just those, so a 9x9 copy stays small.
+typedef struct
+{
+    int size;
+    int stride;
+    int to_move;                   // 0 black / 1 white
+    int passes;                    // consecutive passes
+    int ko_point;                  // forbidden point or -1
+    int caps[2];                   // stones captured by black / white
+    uint64_t hash;                 // Zobrist hash of stones, size and side to move
+    int empty_count;
+
+    // pattern policy, maintained only after pb_enable_patterns()
+    int patterns;
+    int pat_off[8];                // offset of neighbour PAT_* from a point
+    int fen_size;                  // power of two >= stride^2
+    int32_t weight_sum[2];
+
+    unsigned char color[PB_CELLS]; // PB_*
+    uint16_t group[PB_CELLS];      // group head of a stone
+    uint16_t next[PB_CELLS];       // circular list of stones in a group
+
+    // valid at group heads only
+    uint16_t stones[PB_CELLS];
+    uint16_t libs[PB_CELLS];       // pseudo-liberties
+    int32_t lib_sum[PB_CELLS];
+    int64_t lib_sq[PB_CELLS];
+
+    uint16_t empty[PB_CELLS];      // empty points, unordered
+    uint16_t empty_pos[PB_CELLS];  // index of a point in empty[]
+
+    uint16_t pat[PB_CELLS];        // 3x3 code (server_pattern.h)
+    uint8_t atari[PB_CELLS];       // orthogonal neighbours in atari
+    int32_t weight[2][PB_CELLS];   // playout weight per to_move
+    int32_t fen[2][PB_FEN_SIZE + 1]; // Fenwick trees over weight
+} PlayoutBoard;
+
+// fixed-seed Zobrist keys, identical in every process
+extern uint64_t pb_zobrist[2][PB_CELLS];
+extern uint64_t pb_zobrist_white_to_move;
+extern uint64_t pb_zobrist_size[BOARD_MAX_SIZE + 1];
+
+static inline unsigned pb_rand(unsigned *s) {
+    unsigned x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+void pb_init(PlayoutBoard *pb, int size);
+void pb_from_game(PlayoutBoard *pb, const Game *g);
+
+// copy the used part of src (use instead of struct assignment)
+void pb_copy(PlayoutBoard *dst, const PlayoutBoard *src);
+
+static inline int pb_point(const PlayoutBoard *pb, int x, int y) {
+    return (y + 1) * pb->stride + (x + 1);
+}
+
+static inline int pb_game_idx(const PlayoutBoard *pb, int p) {
+    return (p / pb->stride - 1) * pb->size + (p % pb->stride - 1);
+}
+
+// legality for pb->to_move (suicide and simple ko)
+int pb_is_legal(const PlayoutBoard *pb, int p);
+
+// p is an eye of stone colour `me` (PB_BLACK / PB_WHITE)
+int pb_is_eye(const PlayoutBoard *pb, int p, int me);
+
+// p must be legal or PB_PASS
+void pb_play(PlayoutBoard *pb, int p);
+
+// play a uniformly random legal non-eye-filling move; returns it or PB_PASS
+int pb_random_move(PlayoutBoard *pb, unsigned *rng);
+
+// switch pb to the pattern-weighted policy (codes, atari bits, samplers)
+void pb_enable_patterns(PlayoutBoard *pb);
+
+// play a move sampled by pattern weight; returns it or PB_PASS
+int pb_pattern_move(PlayoutBoard *pb, unsigned *rng);
+
+// play until two passes with the board's policy; returns the winner (0 black / 1 white)
+int pb_playout(PlayoutBoard *pb, unsigned *rng, double komi);
+
+// area score, black minus white minus komi
+double pb_score(const PlayoutBoard *pb, double komi);
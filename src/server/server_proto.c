@@ -9,17 +9,7 @@
 int safe_send(Client clients[], int fd, const char *msg) {
     if (fd < 0) return -1;
     if (send_str(fd, msg) < 0) {
-        remove_games_of_client(clients, fd, "DISCONNECT");
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients[i].fd == fd) {
-                close(clients[i].fd);
-                clients[i].fd = -1;
-                clients[i].len = 0;
-                clients[i].nick[0] = '\0';
-                clients[i].subscribed = false;
-                break;
-            }
-        }
+        close_client_later(clients, fd, "DISCONNECT");
         return -1;
     }
     return 0;
@@ -51,15 +41,18 @@ void send_board(Game *g) {
     if (k + 1 < (int)sizeof(msg)) msg[k++] = '\n';
     msg[k] = '\0';
 
-    send_str(g->host_fd, msg);
-    if (g->guest_fd != -1) send_str(g->guest_fd, msg);
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+
+    send_str(host, msg);
+    if (guest != -1) send_str(guest, msg);
 }
 
 void send_captures(Game *g) {
     char msg[128];
     snprintf(msg, sizeof(msg), "CAPTURES %d %d %d\n", g->id, g->cap_black, g->cap_white);
-    send_str(g->host_fd, msg);
-    if (g->guest_fd != -1) send_str(g->guest_fd, msg);
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+    send_str(host, msg);
+    if (guest != -1) send_str(guest, msg);
 }
 
 void send_board_safe(Client clients[], Game *g) {
@@ -79,13 +72,16 @@ void send_board_safe(Client clients[], Game *g) {
     if (k + 1 < (int)sizeof(msg)) msg[k++] = '\n';
     msg[k] = '\0';
 
-    safe_send(clients, g->host_fd, msg);
-    if (g->guest_fd != -1) safe_send(clients, g->guest_fd, msg);
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+
+    safe_send(clients, host, msg);
+    if (guest != -1) safe_send(clients, guest, msg);
 }
 
 void send_captures_safe(Client clients[], Game *g) {
     char msg[128];
     snprintf(msg, sizeof(msg), "CAPTURES %d %d %d\n", g->id, g->cap_black, g->cap_white);
-    safe_send(clients, g->host_fd, msg);
-    if (g->guest_fd != -1) safe_send(clients, g->guest_fd, msg);
+    int host = game_host_fd(g), guest = game_guest_fd(g);
+    safe_send(clients, host, msg);
+    if (guest != -1) safe_send(clients, guest, msg);
 }
@@ -11,6 +11,12 @@ void send_captures(Game *g);
 // broadcast helper 
 void broadcast_subscribed(Client clients[], const char *msg);
 
+// server.c: Unix time in ms from server_io (virtual under tools/sim)
+int64_t wall_ms(void);
+
+// server.c: close fd's client at the end of the loop pass
+void close_client_later(Client clients[], int fd, const char *reason);
+
 // handle disconnect-on-send
 int safe_send(Client clients[], int fd, const char *msg);
 void send_board_safe(Client clients[], Game *g);
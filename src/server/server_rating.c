@@ -0,0 +1,321 @@
+// server_rating.c
+// Glicko-2 as in Glickman, "Example of the Glicko-2 system", with one game
+// per rating period. The table is written by the archive writer thread
+// (or by rating_open while catching up) and read by the loop for RATING;
+// a mutex held for one lookup or one game guards it, including the remap
+// when it grows.
+
+#include "server_rating.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SCALE 173.7178        // Glicko-2 internal scale: mu = (r - 1500) / SCALE
+#define PI 3.14159265358979323846
+#define VOL_EPSILON 1e-6
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int tfd = -1;
+static RatingHeader *hdr;
+static RatingEntry *slots;
+static int active;
+
+static size_t table_bytes(uint32_t cap) {
+    return sizeof(RatingHeader) + (size_t)cap * sizeof(RatingEntry);
+}
+
+// FNV-1a, never 0
+static uint64_t nick_hash(const char *s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 0x100000001b3ull;
+    return h ? h : 1;
+}
+
+// ---- Glicko-2 ----
+
+static double g_phi(double phi) {
+    return 1.0 / sqrt(1.0 + 3.0 * phi * phi / (PI * PI));
+}
+
+// the function whose root is log(new volatility^2)
+static double vol_f(double x, double a, double d2, double p2, double v, double tau) {
+    double ex = exp(x), den = p2 + v + ex;
+    return ex * (d2 - p2 - v - ex) / (2.0 * den * den) - (x - a) / (tau * tau);
+}
+
+// new volatility by the Illinois method (step 5 of the paper)
+static double new_vol(double phi, double v, double delta, double vol, double tau) {
+    double a = log(vol * vol);
+    double d2 = delta * delta, p2 = phi * phi;
+#define F(x) vol_f((x), a, d2, p2, v, tau)
+    double A = a, B;
+    if (d2 > p2 + v) {
+        B = log(d2 - p2 - v);
+    } else {
+        int k = 1;
+        while (F(a - k * tau) < 0 && k < 100) k++;
+        B = a - k * tau;
+    }
+    double fA = F(A), fB = F(B);
+    for (int it = 0; fabs(B - A) > VOL_EPSILON && it < 100; it++) {
+        double C = A + (A - B) * fA / (fB - fA);
+        double fC = F(C);
+        if (fC * fB <= 0) {
+            A = B;
+            fA = fB;
+        } else {
+            fA /= 2;
+        }
+        B = C;
+        fB = fC;
+    }
+#undef F
+    return exp(A / 2);
+}
+
+// RD on the internal scale at time t, grown by the idle periods since e->last
+static double phi_at(const RatingEntry *e, int64_t t) {
+    double phi = e->rd / SCALE;
+    if (e->games == 0 || t <= e->last) return phi;
+    double n = (double)(t - e->last) / hdr->params.period;
+    phi = sqrt(phi * phi + n * e->vol * e->vol);
+    return phi < RATING_INITIAL_RD / SCALE ? phi : RATING_INITIAL_RD / SCALE;
+}
+
+// one rating period for e: a single game scoring s against (mu_o, phi_o)
+static void update(RatingEntry *e, double mu, double phi, double mu_o, double phi_o, double s) {
+    double g = g_phi(phi_o);
+    double E = 1.0 / (1.0 + exp(-g * (mu - mu_o)));
+    double v = 1.0 / (g * g * E * (1.0 - E));
+    double delta = v * g * (s - E);
+    double vol = new_vol(phi, v, delta, e->vol, hdr->params.tau);
+    double pre = sqrt(phi * phi + vol * vol);
+    double phi_new = 1.0 / sqrt(1.0 / (pre * pre) + 1.0 / v);
+    e->rating = SCALE * (mu + phi_new * phi_new * g * (s - E)) + RATING_INITIAL;
+    e->rd = SCALE * phi_new;
+    e->vol = vol;
+}
+
+// ---- table (lock held) ----
+
+static RatingEntry *slot_find(uint64_t h) {
+    uint32_t mask = hdr->capacity - 1;
+    for (uint32_t i = (uint32_t)h & mask;; i = (i + 1) & mask) {
+        if (slots[i].hash == h) return &slots[i];
+        if (slots[i].hash == 0) return NULL;
+    }
+}
+
+static void slot_init(RatingEntry *e, uint64_t h, const char *nick) {
+    memset(e, 0, sizeof(*e));
+    e->hash = h;
+    snprintf(e->nick, sizeof(e->nick), "%s", nick);
+    e->rating = RATING_INITIAL;
+    e->rd = RATING_INITIAL_RD;
+    e->vol = RATING_INITIAL_VOL;
+}
+
+static int map_table(uint32_t cap) {
+    void *p = mmap(NULL, table_bytes(cap), PROT_READ | PROT_WRITE, MAP_SHARED, tfd, 0);
+    if (p == MAP_FAILED) {
+        perror("ratings mmap");
+        return -1;
+    }
+    hdr = p;
+    slots = (RatingEntry *)(hdr + 1);
+    return 0;
+}
+
+// double the table and rehash every entry into it
+static int grow(void) {
+    uint32_t cap = hdr->capacity;
+    RatingEntry *old = malloc((size_t)cap * sizeof(*old));
+    if (!old) return -1;
+    memcpy(old, slots, (size_t)cap * sizeof(*old));
+    RatingHeader h = *hdr;
+    munmap(hdr, table_bytes(cap));
+    if (ftruncate(tfd, (off_t)table_bytes(cap * 2)) < 0 || map_table(cap * 2) < 0) {
+        perror("ratings grow");
+        if (map_table(cap) < 0) active = 0;
+        free(old);
+        return -1;
+    }
+    memset(slots, 0, (size_t)cap * sizeof(*old));
+    *hdr = h;
+    hdr->capacity = cap * 2;
+    for (uint32_t i = 0; i < cap; i++) {
+        if (!old[i].hash) continue;
+        uint32_t j = (uint32_t)old[i].hash & (hdr->capacity - 1);
+        while (slots[j].hash) j = (j + 1) & (hdr->capacity - 1);
+        slots[j] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+static RatingEntry *slot_get(const char *nick) {
+    uint64_t h = nick_hash(nick);
+    RatingEntry *e = slot_find(h);
+    if (e) return e;
+    if ((uint64_t)(hdr->count + 1) * 4 > (uint64_t)hdr->capacity * 3 && grow() < 0) return NULL;
+    uint32_t i = (uint32_t)h & (hdr->capacity - 1);
+    while (slots[i].hash) i = (i + 1) & (hdr->capacity - 1);
+    slot_init(&slots[i], h, nick);
+    hdr->count++;
+    return &slots[i];
+}
+
+static void rate_locked(const ArchiveGame *ag, ArchivePos pos, uint32_t len) {
+    if (!ag->vs_bot && strcmp(ag->black, ag->white) != 0) {
+        RatingEntry *b = slot_get(ag->black);
+        RatingEntry *w = b ? slot_get(ag->white) : NULL;
+        if (w) {
+            b = slot_find(nick_hash(ag->black));    // a grow moves entries
+            double mb = (b->rating - RATING_INITIAL) / SCALE, pb = phi_at(b, ag->end_time);
+            double mw = (w->rating - RATING_INITIAL) / SCALE, pw = phi_at(w, ag->end_time);
+            double s = ag->winner == 0 ? 1.0 : 0.0;
+            update(b, mb, pb, mw, pw, s);
+            update(w, mw, pw, mb, pb, 1.0 - s);
+            b->games++;
+            w->games++;
+            if (ag->winner == 0) b->wins++;
+            else w->wins++;
+            if (ag->end_time > b->last) b->last = ag->end_time;
+            if (ag->end_time > w->last) w->last = ag->end_time;
+            hdr->games++;
+        }
+    }
+    hdr->through_segment = pos.segment;
+    hdr->through_offset = pos.offset + len;
+}
+
+void rating_add(const ArchiveGame *ag, ArchivePos pos, uint32_t len) {
+    pthread_mutex_lock(&lock);
+    if (hdr) rate_locked(ag, pos, len);
+    pthread_mutex_unlock(&lock);
+}
+
+static void rate_visit(const ArchiveGame *ag, ArchivePos pos, uint32_t len, void *arg) {
+    (void)arg;
+    rating_add(ag, pos, len);
+}
+
+// ---- open / close ----
+
+static void unmap_locked(void) {
+    if (hdr) {
+        msync(hdr, table_bytes(hdr->capacity), MS_SYNC);
+        munmap(hdr, table_bytes(hdr->capacity));
+    }
+    if (tfd >= 0) close(tfd);
+    hdr = NULL;
+    slots = NULL;
+    tfd = -1;
+}
+
+// start an empty table in the open file tfd
+static int init_table(const RatingParams *params) {
+    if (ftruncate(tfd, 0) < 0 || ftruncate(tfd, (off_t)table_bytes(RATING_MIN_CAPACITY)) < 0) {
+        perror("ratings truncate");
+        return -1;
+    }
+    if (map_table(RATING_MIN_CAPACITY) < 0) return -1;
+    memcpy(hdr->magic, RATING_MAGIC, sizeof(hdr->magic));
+    hdr->version = RATING_VERSION;
+    hdr->capacity = RATING_MIN_CAPACITY;
+    hdr->params = *params;
+    return 0;
+}
+
+int rating_create(const char *path, const RatingParams *params) {
+    pthread_mutex_lock(&lock);
+    unmap_locked();
+    tfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    int rc = tfd < 0 ? -1 : init_table(params);
+    if (tfd < 0) perror(path);
+    if (rc < 0) unmap_locked();
+    pthread_mutex_unlock(&lock);
+    return rc;
+}
+
+int rating_open(const char *dir) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/ratings.tbl", dir);
+    tfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+    if (tfd < 0 || fstat(tfd, &st) < 0) {
+        perror(path);
+        return -1;
+    }
+
+    RatingHeader h;
+    int valid = st.st_size >= (off_t)sizeof(h) && pread(tfd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+                memcmp(h.magic, RATING_MAGIC, sizeof(h.magic)) == 0 && h.version == RATING_VERSION &&
+                h.capacity >= RATING_MIN_CAPACITY && (h.capacity & (h.capacity - 1)) == 0 &&
+                h.count <= h.capacity && st.st_size == (off_t)table_bytes(h.capacity) &&
+                h.params.tau > 0 && h.params.period > 0;
+    if (!valid) {
+        if (st.st_size > 0) fprintf(stderr, "%s: not a rating table, rating the archive again\n", path);
+        RatingParams p = {RATING_DEFAULT_TAU, RATING_DEFAULT_PERIOD};
+        if (init_table(&p) < 0) return -1;
+    } else if (map_table(h.capacity) < 0) {
+        return -1;
+    }
+
+    ArchivePos from = {hdr->through_segment, hdr->through_offset};
+    uint64_t before = hdr->games;
+    if (archive_scan(dir, from, rate_visit, NULL) < 0) {
+        perror(dir);
+        return -1;
+    }
+    if (hdr->games > before) fprintf(stderr, "ratings: rated %llu archived games\n",
+                                     (unsigned long long)(hdr->games - before));
+
+    if (archive_add_indexer(rate_visit, NULL) < 0) return -1;
+    active = 1;
+    return 0;
+}
+
+int rating_enabled(void) {
+    return active;
+}
+
+void rating_close(void) {
+    pthread_mutex_lock(&lock);
+    unmap_locked();
+    active = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+int rating_get(const char *nick, RatingEntry *out) {
+    pthread_mutex_lock(&lock);
+    RatingEntry *e = hdr ? slot_find(nick_hash(nick)) : NULL;
+    if (e) *out = *e;
+    else slot_init(out, nick_hash(nick), nick);
+    pthread_mutex_unlock(&lock);
+    return e != NULL;
+}
+
+void rating_params(RatingParams *out) {
+    pthread_mutex_lock(&lock);
+    if (hdr) {
+        *out = hdr->params;
+    } else {
+        out->tau = RATING_DEFAULT_TAU;
+        out->period = RATING_DEFAULT_PERIOD;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+size_t rating_bytes(void) {
+    pthread_mutex_lock(&lock);
+    size_t n = hdr ? table_bytes(hdr->capacity) : 0;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
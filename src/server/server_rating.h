@@ -0,0 +1,84 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "server_archive.h"
+
+// Glicko-2 player ratings keyed by nick, derived from the game archive.
+// The table is <archive dir>/ratings.tbl: a header followed by an
+// open-addressed array of entries (hash of the nick, linear probing),
+// mapped with mmap so a lookup touches one or two cache lines. The archive
+// writer thread rates each game once its record is on disk and the header
+// remembers the archive position rated up to, so on open only the games
+// archived after it are replayed. Each game is its own rating period; RD
+// grows with the time since a player's previous game. Games against the
+// bot are not rated. Multi-byte fields are in host order.
+// After a power loss the table may lag its header; rebuild it with
+// tools/rating_rebuild, which is also how changed parameters take effect.
+
+#define RATING_MAGIC "GORATE1"
+#define RATING_VERSION 1
+#define RATING_INITIAL 1500.0
+#define RATING_INITIAL_RD 350.0
+#define RATING_INITIAL_VOL 0.06
+#define RATING_DEFAULT_TAU 0.5
+#define RATING_DEFAULT_PERIOD (7 * 24 * 3600.0)   // seconds for RD to grow by one volatility step
+#define RATING_MIN_CAPACITY 1024
+
+typedef struct
+{
+    double tau;               // volatility constraint (0.3 .. 1.2)
+    double period;            // seconds per idle rating period
+} RatingParams;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;        // entries, a power of two
+    uint32_t count;           // players
+    uint32_t through_segment; // archive position after the last rated game
+    uint32_t through_offset;
+    uint32_t reserved;
+    uint64_t games;           // games rated
+    RatingParams params;
+} RatingHeader;
+
+typedef struct
+{
+    uint64_t hash;            // 0 = empty slot
+    char nick[NICK_SIZE];
+    double rating;
+    double rd;
+    double vol;
+    int64_t last;             // end time of the player's newest rated game
+    uint32_t games;
+    uint32_t wins;
+} RatingEntry;
+
+_Static_assert(sizeof(RatingHeader) == 56, "RatingHeader layout");
+_Static_assert(sizeof(RatingEntry) == 80, "RatingEntry layout");
+
+// map <dir>/ratings.tbl (created with default parameters if missing), rate
+// the archived games it has not seen and hook into the archive writer;
+// call after archive_open
+int rating_open(const char *dir);
+
+int rating_enabled(void);
+
+// start an empty table at path with params, replacing any open one (for
+// offline rebuilds; games are added with rating_add)
+int rating_create(const char *path, const RatingParams *params);
+
+// rate one finished game and advance the table to the record's end
+void rating_add(const ArchiveGame *ag, ArchivePos pos, uint32_t len);
+
+// flush the table to disk and unmap it
+void rating_close(void);
+
+// nick's entry; 1 found, 0 unrated (out gets the initial values)
+int rating_get(const char *nick, RatingEntry *out);
+
+void rating_params(RatingParams *out);
+
+// bytes of the mapped table, 0 when closed
+size_t rating_bytes(void);
@@ -0,0 +1,70 @@
+#include "server_ring.h"
+#include <stdlib.h>
+
+int ring_init(Ring *r, size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) n *= 2;
+    r->cells = malloc(n * sizeof(RingCell));
+    if (!r->cells) return -1;
+    for (size_t i = 0; i < n; i++) {
+        atomic_init(&r->cells[i].seq, i);
+        r->cells[i].data = NULL;
+    }
+    r->mask = n - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return 0;
+}
+
+void ring_free(Ring *r) {
+    free(r->cells);
+    r->cells = NULL;
+}
+
+int ring_push(Ring *r, void *p) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (;;) {
+        RingCell *c = &r->cells[pos & r->mask];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        long diff = (long)seq - (long)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                c->data = p;
+                atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+void *ring_pop(Ring *r) {
+    size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (;;) {
+        RingCell *c = &r->cells[pos & r->mask];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        long diff = (long)seq - (long)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                void *p = c->data;
+                atomic_store_explicit(&c->seq, pos + r->mask + 1, memory_order_release);
+                return p;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+size_t ring_count(Ring *r) {
+    size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    return h >= t ? h - t : 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Bounded lock-free MPMC queue of pointers (Vyukov's sequence-numbered ring).
+// Any number of threads may push and pop; neither side ever blocks.
+
+typedef struct
+{
+    _Atomic size_t seq;
+    void *data;
+} RingCell;
+
+typedef struct
+{
+    RingCell *cells;
+    size_t mask;
+    _Alignas(64) _Atomic size_t head;   // next slot to push
+    _Alignas(64) _Atomic size_t tail;   // next slot to pop
+} Ring;
+
+// capacity is rounded up to a power of two; 0 on success
+int ring_init(Ring *r, size_t capacity);
+void ring_free(Ring *r);
+
+// 0 on success, -1 if full
+int ring_push(Ring *r, void *p);
+
+// NULL if empty
+void *ring_pop(Ring *r);
+
+// entries queued right now (racy, for stats and admission)
+size_t ring_count(Ring *r);
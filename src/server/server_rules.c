@@ -0,0 +1,201 @@
+// server_rules.c
+// Go rules on a Game board: captures, suicide and simple ko.
+// No sockets here, so the bot engine and benchmarks can link it alone.
+
+#include "server_game.h"
+#include <stdlib.h>
+
+void game_clear_board(Game *g) {
+    int n = g->size * g->size;
+    for (int i = 0; i < n; i++) {
+        g->board[i] = 0;
+        g->prev_board[i] = 0;
+    }
+    g->to_move = 0; // black to move
+    g->cap_black = 0;
+    g->cap_white = 0;
+    g->consecutive_passes = 0;
+    g->ply = 0;
+}
+
+void game_use_storage(Game *g, unsigned char *storage) {
+    g->board = storage;
+    g->prev_board = storage + g->size * g->size;
+}
+
+void game_copy(Game *dst, const Game *src, unsigned char *storage) {
+    *dst = *src;
+    dst->moves = NULL;   // copies are for searching, not for the record
+    dst->moves_cap = 0;
+    game_use_storage(dst, storage);
+    copy_board(dst, dst->board, src->board);
+    copy_board(dst, dst->prev_board, src->prev_board);
+}
+
+int game_reserve_moves(Game *g, int n) {
+    if (n <= g->moves_cap) return 0;
+    if (n < 64) n = 64;
+    uint16_t *m = realloc(g->moves, (size_t)n * sizeof(*m));
+    if (!m) return -1;
+    g->moves = m;
+    g->moves_cap = n;
+    return 0;
+}
+
+// append to the move list of games that keep one; if it cannot grow the
+// list is dropped rather than left out of step with ply
+static void record_move(Game *g, int code) {
+    if (!g->moves) return;
+    if (g->ply >= g->moves_cap && game_reserve_moves(g, g->ply * 2) < 0) {
+        free(g->moves);
+        g->moves = NULL;
+        g->moves_cap = 0;
+        return;
+    }
+    g->moves[g->ply] = (uint16_t)code;
+}
+
+int game_idx(Game *g, int x, int y) {
+    return y * g->size + x;
+}
+
+int in_bounds(Game *g, int x, int y) {
+    return x >= 0 && y >= 0 && x < g->size && y < g->size;
+}
+
+void copy_board(Game *g, unsigned char *dst, const unsigned char *src) {
+    int n = g->size * g->size;
+    for (int i = 0; i < n; i++) dst[i] = src[i];
+}
+
+int boards_equal(Game *g, const unsigned char *a, const unsigned char *b) {
+    int n = g->size * g->size;
+    for (int i = 0; i < n; i++) if (a[i] != b[i]) return 0;
+    return 1;
+}
+
+// BFS group + liberties
+int collect_group(Game *g, int sx, int sy, unsigned char color,
+                  int *stones, int max_stones, int *out_liberties) {
+    int n = g->size * g->size;
+    unsigned char seen[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    for (int i = 0; i < n; i++) seen[i] = 0;
+
+    int qx[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    int qy[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    int qh = 0, qt = 0;
+
+    int start = game_idx(g, sx, sy);
+    if (g->board[start] != color) { *out_liberties = 0; return 0; }
+
+    qx[qt] = sx; qy[qt] = sy; qt++;
+    seen[start] = 1;
+
+    int count = 0;
+    int liberties = 0;
+
+    while (qh < qt) {
+        int x = qx[qh], y = qy[qh]; qh++;
+        int idx = game_idx(g, x, y);
+
+        if (count < max_stones) stones[count] = idx;
+        count++;
+
+        const int dx[4] = {1,-1,0,0};
+        const int dy[4] = {0,0,1,-1};
+
+        for (int k = 0; k < 4; k++) {
+            int nx = x + dx[k], ny = y + dy[k];
+            if (!in_bounds(g, nx, ny)) continue;
+            int nidx = game_idx(g, nx, ny);
+
+            if (g->board[nidx] == 0) {
+                if (seen[nidx] != 3) { seen[nidx] = 3; liberties++; }
+            } else if (g->board[nidx] == color) {
+                if (!seen[nidx]) {
+                    seen[nidx] = 1;
+                    qx[qt] = nx; qy[qt] = ny; qt++;
+                }
+            }
+        }
+    }
+
+    *out_liberties = liberties;
+    return count;
+}
+
+int remove_group(Game *g, const int *stones, int count) {
+    int removed = 0;
+    int n = g->size * g->size;
+    for (int i = 0; i < count; i++) {
+        int idx = stones[i];
+        if (idx >= 0 && idx < n && g->board[idx] != 0) {
+            g->board[idx] = 0;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+int game_play_move(Game *g, int color, int x, int y) {
+    if (!in_bounds(g, x, y)) return MOVE_OUT_OF_BOUNDS;
+
+    int idxb = game_idx(g, x, y);
+    if (g->board[idxb] != 0) return MOVE_OCCUPIED;
+
+    unsigned char before[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    copy_board(g, before, g->board);
+
+    unsigned char me = (color == 0 ? 1 : 2);
+    unsigned char opp = (color == 0 ? 2 : 1);
+    g->board[idxb] = me;
+
+    const int dx[4] = {1,-1,0,0};
+    const int dy[4] = {0,0,1,-1};
+
+    int stones[BOARD_MAX_SIZE * BOARD_MAX_SIZE];
+    int captured = 0;
+    for (int k = 0; k < 4; k++) {
+        int nx = x + dx[k], ny = y + dy[k];
+        if (!in_bounds(g, nx, ny)) continue;
+        int nidx = game_idx(g, nx, ny);
+        if (g->board[nidx] == opp) {
+            int libs = 0;
+            int cnt = collect_group(g, nx, ny, opp, stones,
+                                    (int)(BOARD_MAX_SIZE*BOARD_MAX_SIZE), &libs);
+            if (cnt > 0 && libs == 0) captured += remove_group(g, stones, cnt);
+        }
+    }
+
+    int mylibs = 0;
+    int mycnt = collect_group(g, x, y, me, stones,
+                              (int)(BOARD_MAX_SIZE*BOARD_MAX_SIZE), &mylibs);
+    if (mycnt > 0 && mylibs == 0) {
+        copy_board(g, g->board, before);
+        return MOVE_SUICIDE;
+    }
+
+    if (boards_equal(g, g->board, g->prev_board)) {
+        copy_board(g, g->board, before);
+        return MOVE_KO;
+    }
+
+    copy_board(g, g->prev_board, before);
+
+    if (color == 0) g->cap_black += captured;
+    else            g->cap_white += captured;
+
+    g->to_move = (color == 0 ? 1 : 0);
+    g->consecutive_passes = 0;
+    record_move(g, idxb + 1);
+    g->ply++;
+    return MOVE_OK;
+}
+
+void game_pass(Game *g) {
+    copy_board(g, g->prev_board, g->board);
+    g->to_move = (g->to_move == 0 ? 1 : 0);
+    g->consecutive_passes++;
+    record_move(g, 0);
+    g->ply++;
+}
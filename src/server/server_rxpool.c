@@ -0,0 +1,62 @@
+// server_rxpool.c
+// One free list per size class; a free buffer stores the next pointer in
+// its first bytes, like the board pool.
+
+#include "server_rxpool.h"
+#include "server_game.h"
+#include <stdlib.h>
+
+#define RXBUF_CLASSES 8   // 64 .. 8192, enough for any BUF_SIZE up to that
+
+_Static_assert(BUF_SIZE <= RXBUF_MIN_SIZE << (RXBUF_CLASSES - 1), "BUF_SIZE needs more rx classes");
+
+typedef struct FreeBuf
+{
+    struct FreeBuf *next;
+} FreeBuf;
+
+static FreeBuf *free_lists[RXBUF_CLASSES];
+static size_t slab_bytes;
+
+static int class_of(size_t n) {
+    int c = 0;
+    while ((size_t)RXBUF_MIN_SIZE << c < n) c++;
+    return c;
+}
+
+static int grow(int c) {
+    size_t bs = (size_t)RXBUF_MIN_SIZE << c;
+    size_t n = bs < RXBUF_SLAB_BYTES ? RXBUF_SLAB_BYTES / bs : 1;
+    char *slab = aligned_alloc(64, bs * n);
+    if (!slab) return -1;
+    slab_bytes += bs * n;
+    for (size_t i = n; i-- > 0;) {
+        FreeBuf *b = (FreeBuf *)(slab + i * bs);
+        b->next = free_lists[c];
+        free_lists[c] = b;
+    }
+    return 0;
+}
+
+char *rxbuf_alloc(size_t n, size_t *cap) {
+    int c = class_of(n);
+    if (c >= RXBUF_CLASSES) return NULL;
+    if (!free_lists[c] && grow(c) < 0) return NULL;
+
+    FreeBuf *b = free_lists[c];
+    free_lists[c] = b->next;
+    *cap = (size_t)RXBUF_MIN_SIZE << c;
+    return (char *)b;
+}
+
+void rxbuf_free(char *buf, size_t cap) {
+    if (!buf) return;
+    FreeBuf *b = (FreeBuf *)buf;
+    int c = class_of(cap);
+    b->next = free_lists[c];
+    free_lists[c] = b;
+}
+
+size_t rxbuf_pool_bytes(void) {
+    return slab_bytes;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+
+// Receive buffers for partial lines. A connection holds one only while a
+// line it sent is incomplete; whole lines are parsed straight out of the
+// loop's shared receive area, so an idle or well-behaved client holds none.
+// Buffers come in size classes (RXBUF_MIN_SIZE doubling up to BUF_SIZE)
+// carved from slabs that are never returned to the system; freed ones go
+// on a free list for their class. Used from the select() loop thread only.
+
+#define RXBUF_MIN_SIZE 64
+#define RXBUF_SLAB_BYTES 65536
+
+// buffer of at least n bytes (n <= BUF_SIZE), its size in *cap; NULL if out of memory
+char *rxbuf_alloc(size_t n, size_t *cap);
+void rxbuf_free(char *buf, size_t cap);
+
+// bytes held in slabs, in use or free
+size_t rxbuf_pool_bytes(void);
@@ -0,0 +1,148 @@
+// server_slowlog.c
+
+#include "server_slowlog.h"
+#include "server_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+enum { SLOW_CMD, SLOW_LOOP };
+
+typedef struct
+{
+    int kind;
+    int fd;
+    int lines;
+    uint64_t ns;
+    struct timespec at;        // wall clock, read only for slow events
+    char verb[16];
+    char nick[32];
+} SlowEvent;
+
+static SlowEvent pool[SLOWLOG_EVENTS];
+static Ring free_ring, full_ring;
+static int wake_efd = -1;
+static FILE *log_file;
+static uint64_t threshold_ns = UINT64_MAX;
+static _Atomic uint64_t logged, dropped;
+
+static void write_event(const SlowEvent *e) {
+    struct tm tm;
+    char when[32];
+    localtime_r(&e->at.tv_sec, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    double ms = (double)e->ns / 1e6;
+    if (e->kind == SLOW_CMD)
+        fprintf(log_file, "%s.%03ld CMD %s fd=%d nick=%s %.3f ms\n", when, e->at.tv_nsec / 1000000, e->verb,
+                e->fd, e->nick[0] ? e->nick : "-", ms);
+    else
+        fprintf(log_file, "%s.%03ld LOOP %.3f ms lines=%d\n", when, e->at.tv_nsec / 1000000, ms, e->lines);
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    uint64_t reported = 0;
+    for (;;) {
+        uint64_t n;
+        if (read(wake_efd, &n, sizeof(n)) < 0) continue;
+        SlowEvent *e;
+        while ((e = ring_pop(&full_ring)) != NULL) {
+            write_event(e);
+            ring_push(&free_ring, e);
+            atomic_fetch_add_explicit(&logged, 1, memory_order_relaxed);
+        }
+        uint64_t d = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if (d != reported) {
+            fprintf(log_file, "DROPPED %llu events (total %llu)\n", (unsigned long long)(d - reported),
+                    (unsigned long long)d);
+            reported = d;
+        }
+        fflush(log_file);
+    }
+    return NULL;
+}
+
+int slowlog_open(const char *path, double threshold_ms) {
+    log_file = fopen(path, "a");
+    if (!log_file) {
+        perror("slowlog open");
+        return -1;
+    }
+    if (ring_init(&free_ring, SLOWLOG_EVENTS) < 0 || ring_init(&full_ring, SLOWLOG_EVENTS) < 0) {
+        perror("slowlog ring");
+        return -1;
+    }
+    for (int i = 0; i < SLOWLOG_EVENTS; i++) ring_push(&free_ring, &pool[i]);
+    wake_efd = eventfd(0, EFD_CLOEXEC);
+    if (wake_efd < 0) {
+        perror("slowlog eventfd");
+        return -1;
+    }
+    pthread_t th;
+    if (pthread_create(&th, NULL, drain_main, NULL) != 0) {
+        perror("slowlog thread");
+        return -1;
+    }
+    pthread_detach(th);
+    threshold_ns = threshold_ms <= 0 ? 0 : (uint64_t)(threshold_ms * 1e6);
+    return 0;
+}
+
+uint64_t slowlog_threshold_ns(void) {
+    return threshold_ns;
+}
+
+static SlowEvent *take(void) {
+    SlowEvent *e = ring_pop(&free_ring);
+    if (!e) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    clock_gettime(CLOCK_REALTIME, &e->at);
+    return e;
+}
+
+static void give(SlowEvent *e) {
+    ring_push(&full_ring, e);
+    uint64_t one = 1;
+    // a counting eventfd never blocks the writer short of 2^64 wakeups
+    while (write(wake_efd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+void slowlog_command(const char *line, int fd, const char *nick, uint64_t ns) {
+    SlowEvent *e = take();
+    if (!e) return;
+    e->kind = SLOW_CMD;
+    e->fd = fd;
+    e->lines = 1;
+    e->ns = ns;
+    size_t n = 0;
+    while (n < sizeof(e->verb) - 1 && line[n] && line[n] != ' ' && line[n] != '\r' && line[n] != '\n') {
+        e->verb[n] = line[n];
+        n++;
+    }
+    e->verb[n] = '\0';
+    snprintf(e->nick, sizeof(e->nick), "%s", nick);
+    give(e);
+}
+
+void slowlog_loop(uint64_t ns, int lines) {
+    SlowEvent *e = take();
+    if (!e) return;
+    e->kind = SLOW_LOOP;
+    e->fd = -1;
+    e->lines = lines;
+    e->ns = ns;
+    e->verb[0] = e->nick[0] = '\0';
+    give(e);
+}
+
+void slowlog_stats(SlowlogStats *out) {
+    out->logged = atomic_load_explicit(&logged, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&dropped, memory_order_relaxed);
+}
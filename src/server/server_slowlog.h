@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+
+// Slow-command and loop-lag log. The loop times every command line and
+// every iteration anyway (server_metrics); anything at or over the
+// threshold is copied into an event taken from a preallocated pool and
+// pushed on a lock-free ring. A background thread drains the ring to the
+// log file, so the loop never formats, writes or waits on the disk. When
+// the pool runs dry (the drain thread is behind) events are dropped and
+// counted instead.
+
+#define SLOWLOG_EVENTS 1024         // pool and ring size
+#define SLOWLOG_DEFAULT_MS 20
+
+typedef struct
+{
+    uint64_t logged;
+    uint64_t dropped;
+} SlowlogStats;
+
+// append to path from a drain thread; 0 on success
+int slowlog_open(const char *path, double threshold_ms);
+
+// threshold in ns, UINT64_MAX when the log is off (one compare per line)
+uint64_t slowlog_threshold_ns(void);
+
+// a command line that took ns; line is the raw protocol line
+void slowlog_command(const char *line, int fd, const char *nick, uint64_t ns);
+
+// a loop iteration that took ns over lines command lines
+void slowlog_loop(uint64_t ns, int lines);
+
+void slowlog_stats(SlowlogStats *out);
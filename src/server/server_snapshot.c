@@ -0,0 +1,298 @@
+// server_snapshot.c
+// The writer streams records through a stack buffer and patches the
+// header last; it runs either inline at startup or in a forked child,
+// where only async-signal-safe calls are allowed, hence no stdio or malloc.
+// The loader maps the file and rebuilds each game with game_restore.
+
+#include "server_snapshot.h"
+#include "server_crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAP_REC_MAX (24 + 3 * 64 + 2 * (BOARD_CELLS_MAX / 4) + 4)
+
+// buffered output to the temp file; crc covers everything after the header
+typedef struct
+{
+    int fd;
+    off_t at;
+    uint32_t crc;
+    size_t len;
+    unsigned char buf[1 << 16];
+} Out;
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static size_t put_str(unsigned char *p, size_t at, const char *s) {
+    size_t n = strlen(s);
+    p[at] = (unsigned char)n;
+    memcpy(p + at + 1, s, n);
+    return at + 1 + n;
+}
+
+static int get_str(const unsigned char *p, size_t n, size_t *at, char *out, size_t outsz) {
+    if (*at >= n) return -1;
+    size_t len = p[*at];
+    if (*at + 1 + len > n || len >= outsz) return -1;
+    memcpy(out, p + *at + 1, len);
+    out[len] = '\0';
+    *at += 1 + len;
+    return 0;
+}
+
+// cells are 0 empty / 1 black / 2 white: four to a byte
+static size_t pack_board(unsigned char *p, size_t at, const unsigned char *b, int cells) {
+    size_t bytes = (size_t)(cells + 3) / 4;
+    memset(p + at, 0, bytes);
+    for (int i = 0; i < cells; i++) p[at + i / 4] |= (unsigned char)((b[i] & 3) << (2 * (i % 4)));
+    return at + bytes;
+}
+
+static void unpack_board(const unsigned char *p, unsigned char *b, int cells) {
+    for (int i = 0; i < cells; i++) b[i] = (p[i / 4] >> (2 * (i % 4))) & 3;
+}
+
+static size_t encode_game(unsigned char *p, const Game *g) {
+    size_t n = 0;
+    put_u32(p, (uint32_t)g->id);
+    n += 4;
+    p[n++] = (unsigned char)g->size;
+    p[n++] = (unsigned char)g->host_color;
+    p[n++] = (unsigned char)g->vs_bot;
+    p[n++] = (unsigned char)g->status;
+    p[n++] = (unsigned char)g->to_move;
+    p[n++] = (unsigned char)g->consecutive_passes;
+    put_u32(p + n, (uint32_t)g->cap_black);
+    put_u32(p + n + 4, (uint32_t)g->cap_white);
+    put_u32(p + n + 8, (uint32_t)g->ply);
+    n += 12;
+    n = put_str(p, n, g->host_nick);
+    n = put_str(p, n, g->guest_nick);
+    n = put_str(p, n, g->game_name);
+    n = pack_board(p, n, g->board, g->size * g->size);
+    n = pack_board(p, n, g->prev_board, g->size * g->size);
+    put_u32(p + n, (uint32_t)(g->moves ? g->ply : 0));
+    return n + 4;
+}
+
+static int write_all(int fd, const unsigned char *p, size_t n, off_t at) {
+    while (n > 0) {
+        ssize_t w = pwrite(fd, p, n, at);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+        at += w;
+    }
+    return 0;
+}
+
+int sync_parent_dir(const char *path) {
+    // trimmed by hand: dirname() is not async-signal-safe
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    size_t n = slash ? (size_t)(slash - path) : 0;
+    if (n >= sizeof(dir)) return -1;
+    if (!slash) dir[n++] = '.';
+    else if (n == 0) dir[n++] = '/';
+    else memcpy(dir, path, n);
+    dir[n] = '\0';
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+static int out_flush(Out *o) {
+    o->crc = crc32_update(o->crc, o->buf, o->len);
+    if (write_all(o->fd, o->buf, o->len, o->at) < 0) return -1;
+    o->at += (off_t)o->len;
+    o->len = 0;
+    return 0;
+}
+
+static int out_room(Out *o, size_t n) {
+    return o->len + n > sizeof(o->buf) ? out_flush(o) : 0;
+}
+
+// fixed part, then the move list (u16 each) in buffer-sized pieces
+static int write_game(Out *o, const Game *g) {
+    if (out_room(o, SNAP_REC_MAX) < 0) return -1;
+    o->len += encode_game(o->buf + o->len, g);
+    int ply = g->moves ? g->ply : 0;
+    for (int i = 0; i < ply; i++) {
+        if (out_room(o, 2) < 0) return -1;
+        o->buf[o->len++] = (unsigned char)g->moves[i];
+        o->buf[o->len++] = (unsigned char)(g->moves[i] >> 8);
+    }
+    return 0;
+}
+
+int snapshot_write(const char *path, uint64_t epoch, uint64_t offset) {
+    char tmp[4096];
+    size_t plen = strlen(path);
+    if (plen + 5 > sizeof(tmp)) return -1;
+    memcpy(tmp, path, plen);
+    memcpy(tmp + plen, ".tmp", 5);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    Out o;
+    o.fd = fd;
+    o.at = SNAP_HEADER;
+    o.crc = 0;
+    o.len = 0;
+    int count = game_total();
+    for (int i = 0; i < count; i++) {
+        if (write_game(&o, game_at(i)) < 0) goto fail;
+    }
+    if (out_flush(&o) < 0) goto fail;
+
+    unsigned char hdr[SNAP_HEADER];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+    put_u32(hdr + 8, SNAP_VERSION);
+    put_u32(hdr + 12, (uint32_t)count);
+    put_u64(hdr + 16, epoch);
+    put_u64(hdr + 24, offset);
+    put_u32(hdr + 32, (uint32_t)game_next_id());
+    put_u32(hdr + 36, o.crc);
+    if (write_all(fd, hdr, sizeof(hdr), 0) < 0 || fsync(fd) < 0) goto fail;
+    close(fd);
+
+    if (rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return sync_parent_dir(path);
+
+fail:
+    close(fd);
+    unlink(tmp);
+    return -1;
+}
+
+pid_t snapshot_fork(const char *path, uint64_t epoch, uint64_t offset) {
+    pid_t pid = fork();
+    if (pid == 0) _exit(snapshot_write(path, epoch, offset) < 0 ? 1 : 0);
+    return pid;
+}
+
+// version 1 records end after the boards, with no move list
+static int decode_game(const unsigned char *p, size_t n, uint32_t version, size_t *used) {
+    if (n < 22) return -1;
+    int id = (int)get_u32(p);
+    int size = p[4], host_color = p[5], vs_bot = p[6], status = p[7];
+    int to_move = p[8], passes = p[9];
+    char host[NICK_SIZE], guest[NICK_SIZE], name[GAME_NAME_SIZE];
+    size_t at = 22;
+    if (get_str(p, n, &at, host, sizeof(host)) < 0 || get_str(p, n, &at, guest, sizeof(guest)) < 0 ||
+        get_str(p, n, &at, name, sizeof(name)) < 0)
+        return -1;
+    if (size < BOARD_MIN_SIZE || size > BOARD_MAX_SIZE) return -1;
+    size_t bytes = (size_t)(size * size + 3) / 4;
+    size_t tail = version >= 2 ? 4 : 0;
+    if (at + 2 * bytes + tail > n) return -1;
+    uint32_t nmoves = tail ? get_u32(p + at + 2 * bytes) : 0;
+    if (nmoves > (n - at - 2 * bytes - tail) / 2) return -1;
+
+    Game *g = game_restore(id, size, host_color & 1, vs_bot != 0, host, name);
+    if (!g) return -1;
+    g->status = status == GAME_RUNNING ? GAME_RUNNING : GAME_OPEN;
+    g->to_move = to_move & 1;
+    g->consecutive_passes = passes;
+    g->cap_black = (int)get_u32(p + 10);
+    g->cap_white = (int)get_u32(p + 14);
+    g->ply = (int)get_u32(p + 18);
+    snprintf(g->guest_nick, sizeof(g->guest_nick), "%s", guest);
+    unpack_board(p + at, g->board, size * size);
+    unpack_board(p + at + bytes, g->prev_board, size * size);
+    at += 2 * bytes + tail;
+    if (nmoves > 0 && game_reserve_moves(g, (int)nmoves) == 0) {
+        for (uint32_t i = 0; i < nmoves; i++) g->moves[i] = (uint16_t)(p[at + 2 * i] | p[at + 2 * i + 1] << 8);
+    } else if (nmoves > 0 || g->ply > 0) {
+        // the history is missing or does not fit: stop recording this game
+        free(g->moves);
+        g->moves = NULL;
+        g->moves_cap = 0;
+    }
+    *used = at + 2 * (size_t)nmoves;
+    return 0;
+}
+
+int snapshot_load(const char *path, SnapInfo *out) {
+    memset(out, 0, sizeof(*out));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return 0;
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < SNAP_HEADER) {
+        fprintf(stderr, "%s: not a snapshot\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("snapshot mmap");
+        return -1;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    int rc = -1;
+    uint32_t version = get_u32(map + 8);
+    if (memcmp(map, SNAP_MAGIC, sizeof(SNAP_MAGIC)) != 0 || version < 1 || version > SNAP_VERSION) {
+        fprintf(stderr, "%s: not a snapshot\n", path);
+        goto out;
+    }
+    if (crc32_update(0, map + SNAP_HEADER, size - SNAP_HEADER) != get_u32(map + 36)) {
+        fprintf(stderr, "%s: checksum mismatch\n", path);
+        goto out;
+    }
+
+    uint32_t count = get_u32(map + 12);
+    size_t off = SNAP_HEADER;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t used;
+        if (decode_game(map + off, size - off, version, &used) < 0) {
+            fprintf(stderr, "%s: bad game record %u\n", path, i);
+            goto out;
+        }
+        off += used;
+    }
+    game_set_next_id((int)get_u32(map + 32));
+    out->epoch = get_u64(map + 16);
+    out->offset = get_u64(map + 24);
+    out->games = count;
+    rc = 1;
+
+out:
+    munmap((void *)map, size);
+    return rc;
+}
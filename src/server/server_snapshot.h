@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include "server_game.h"
+
+// Point-in-time image of the game registry, so a restart replays only the
+// journal written after it. The file names the journal epoch (see
+// server_journal.h) and byte offset it was taken at; every record before
+// that offset is already reflected in it.
+//
+// Header (40 bytes): magic, u32 version, u32 game count, u64 epoch,
+// u64 journal offset, u32 next game id, u32 CRC-32 of the body.
+// Body: one variable-length record per game: fields, boards packed 2 bits
+// a cell, then the move list as u16 entries. Little-endian.
+
+#define SNAP_MAGIC "GOSNAP1"
+#define SNAP_VERSION 2
+#define SNAP_HEADER 40
+
+typedef struct
+{
+    uint64_t epoch;     // 0 = no snapshot
+    uint64_t offset;
+    uint32_t games;
+} SnapInfo;
+
+// write the registry to path (via a temp file, fsync and rename). Uses no
+// heap and no locks, so it is safe in a child forked from a threaded process.
+int snapshot_write(const char *path, uint64_t epoch, uint64_t offset);
+
+// fork a child that runs snapshot_write on its copy-on-write view of the
+// registry and exits 0 on success; returns its pid or -1
+pid_t snapshot_fork(const char *path, uint64_t epoch, uint64_t offset);
+
+// restore games from path into an empty registry; 1 loaded, 0 no file, -1 bad file
+int snapshot_load(const char *path, SnapInfo *out);
+
+// fsync the directory holding path, so a rename in it is durable
+int sync_parent_dir(const char *path);
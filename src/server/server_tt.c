@@ -0,0 +1,87 @@
+// server_tt.c
+// Replacement: a miss takes an empty slot, else evicts the slot with the
+// fewest visits, preferring the deepest on ties.
+
+#include "server_tt.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#define KEY_MASK (~(uint64_t)0xff)
+
+static TTEntry *table;
+static size_t bucket_mask;
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int tt_ensure(size_t mb) {
+    pthread_mutex_lock(&init_lock);
+    if (!table && mb > 0) {
+        size_t buckets = 1;
+        while (buckets * 2 * TT_BUCKET * sizeof(TTEntry) <= mb * 1024 * 1024) buckets *= 2;
+        table = aligned_alloc(64, buckets * TT_BUCKET * sizeof(TTEntry));
+        if (table) {
+            for (size_t i = 0; i < buckets * TT_BUCKET; i++) {
+                atomic_init(&table[i].key, 0);
+                atomic_init(&table[i].visits, 0);
+                atomic_init(&table[i].wins, 0);
+            }
+            bucket_mask = buckets - 1;
+        }
+    }
+    int ok = table != NULL;
+    pthread_mutex_unlock(&init_lock);
+    return ok ? 0 : -1;
+}
+
+static TTEntry *bucket_of(uint64_t hash) {
+    return &table[((hash >> 8) & bucket_mask) * TT_BUCKET];
+}
+
+const TTEntry *tt_probe(uint64_t hash) {
+    if (!table) return NULL;
+    TTEntry *b = bucket_of(hash);
+    for (int i = 0; i < TT_BUCKET; i++) {
+        uint64_t k = atomic_load_explicit(&b[i].key, memory_order_relaxed);
+        if ((k & KEY_MASK) == (hash & KEY_MASK) && k != 0) return &b[i];
+    }
+    return NULL;
+}
+
+void tt_update(uint64_t hash, int depth, int win) {
+    if (!table) return;
+    if (depth > 0xff) depth = 0xff;
+    uint64_t want = (hash & KEY_MASK) | (uint64_t)depth;
+    if (want == 0) return;
+
+    TTEntry *b = bucket_of(hash);
+    TTEntry *victim = NULL;
+    uint32_t victim_visits = UINT32_MAX;
+    int victim_depth = -1;
+
+    for (int i = 0; i < TT_BUCKET; i++) {
+        uint64_t k = atomic_load_explicit(&b[i].key, memory_order_relaxed);
+        if (k != 0 && (k & KEY_MASK) == (hash & KEY_MASK)) {
+            atomic_fetch_add_explicit(&b[i].visits, 1, memory_order_relaxed);
+            if (win) atomic_fetch_add_explicit(&b[i].wins, 1, memory_order_relaxed);
+            return;
+        }
+        uint32_t v = k == 0 ? 0 : atomic_load_explicit(&b[i].visits, memory_order_relaxed);
+        int d = k == 0 ? 0x100 : (int)(k & 0xff);
+        if (v < victim_visits || (v == victim_visits && d > victim_depth)) {
+            victim = &b[i];
+            victim_visits = v;
+            victim_depth = d;
+        }
+    }
+
+    uint64_t old = atomic_load_explicit(&victim->key, memory_order_relaxed);
+    if (!atomic_compare_exchange_strong(&victim->key, &old, want)) return; // lost the race, drop
+    atomic_store_explicit(&victim->visits, 1, memory_order_relaxed);
+    atomic_store_explicit(&victim->wins, win ? 1 : 0, memory_order_relaxed);
+}
+
+size_t tt_bytes(void) {
+    pthread_mutex_lock(&init_lock);   // the loop reads it for STATS while workers may be creating it
+    size_t n = table ? (bucket_mask + 1) * TT_BUCKET * sizeof(TTEntry) : 0;
+    pthread_mutex_unlock(&init_lock);
+    return n;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Shared transposition table for the bot engine.
+// One process-wide table keyed by the PlayoutBoard Zobrist hash, shared by
+// every search thread and kept between moves (and games). Buckets are one
+// cache line of 4 entries; the low byte of the stored key holds the depth
+// the entry was inserted at. Updates are plain atomics: a slot being
+// replaced while another thread adds to it only costs a few stray visits.
+
+#define TT_BUCKET 4
+#define TT_DEFAULT_MB 64
+
+typedef struct
+{
+    _Atomic uint64_t key;     // hash with the low byte replaced by depth, 0 = empty
+    _Atomic uint32_t visits;
+    _Atomic uint32_t wins;    // wins for the player who moved into the position
+} TTEntry;
+
+// allocate the table once with a budget of mb megabytes; later calls are no-ops
+int tt_ensure(size_t mb);
+
+// entry for hash or NULL
+const TTEntry *tt_probe(uint64_t hash);
+
+// add one playout result for hash seen `depth` plies below a search root
+void tt_update(uint64_t hash, int depth, int win);
+
+// bytes allocated for the table (0 if none)
+size_t tt_bytes(void);
@@ -0,0 +1,221 @@
+// admin_dash.c
+// Live server console: PLAYERS, NOTIFICATIONS and GAMES panes (the layout
+// sketched in TODO.md), drawn from the snapshots a server started with
+// --dash FILE publishes. It only maps the file read-only, so attaching,
+// detaching or a stuck terminal never touches the server. When the server
+// restarts it makes a new file; the console notices the old one going
+// stale and attaches to the new one.
+// Keys: u/d scroll players, up/down and PgUp/PgDn scroll games, q quits.
+// --once prints one snapshot as text and exits.
+// Run:   ./admin_dash /dev/shm/go.dash [--once]
+// gcc -O2 admin_dash.c ../server/server_dash.c -I../server -lncurses -o admin_dash
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ncurses.h>
+#include "server_dash.h"
+
+#define STALE_MS 2000
+
+static DashSnapshot snap;   // about 800 KB with every game slot
+
+static const char *state_names[] = {"idle", "hosting", "playing", "seeking"};
+
+static uint64_t wall_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000 + (uint64_t)t.tv_nsec / 1000000;
+}
+
+static void note_time(uint64_t at_ms, char *out, size_t n) {
+    time_t sec = (time_t)(at_ms / 1000);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    strftime(out, n, "%H:%M:%S", &tm);
+}
+
+static void print_once(void) {
+    printf("uptime %llus  players %u  games %u  bot games %u  bot queue %u  seeks %u\n",
+           (unsigned long long)snap.uptime_s, snap.nplayers, snap.ngames, snap.bot_games, snap.bot_queue, snap.seeks);
+    printf("PLAYERS\n");
+    for (uint32_t i = 0; i < snap.nplayers; i++) {
+        const DashPlayer *p = &snap.players[i];
+        printf("  %-20s %-8s games %u  fd %d  %s:%u%s\n", p->nick, state_names[p->state], p->games, p->fd, p->ip,
+               p->port, p->subscribed ? "  sub" : "");
+    }
+    printf("GAMES\n");
+    for (uint32_t i = 0; i < snap.ngames; i++) {
+        const DashGame *g = &snap.games[i];
+        printf("  #%-5d %2dx%-2d %-7s %s vs %s  ply %d  caps %u/%u\n", g->id, g->size, g->size,
+               g->running ? "running" : "open", g->host, g->guest[0] ? g->guest : "-", g->ply, g->cap_black,
+               g->cap_white);
+    }
+    printf("NOTIFICATIONS\n");
+    for (uint32_t i = 0; i < snap.nnotes; i++) {
+        char when[16];
+        note_time(snap.notes[i].at_ms, when, sizeof(when));
+        printf("  %s %s\n", when, snap.notes[i].text);
+    }
+}
+
+// ---- panes ----
+
+static void pane(WINDOW *w, const char *title) {
+    werase(w);
+    wattron(w, COLOR_PAIR(7));
+    box(w, 0, 0);
+    wattroff(w, COLOR_PAIR(7));
+    wattron(w, COLOR_PAIR(1) | A_BOLD);
+    mvwprintw(w, 0, 2, " %s ", title);
+    wattroff(w, COLOR_PAIR(1) | A_BOLD);
+}
+
+static void draw_players(WINDOW *w, int top) {
+    int h = getmaxy(w) - 2, wd = getmaxx(w) - 2;
+    pane(w, "PLAYERS");
+    for (int r = 0; r < h && top + r < (int)snap.nplayers; r++) {
+        const DashPlayer *p = &snap.players[top + r];
+        int color = p->state == DASH_PLAYING ? 4 : p->state == DASH_IDLE ? 2 : 6;
+        wattron(w, COLOR_PAIR(color));
+        mvwprintw(w, 1 + r, 1, "%-*.*s", wd, wd, p->nick);
+        wattroff(w, COLOR_PAIR(color));
+        if (wd > 24) mvwprintw(w, 1 + r, wd - 9, "%8s", state_names[p->state]);
+    }
+    if (snap.nplayers > (uint32_t)h) mvwprintw(w, h + 1, 2, " %d-%d/%u u d ", top + 1, top + h, snap.nplayers);
+}
+
+static void draw_notes(WINDOW *w) {
+    int h = getmaxy(w) - 2, wd = getmaxx(w) - 2;
+    pane(w, "NOTIFICATIONS");
+    int first = (int)snap.nnotes > h ? (int)snap.nnotes - h : 0;
+    for (int r = 0; first + r < (int)snap.nnotes; r++) {
+        char when[16];
+        note_time(snap.notes[first + r].at_ms, when, sizeof(when));
+        wattron(w, COLOR_PAIR(5));
+        mvwprintw(w, 1 + r, 1, "%s", when);
+        wattroff(w, COLOR_PAIR(5));
+        mvwprintw(w, 1 + r, 10, "%.*s", wd > 9 ? wd - 9 : 0, snap.notes[first + r].text);
+    }
+}
+
+static void draw_games(WINDOW *w, int top) {
+    int h = getmaxy(w) - 2;
+    pane(w, "GAMES");
+    wattron(w, A_BOLD);
+    mvwprintw(w, 1, 1, "%-6s %-6s %-8s %-16s %-16s %5s %9s", "id", "size", "state", "black", "white", "ply", "captures");
+    wattroff(w, A_BOLD);
+    for (int r = 0; r < h - 1 && top + r < (int)snap.ngames; r++) {
+        const DashGame *g = &snap.games[top + r];
+        // host_color is not published; show the seats in join order
+        wattron(w, COLOR_PAIR(g->running ? 4 : 6));
+        mvwprintw(w, 2 + r, 1, "%-6d %2dx%-3d %-8s %-16.16s %-16.16s %5d %4u/%-4u", g->id, g->size, g->size,
+                  g->running ? (g->to_move ? "W to go" : "B to go") : "open", g->host, g->guest[0] ? g->guest : "-",
+                  g->ply, g->cap_black, g->cap_white);
+        wattroff(w, COLOR_PAIR(g->running ? 4 : 6));
+    }
+    if (snap.ngames > (uint32_t)(h - 1))
+        mvwprintw(w, h + 1, 2, " %d-%d/%u ", top + 1, top + h - 1, snap.ngames);
+}
+
+static void draw_status(const char *path, int stale) {
+    move(0, 0);
+    clrtoeol();
+    attron(COLOR_PAIR(1) | A_BOLD);
+    printw(" GO SERVER ");
+    attroff(COLOR_PAIR(1) | A_BOLD);
+    printw(" up %llus  players %u  games %u  bot %u (queue %u)  seeks %u  journal %llu  archived %llu  slow %llu",
+           (unsigned long long)snap.uptime_s, snap.nplayers, snap.ngames, snap.bot_games, snap.bot_queue,
+           snap.seeks, (unsigned long long)snap.journal_records, (unsigned long long)snap.archive_games,
+           (unsigned long long)snap.slow_logged);
+    if (stale) {
+        attron(COLOR_PAIR(6) | A_BOLD);
+        printw("  STALE: waiting for %s", path);
+        attroff(COLOR_PAIR(6) | A_BOLD);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    int once = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--once") == 0) once = 1;
+        else path = argv[i];
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s DASH_FILE [--once]\n", argv[0]);
+        return 1;
+    }
+
+    const DashFile *f = dash_attach(path);
+    if (once) {
+        if (!f || dash_read(f, &snap) < 0) {
+            fprintf(stderr, "%s: no snapshot\n", path);
+            return 1;
+        }
+        print_once();
+        return 0;
+    }
+
+    initscr();
+    cbreak();
+    noecho();
+    keypad(stdscr, TRUE);
+    curs_set(0);
+    if (has_colors()) {
+        start_color();
+        use_default_colors();
+        init_pair(1, COLOR_CYAN, -1);    // titles
+        init_pair(2, COLOR_WHITE, -1);   // idle
+        init_pair(4, COLOR_GREEN, -1);   // playing
+        init_pair(5, COLOR_MAGENTA, -1); // times
+        init_pair(6, COLOR_YELLOW, -1);  // waiting, stale
+        init_pair(7, COLOR_CYAN, -1);    // borders
+    }
+    timeout(DASH_PERIOD_MS);
+
+    int player_top = 0, game_top = 0;
+    for (;;) {
+        int stale = !f || dash_read(f, &snap) < 0 || wall_ms() - snap.taken_ms > STALE_MS;
+        if (stale) {
+            // the server restarted (new file) or is gone; try the path again
+            const DashFile *nf = dash_attach(path);
+            if (nf) {
+                if (f) dash_detach(f);
+                f = nf;
+            }
+        }
+
+        int left = COLS / 3 < 24 ? 24 : COLS / 3;
+        int body = LINES - 1, top_h = body / 2;
+        WINDOW *wp = newwin(top_h, left, 1, 0);
+        WINDOW *wn = newwin(body - top_h, left, 1 + top_h, 0);
+        WINDOW *wg = newwin(body, COLS - left, 1, left);
+        draw_status(path, stale);
+        draw_players(wp, player_top);
+        draw_notes(wn);
+        draw_games(wg, game_top);
+        wnoutrefresh(stdscr);
+        wnoutrefresh(wp);
+        wnoutrefresh(wn);
+        wnoutrefresh(wg);
+        doupdate();
+        delwin(wp);
+        delwin(wn);
+        delwin(wg);
+
+        int ch = getch();
+        int page = body - 3;
+        if (ch == 'q' || ch == 'Q') break;
+        if (ch == 'u' && player_top > 0) player_top--;
+        if (ch == 'd' && player_top + 1 < (int)snap.nplayers) player_top++;
+        if (ch == KEY_UP && game_top > 0) game_top--;
+        if (ch == KEY_DOWN && game_top + 1 < (int)snap.ngames) game_top++;
+        if (ch == KEY_PPAGE) game_top = game_top > page ? game_top - page : 0;
+        if (ch == KEY_NPAGE && game_top + page < (int)snap.ngames) game_top += page;
+    }
+    endwin();
+    if (f) dash_detach(f);
+    return 0;
+}
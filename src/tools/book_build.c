@@ -0,0 +1,237 @@
+// book_build.c
+// Offline opening-book builder. Replays SGF game records with the server
+// rules, and for the first BOOK_MAX_PLY moves of each game counts how often
+// every (canonical position, canonical move) pair was played and won.
+// The result is written sorted by (key, move) in the format of
+// server_book.h, to a temp file that is renamed over the output.
+// Records with a handicap, setup stones or no result are skipped.
+// Run:   ./book_build out.book [--plies N] [--min N] games.sgf...
+// gcc -O2 book_build.c ../server/server_rules.c ../server/server_book.c -I../server -o book_build
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "server_game.h"
+#include "server_book.h"
+
+typedef struct
+{
+    uint64_t key;
+    int move;           // -1 = empty slot
+    uint32_t plays;
+    uint32_t wins;
+} Stat;
+
+static Stat *stats;
+static size_t stat_cap;
+static size_t stat_count;
+
+static size_t stat_slot(uint64_t key, int move) {
+    size_t h = (size_t)(key ^ ((uint64_t)move * 0x9e3779b97f4a7c15ull));
+    size_t i = h & (stat_cap - 1);
+    while (stats[i].move != -1 && (stats[i].key != key || stats[i].move != move))
+        i = (i + 1) & (stat_cap - 1);
+    return i;
+}
+
+static void stat_grow(void) {
+    Stat *old = stats;
+    size_t old_cap = stat_cap;
+    stat_cap = stat_cap ? stat_cap * 2 : 1 << 16;
+    stats = malloc(stat_cap * sizeof(Stat));
+    if (!stats) {
+        perror("malloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < stat_cap; i++) stats[i].move = -1;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].move != -1) stats[stat_slot(old[i].key, old[i].move)] = old[i];
+    }
+    free(old);
+}
+
+static void stat_add(uint64_t key, int move, int won) {
+    if ((stat_count + 1) * 2 > stat_cap) stat_grow();
+    size_t i = stat_slot(key, move);
+    if (stats[i].move == -1) {
+        stats[i].key = key;
+        stats[i].move = move;
+        stats[i].plays = 0;
+        stats[i].wins = 0;
+        stat_count++;
+    }
+    stats[i].plays++;
+    if (won) stats[i].wins++;
+}
+
+// value of property `name` (e.g. "SZ") in the root node, or NULL
+static const char *sgf_prop(const char *rec, const char *end, const char *name, char *out, size_t outsz) {
+    size_t n = strlen(name);
+    for (const char *p = rec; p + n < end; p++) {
+        if (memcmp(p, name, n) == 0 && p[n] == '[' && (p == rec || p[-1] < 'A' || p[-1] > 'Z')) {
+            const char *v = p + n + 1;
+            size_t len = 0;
+            while (v + len < end && v[len] != ']') len++;
+            if (len >= outsz) len = outsz - 1;
+            memcpy(out, v, len);
+            out[len] = '\0';
+            return out;
+        }
+    }
+    return NULL;
+}
+
+// replay one game record [rec, end); returns 1 if it was used
+static int add_record(const char *rec, const char *end, int plies) {
+    char val[64];
+    int size = 19;
+    if (sgf_prop(rec, end, "SZ", val, sizeof(val))) size = atoi(val);
+    if (size < 2 || size > BOARD_MAX_SIZE) return 0;
+    if (sgf_prop(rec, end, "HA", val, sizeof(val)) && atoi(val) > 1) return 0;
+    if (sgf_prop(rec, end, "AB", val, sizeof(val)) || sgf_prop(rec, end, "AW", val, sizeof(val))) return 0;
+    if (!sgf_prop(rec, end, "RE", val, sizeof(val))) return 0;
+
+    int winner;
+    if (val[0] == 'B' || val[0] == 'b') winner = 0;
+    else if (val[0] == 'W' || val[0] == 'w') winner = 1;
+    else return 0;
+
+    Game g;
+    unsigned char boards[2 * BOARD_CELLS_MAX];
+    memset(&g, 0, sizeof(g));
+    g.size = size;
+    game_use_storage(&g, boards);
+    game_clear_board(&g);
+
+    for (const char *p = rec; p < end && g.ply < plies; p++) {
+        if (*p != ';') continue;
+        const char *q = p + 1;
+        while (q < end && (*q == ' ' || *q == '\n' || *q == '\r' || *q == '\t')) q++;
+        if (q + 1 >= end || (q[0] != 'B' && q[0] != 'W') || q[1] != '[') continue;
+
+        int color = q[0] == 'B' ? 0 : 1;
+        if (color != g.to_move) break;      // two moves in a row: not a plain game
+        if (q + 4 >= end || q[2] == ']' || q[4] != ']') break;   // pass ends the opening
+        int x = q[2] - 'a', y = q[3] - 'a';
+        if (x < 0 || y < 0 || x >= size || y >= size) break;
+
+        uint64_t key = book_canonical(&g, NULL);
+        int move = book_canonical_move(&g, y * size + x);
+        if (game_play_move(&g, color, x, y) != MOVE_OK) break;
+        stat_add(key, move, color == winner);
+    }
+    return 1;
+}
+
+static int read_file(const char *path, char **out, size_t *outlen) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    size_t cap = 1 << 16, len = 0;
+    char *buf = malloc(cap);
+    size_t r;
+    while (buf && (r = fread(buf + len, 1, cap - 1 - len, f)) > 0) {
+        len += r;
+        if (len == cap - 1) buf = realloc(buf, cap *= 2);
+    }
+    fclose(f);
+    if (!buf) return -1;
+    buf[len] = '\0';
+    *out = buf;
+    *outlen = len;
+    return 0;
+}
+
+static int cmp_stat(const void *a, const void *b) {
+    const Stat *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->move - y->move;
+}
+
+static int write_book(const char *path, int min_plays) {
+    size_t n = 0;
+    for (size_t i = 0; i < stat_cap; i++) {
+        if (stats[i].move != -1 && stats[i].plays >= (uint32_t)min_plays) stats[n++] = stats[i];
+    }
+    qsort(stats, n, sizeof(Stat), cmp_stat);
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        perror(tmp);
+        return -1;
+    }
+
+    BookHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BOOK_MAGIC, sizeof(BOOK_MAGIC));
+    hdr.version = BOOK_VERSION;
+    hdr.count = n;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t plays = stats[i].plays, wins = stats[i].wins;
+        while (plays > UINT16_MAX) {
+            plays /= 2;
+            wins /= 2;
+        }
+        BookEntry e = {stats[i].key, (uint16_t)stats[i].move, (uint16_t)plays, (uint16_t)wins, 0};
+        fwrite(&e, sizeof(e), 1, f);
+    }
+    if (fclose(f) != 0 || rename(tmp, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    printf("%s: %zu entries (%zu bytes)\n", path, n, sizeof(hdr) + n * sizeof(BookEntry));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s out.book [--plies N] [--min N] games.sgf...\n", argv[0]);
+        return 1;
+    }
+    const char *out = argv[1];
+    int plies = BOOK_MAX_PLY, min_plays = BOOK_MIN_PLAYS;
+    long games = 0, used = 0;
+
+    stat_grow();
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--plies") == 0 && i + 1 < argc) {
+            plies = atoi(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            min_plays = atoi(argv[++i]);
+            continue;
+        }
+
+        char *buf;
+        size_t len;
+        if (read_file(argv[i], &buf, &len) < 0) continue;
+
+        // a file may hold a collection: one record per top-level "(;"
+        const char *end = buf + len;
+        const char *rec = strstr(buf, "(;");
+        while (rec) {
+            const char *next = NULL;
+            for (const char *p = rec + 2; p + 1 < end; p++) {
+                if (p[0] == '(' && p[1] == ';' && (p[-1] == '\n' || p[-1] == ')')) {
+                    next = p;
+                    break;
+                }
+            }
+            games++;
+            used += add_record(rec, next ? next : end, plies);
+            rec = next;
+        }
+        free(buf);
+    }
+
+    printf("%ld records, %ld used, %zu position/move pairs\n", games, used, stat_count);
+    return write_book(out, min_plays) < 0 ? 1 : 0;
+}
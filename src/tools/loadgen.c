@@ -0,0 +1,429 @@
+// loadgen.c
+// Protocol load generator: many simulated players over real connections,
+// spread over a few threads, each running its own epoll loop. Players are
+// paired within a thread: the even one of a pair hosts, the odd one joins,
+// both play random moves on empty points after a think time, and after
+// --moves plies the player to move leaves and the pair starts over. Moves
+// the rules refuse (suicide, ko) are retried elsewhere and counted apart
+// from real errors. Reports moves/s every second, then MOVE->BOARD round
+// trip percentiles (send of MOVE/PASS to the BOARD that answers it), games,
+// rejections, errors and refused connections.
+// Run:   ./loadgen 127.0.0.1 1984 [--clients N] [--threads N] [--seconds N]
+//                  [--think-ms N] [--size N] [--moves N]
+// gcc -O2 -pthread loadgen.c ../server/server_metrics.c -I../server -o loadgen
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "server_metrics.h"
+
+#define LG_RBUF 8192
+#define LG_CELLS 1024
+
+enum { P_CONNECTING, P_READY, P_HOSTING, P_JOINING, P_PLAYING, P_DEAD };
+
+typedef struct
+{
+    int fd;
+    int state;
+    int game;                 // current game id, 0 between games
+    int color;                // 0 black, 1 white
+    int plies;                // BOARD updates seen in this game
+    int awaiting;             // a MOVE/PASS is in flight
+    uint64_t sent_ns;
+    int size;
+    char board[LG_CELLS];     // last BOARD, 'x' marks points the rules refused
+    size_t rlen;
+    char rbuf[LG_RBUF];
+} Player;
+
+typedef struct
+{
+    uint64_t due;
+    int player;
+    int game;
+} Timer;
+
+typedef struct
+{
+    int id;
+    Player *players;
+    int count;
+    int epfd;
+    unsigned rng;
+    Timer *heap;
+    int nheap;
+    int heap_cap;
+    Histogram rtt;
+    _Atomic uint64_t moves;
+    _Atomic uint64_t games;
+    _Atomic uint64_t rejected;    // suicide / ko / occupied
+    _Atomic uint64_t errors;      // any other ERR, unexpected close
+    _Atomic uint64_t refused;     // connect failed or server full
+} Worker;
+
+static struct sockaddr_in target;
+static int think_ms = 200;
+static int board_size = 9;
+static int max_moves = 60;
+static atomic_int stop;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+// ---- timers (binary heap on due time) ----
+
+static void heap_push(Worker *w, Timer t) {
+    if (w->nheap == w->heap_cap) return;   // stale timers of ended games; they expire within a think time
+    int i = w->nheap++;
+    while (i > 0 && w->heap[(i - 1) / 2].due > t.due) {
+        w->heap[i] = w->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    w->heap[i] = t;
+}
+
+static Timer heap_pop(Worker *w) {
+    Timer top = w->heap[0], last = w->heap[--w->nheap];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= w->nheap) break;
+        if (c + 1 < w->nheap && w->heap[c + 1].due < w->heap[c].due) c++;
+        if (w->heap[c].due >= last.due) break;
+        w->heap[i] = w->heap[c];
+        i = c;
+    }
+    w->heap[i] = last;
+    return top;
+}
+
+// ---- players ----
+
+static void drop(Worker *w, Player *p) {
+    if (p->state == P_DEAD) return;
+    p->state = P_DEAD;
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, p->fd, NULL);
+    close(p->fd);
+}
+
+static void say(Worker *w, Player *p, const char *line) {
+    size_t n = strlen(line);
+    ssize_t s = send(p->fd, line, n, MSG_NOSIGNAL);
+    // commands are a few bytes; a full socket buffer means the server stalled
+    if (s != (ssize_t)n) {
+        atomic_fetch_add_explicit(&w->errors, 1, memory_order_relaxed);
+        drop(w, p);
+    }
+}
+
+static void host(Worker *w, int i) {
+    Player *p = &w->players[i];
+    if (p->state == P_DEAD || w->players[i + 1].state == P_DEAD || w->players[i + 1].state == P_CONNECTING) return;
+    char line[32];
+    snprintf(line, sizeof(line), "HOST %d R\n", board_size);
+    p->state = P_HOSTING;
+    p->game = 0;
+    say(w, p, line);
+}
+
+static void schedule_move(Worker *w, int i) {
+    Player *p = &w->players[i];
+    uint64_t think = think_ms > 0 ? (uint64_t)(think_ms / 2 + rand_r(&w->rng) % (unsigned)(think_ms + 1)) : 0;
+    heap_push(w, (Timer){now_ns() + think * 1000000ull, i, p->game});
+}
+
+static void play(Worker *w, int i) {
+    Player *p = &w->players[i];
+    char line[64];
+    if (p->plies >= max_moves) {
+        snprintf(line, sizeof(line), "LEAVE %d\n", p->game);
+        p->game = 0;
+        say(w, p, line);
+        return;
+    }
+    int n = p->size * p->size, empty = 0;
+    for (int k = 0; k < n; k++) empty += p->board[k] == '.';
+    if (empty == 0) {
+        snprintf(line, sizeof(line), "PASS %d\n", p->game);
+    } else {
+        int pick = (int)(rand_r(&w->rng) % (unsigned)empty), k = 0;
+        for (;; k++) {
+            if (p->board[k] == '.' && pick-- == 0) break;
+        }
+        p->board[k] = 'x';
+        snprintf(line, sizeof(line), "MOVE %d %d %d\n", p->game, k % p->size, k / p->size);
+    }
+    p->awaiting = 1;
+    p->sent_ns = now_ns();
+    say(w, p, line);
+}
+
+// the pair is between games: the even player hosts again
+static void game_done(Worker *w, int i) {
+    Player *p = &w->players[i];
+    p->game = 0;
+    p->awaiting = 0;
+    p->state = P_READY;
+    if (i % 2 == 0) host(w, i);
+}
+
+static void on_line(Worker *w, int i, char *line) {
+    Player *p = &w->players[i];
+    int id, size;
+    char word[16];
+
+    if (strncmp(line, "BOARD ", 6) == 0) {
+        char *cells;
+        if (sscanf(line, "BOARD %d %15s", &id, word) != 2 || id != p->game) return;
+        // BOARD <id> <to_move> <cells>
+        cells = strchr(line + 6, ' ');
+        if (cells) cells = strchr(cells + 1, ' ');
+        if (!cells) return;
+        cells++;
+        int n = p->size * p->size;
+        if ((int)strlen(cells) < n) return;
+        memcpy(p->board, cells, (size_t)n);
+        p->plies++;
+        if (p->awaiting) {
+            hist_record(&w->rtt, now_ns() - p->sent_ns);
+            atomic_fetch_add_explicit(&w->moves, 1, memory_order_relaxed);
+            p->awaiting = 0;
+        }
+        if ((strcmp(word, "BLACK") == 0 ? 0 : 1) == p->color) schedule_move(w, i);
+    } else if (strncmp(line, "START ", 6) == 0) {
+        if (sscanf(line, "START %d %d %15s", &id, &size, word) != 3 || size * size > LG_CELLS) return;
+        p->state = P_PLAYING;
+        p->game = id;
+        p->size = size;
+        p->color = strcmp(word, "BLACK") == 0 ? 0 : 1;
+        p->plies = -1;    // the opening BOARD is not a move
+        p->awaiting = 0;
+        if (p->color == 0) atomic_fetch_add_explicit(&w->games, 1, memory_order_relaxed);
+    } else if (strncmp(line, "HOSTED ", 7) == 0) {
+        if (sscanf(line, "HOSTED %d", &id) != 1 || p->state != P_HOSTING) return;
+        Player *q = &w->players[i + 1];
+        if (q->state == P_DEAD) return;
+        char join[32];
+        snprintf(join, sizeof(join), "JOIN %d\n", id);
+        q->state = P_JOINING;
+        q->game = 0;
+        say(w, q, join);
+    } else if (strncmp(line, "GAME_OVER ", 10) == 0) {
+        if (sscanf(line, "GAME_OVER %d", &id) == 1 && id == p->game) game_done(w, i);
+    } else if (strcmp(line, "OK LEFT") == 0) {
+        game_done(w, i);
+    } else if (strcmp(line, "OK NICK set") == 0) {
+        p->state = P_READY;
+        // whichever of the pair is ready second starts the first game
+        int even = i & ~1;
+        if (w->players[even].state == P_READY && w->players[even + 1].state == P_READY) host(w, even);
+    } else if (strncmp(line, "ERR ", 4) == 0) {
+        if (strcmp(line, "ERR server full") == 0) {
+            atomic_fetch_add_explicit(&w->refused, 1, memory_order_relaxed);
+            drop(w, p);
+        } else if (p->awaiting && (strcmp(line, "ERR suicide") == 0 || strcmp(line, "ERR ko") == 0 ||
+                                   strcmp(line, "ERR occupied") == 0)) {
+            atomic_fetch_add_explicit(&w->rejected, 1, memory_order_relaxed);
+            p->awaiting = 0;
+            play(w, i);
+        } else {
+            atomic_fetch_add_explicit(&w->errors, 1, memory_order_relaxed);
+            p->awaiting = 0;
+        }
+    }
+}
+
+static void on_readable(Worker *w, int i) {
+    Player *p = &w->players[i];
+    ssize_t r = recv(p->fd, p->rbuf + p->rlen, sizeof(p->rbuf) - 1 - p->rlen, 0);
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    if (r <= 0) {
+        atomic_fetch_add_explicit(&w->errors, 1, memory_order_relaxed);
+        drop(w, p);
+        return;
+    }
+    p->rlen += (size_t)r;
+    size_t start = 0;
+    for (size_t k = 0; k < p->rlen; k++) {
+        if (p->rbuf[k] != '\n') continue;
+        p->rbuf[k] = '\0';
+        if (k > start && p->rbuf[k - 1] == '\r') p->rbuf[k - 1] = '\0';
+        on_line(w, i, p->rbuf + start);
+        if (p->state == P_DEAD) return;
+        start = k + 1;
+    }
+    memmove(p->rbuf, p->rbuf + start, p->rlen - start);
+    p->rlen -= start;
+    if (p->rlen == sizeof(p->rbuf) - 1) p->rlen = 0;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i < w->count; i++) {
+        Player *p = &w->players[i];
+        p->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (p->fd < 0 || connect(p->fd, (struct sockaddr *)&target, sizeof(target)) < 0) {
+            if (p->fd >= 0) close(p->fd);
+            p->state = P_DEAD;
+            atomic_fetch_add_explicit(&w->refused, 1, memory_order_relaxed);
+            continue;
+        }
+        int one = 1;
+        setsockopt(p->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(p->fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, p->fd, &ev);
+        p->state = P_CONNECTING;
+        char nick[32];
+        snprintf(nick, sizeof(nick), "NICK lg%d_%d\n", w->id, i);
+        say(w, p, nick);
+    }
+
+    struct epoll_event evs[256];
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        int timeout = 100;
+        if (w->nheap) {
+            uint64_t now = now_ns(), due = w->heap[0].due;
+            int ms = due > now ? (int)((due - now + 999999) / 1000000) : 0;
+            if (ms < timeout) timeout = ms;
+        }
+        int n = epoll_wait(w->epfd, evs, 256, timeout);
+        for (int k = 0; k < n; k++) on_readable(w, (int)evs[k].data.u32);
+        uint64_t now = now_ns();
+        while (w->nheap && w->heap[0].due <= now) {
+            Timer t = heap_pop(w);
+            Player *p = &w->players[t.player];
+            if (p->state == P_PLAYING && p->game == t.game && t.game != 0 && !p->awaiting) play(w, t.player);
+        }
+    }
+    for (int i = 0; i < w->count; i++) {
+        if (w->players[i].state != P_DEAD) close(w->players[i].fd);
+    }
+    close(w->epfd);
+    return NULL;
+}
+
+static double ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+int main(int argc, char **argv) {
+    int clients = 1000, threads = 4, seconds = 30;
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s HOST PORT [--clients N] [--threads N] [--seconds N] [--think-ms N] [--size N] [--moves N]\n",
+                argv[0]);
+        return 1;
+    }
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons((uint16_t)atoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &target.sin_addr) != 1) {
+        fprintf(stderr, "bad address %s\n", argv[1]);
+        return 1;
+    }
+    for (int i = 3; i + 1 < argc; i += 2) {
+        int v = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--clients") == 0) clients = v;
+        else if (strcmp(argv[i], "--threads") == 0) threads = v;
+        else if (strcmp(argv[i], "--seconds") == 0) seconds = v;
+        else if (strcmp(argv[i], "--think-ms") == 0) think_ms = v;
+        else if (strcmp(argv[i], "--size") == 0) board_size = v;
+        else if (strcmp(argv[i], "--moves") == 0) max_moves = v;
+    }
+    clients &= ~1;
+    if (clients < 2 || threads < 1 || seconds < 1 || think_ms < 0) {
+        fprintf(stderr, "need an even --clients >= 2, --threads >= 1, --seconds >= 1\n");
+        return 1;
+    }
+    if (threads > clients / 2) threads = clients / 2;
+
+    // one descriptor per player plus slack
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)clients + 64) {
+        rl.rlim_cur = rl.rlim_max < (rlim_t)clients + 64 ? rl.rlim_max : (rlim_t)clients + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    Worker *ws = calloc((size_t)threads, sizeof(Worker));
+    Player *players = calloc((size_t)clients, sizeof(Player));
+    if (!ws || !players) {
+        perror("calloc");
+        return 1;
+    }
+    pthread_t *ths = calloc((size_t)threads, sizeof(pthread_t));
+    int pairs = clients / 2, first = 0;
+    for (int t = 0; t < threads; t++) {
+        Worker *w = &ws[t];
+        int mine = pairs / threads + (t < pairs % threads);
+        w->id = t;
+        w->players = players + first;
+        w->count = 2 * mine;
+        w->rng = 7919u * (unsigned)(t + 1);
+        w->heap_cap = 4 * w->count;
+        w->heap = malloc((size_t)w->heap_cap * sizeof(Timer));
+        first += w->count;
+        pthread_create(&ths[t], NULL, worker_main, w);
+    }
+
+    uint64_t start = now_ns(), last_moves = 0;
+    for (int s = 1; s <= seconds; s++) {
+        struct timespec one = {1, 0};
+        nanosleep(&one, NULL);
+        uint64_t moves = 0, games = 0, errors = 0, refused = 0;
+        for (int t = 0; t < threads; t++) {
+            moves += atomic_load_explicit(&ws[t].moves, memory_order_relaxed);
+            games += atomic_load_explicit(&ws[t].games, memory_order_relaxed);
+            errors += atomic_load_explicit(&ws[t].errors, memory_order_relaxed);
+            refused += atomic_load_explicit(&ws[t].refused, memory_order_relaxed);
+        }
+        printf("%3ds  %7llu moves/s  games %llu  errors %llu  refused %llu\n", s,
+               (unsigned long long)(moves - last_moves), (unsigned long long)games, (unsigned long long)errors,
+               (unsigned long long)refused);
+        fflush(stdout);
+        last_moves = moves;
+    }
+    atomic_store(&stop, 1);
+    for (int t = 0; t < threads; t++) pthread_join(ths[t], NULL);
+    double secs = (double)(now_ns() - start) / 1e9;
+
+    Histogram all;
+    memset(&all, 0, sizeof(all));
+    uint64_t games = 0, rejected = 0, errors = 0, refused = 0;
+    for (int t = 0; t < threads; t++) {
+        const Histogram *h = &ws[t].rtt;
+        all.count += h->count;
+        all.sum += h->sum;
+        if (h->max > all.max) all.max = h->max;
+        for (int b = 0; b < HIST_BUCKETS; b++) all.buckets[b] += h->buckets[b];
+        games += ws[t].games;
+        rejected += ws[t].rejected;
+        errors += ws[t].errors;
+        refused += ws[t].refused;
+    }
+    printf("%d clients on %d threads, %.1f s, think %d ms, %dx%d, %d plies per game\n", clients, threads, secs,
+           think_ms, board_size, board_size, max_moves);
+    printf("moves: %llu (%.0f/s)  games: %llu  rejected by rules: %llu  errors: %llu  refused: %llu\n",
+           (unsigned long long)all.count, (double)all.count / secs, (unsigned long long)games,
+           (unsigned long long)rejected, (unsigned long long)errors, (unsigned long long)refused);
+    printf("MOVE->BOARD ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f  mean %.3f\n",
+           ms(hist_quantile(&all, 0.5)), ms(hist_quantile(&all, 0.9)), ms(hist_quantile(&all, 0.99)),
+           ms(hist_quantile(&all, 0.999)), ms(all.max), all.count ? ms(all.sum / all.count) : 0.0);
+    return 0;
+}
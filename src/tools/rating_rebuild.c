@@ -0,0 +1,168 @@
+// rating_rebuild.c
+// Recomputes <dir>/ratings.tbl from the whole game archive, e.g. after
+// changing the rating parameters. Segments are decoded in parallel, one
+// per thread in rounds of --threads segments; the games of a round are
+// then rated in archive order on the main thread, since every game depends
+// on both players' previous ones. The table is built in a temp file and
+// renamed over the old one; stop the server first (it keeps its own
+// mapping). --tau and --period default to the existing table's values.
+// Run:   ./rating_rebuild DIR [--tau X] [--period SECS] [--threads N]
+// gcc -O2 -pthread rating_rebuild.c ../server/server_rating.c ../server/server_archive.c ../server/server_crc.c -I../server -lm -o rating_rebuild
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "server_rating.h"
+
+typedef struct
+{
+    int64_t end_time;
+    uint32_t offset;
+    uint32_t len;
+    uint8_t winner;
+    uint8_t vs_bot;
+    char black[NICK_SIZE];
+    char white[NICK_SIZE];
+} Result;
+
+typedef struct
+{
+    const char *dir;
+    uint32_t segment;
+    Result *results;
+    size_t count, cap;
+    long decoded;
+} Segment;
+
+static double now_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+static void collect(const ArchiveGame *ag, ArchivePos pos, uint32_t len, void *arg) {
+    Segment *s = arg;
+    if (s->count == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        Result *t = realloc(s->results, cap * sizeof(*t));
+        if (!t) {
+            perror("realloc");
+            exit(1);
+        }
+        s->results = t;
+        s->cap = cap;
+    }
+    Result *r = &s->results[s->count++];
+    r->end_time = ag->end_time;
+    r->offset = pos.offset;
+    r->len = len;
+    r->winner = (uint8_t)ag->winner;
+    r->vs_bot = (uint8_t)ag->vs_bot;
+    memcpy(r->black, ag->black, sizeof(r->black));
+    memcpy(r->white, ag->white, sizeof(r->white));
+}
+
+static void *decode_segment(void *arg) {
+    Segment *s = arg;
+    s->decoded = archive_scan_segment(s->dir, s->segment, collect, s);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s DIR [--tau X] [--period SECS] [--threads N]\n", argv[0]);
+        return 1;
+    }
+    const char *dir = argv[1];
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    char path[4200], tmp[4300];
+    snprintf(path, sizeof(path), "%s/ratings.tbl", dir);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    RatingParams params = {RATING_DEFAULT_TAU, RATING_DEFAULT_PERIOD};
+    RatingHeader old;
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0 && pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+        memcmp(old.magic, RATING_MAGIC, sizeof(old.magic)) == 0 && old.params.tau > 0 && old.params.period > 0)
+        params = old.params;
+    if (fd >= 0) close(fd);
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--tau") == 0 && i + 1 < argc) params.tau = atof(argv[++i]);
+        else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) params.period = atof(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atol(argv[++i]);
+    }
+    if (threads < 1) threads = 1;
+    if (threads > 64) threads = 64;
+    if (params.tau <= 0 || params.period <= 0) {
+        fprintf(stderr, "--tau and --period must be positive\n");
+        return 1;
+    }
+
+    uint32_t *segs;
+    int nsegs = archive_segments(dir, &segs);
+    if (nsegs < 0) {
+        perror(dir);
+        return 1;
+    }
+    if (rating_create(tmp, &params) < 0) return 1;
+
+    double t0 = now_ms(), decode_ms = 0, rate_ms = 0;
+    long games = 0;
+    Segment round[64];
+    pthread_t tids[64];
+    for (int base = 0; base < nsegs; base += (int)threads) {
+        int n = nsegs - base < threads ? nsegs - base : (int)threads;
+        double t1 = now_ms();
+        for (int i = 0; i < n; i++) {
+            memset(&round[i], 0, sizeof(round[i]));
+            round[i].dir = dir;
+            round[i].segment = segs[base + i];
+            if (pthread_create(&tids[i], NULL, decode_segment, &round[i]) != 0) {
+                perror("pthread_create");
+                return 1;
+            }
+        }
+        for (int i = 0; i < n; i++) pthread_join(tids[i], NULL);
+        double t2 = now_ms();
+
+        for (int i = 0; i < n; i++) {
+            Segment *s = &round[i];
+            for (size_t k = 0; k < s->count; k++) {
+                const Result *r = &s->results[k];
+                ArchiveGame ag;
+                memset(&ag, 0, sizeof(ag));
+                ag.end_time = r->end_time;
+                ag.winner = r->winner;
+                ag.vs_bot = r->vs_bot;
+                memcpy(ag.black, r->black, sizeof(ag.black));
+                memcpy(ag.white, r->white, sizeof(ag.white));
+                ArchivePos pos = {s->segment, r->offset};
+                rating_add(&ag, pos, r->len);
+            }
+            games += (long)s->count;
+            free(s->results);
+        }
+        decode_ms += t2 - t1;
+        rate_ms += now_ms() - t2;
+    }
+    free(segs);
+
+    rating_close();
+    if (rename(tmp, path) < 0) {
+        perror(path);
+        return 1;
+    }
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    fprintf(stderr, "%ld games in %d segments, %ld threads: decode %.0f ms, rate %.0f ms, total %.0f ms "
+            "(tau %.2f, period %.0f s)\n", games, nsegs, threads, decode_ms, rate_ms, now_ms() - t0,
+            params.tau, params.period);
+    return 0;
+}
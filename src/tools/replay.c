@@ -0,0 +1,289 @@
+// replay.c
+// Plays a traffic capture (server --capture FILE) back against a server:
+// one connection per captured connection, opened, fed and closed in the
+// captured order. Start the target fresh (no journal or archive state)
+// with the --seed from the capture so it makes the same random choices;
+// bot games still diverge, since searches are timed.
+// Every connect and every line is followed by PING <n>. The server answers
+// in order, so PONG <n> means the line and whatever it pushed to other
+// players has been handled; reply latency is the send to that PONG.
+// Nothing goes out while a PONG is pending (at most --wait-ms), which keeps
+// the cross-connection order the games depend on: records microseconds
+// apart would otherwise land in one select() pass and run in slot order.
+// Pacing: the captured timing scaled by --speed (default 1), reporting how
+// far behind schedule lines went out, or --fast, back to back. Reports
+// lines/s, latency percentiles, lines without a PONG and ERR replies, the
+// signs of a replay that diverged.
+// --dump prints the capture as text instead.
+// Run:   ./replay capture.bin 127.0.0.1 1984 [--speed X | --fast] [--wait-ms N]
+//        ./replay capture.bin --dump
+// gcc -O2 -pthread replay.c ../server/server_capture.c ../server/server_metrics.c -I../server -o replay
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "server_capture.h"
+#include "server_metrics.h"
+
+typedef struct
+{
+    int fd;                   // -1 when not open
+    uint32_t token;           // of the PING in flight
+    int pending;              // that PING has no PONG yet
+    uint64_t sent_ns;         // 0 for the PING after a connect
+    int col;                  // position in the current reply line
+    char head[24];            // its first bytes, to spot ERR and PONG
+} Conn;
+
+static Conn *conns;
+static size_t nconns, pending;
+static Histogram latency, behind;
+static uint64_t bytes_in, err_lines, no_reply;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static Conn *conn_get(uint32_t id) {
+    if (id >= nconns) {
+        size_t n = nconns ? nconns : 64;
+        while (n <= id) n *= 2;
+        Conn *c = realloc(conns, n * sizeof(Conn));
+        if (!c) {
+            perror("realloc");
+            exit(1);
+        }
+        for (size_t i = nconns; i < n; i++) {
+            memset(&c[i], 0, sizeof(Conn));
+            c[i].fd = -1;
+        }
+        conns = c;
+        nconns = n;
+    }
+    return &conns[id];
+}
+
+static void settle_conn(Conn *c, int answered) {
+    if (!c->pending) return;
+    if (answered && c->sent_ns) hist_record(&latency, now_ns() - c->sent_ns);
+    if (!answered) no_reply++;
+    c->pending = 0;
+    pending--;
+}
+
+static void on_line(Conn *c) {
+    int n = c->col < (int)sizeof(c->head) ? c->col : (int)sizeof(c->head) - 1;
+    c->head[n] = '\0';
+    unsigned tok;
+    if (strncmp(c->head, "ERR ", 4) == 0) err_lines++;
+    else if (sscanf(c->head, "PONG %u", &tok) == 1 && tok == c->token) settle_conn(c, 1);
+}
+
+static void on_bytes(Conn *c, const char *p, size_t n) {
+    bytes_in += n;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == '\n') {
+            on_line(c);
+            c->col = 0;
+        } else {
+            if (c->col < (int)sizeof(c->head) - 1) c->head[c->col] = p[i];
+            c->col++;
+        }
+    }
+}
+
+static void conn_close(Conn *c) {
+    settle_conn(c, 0);
+    close(c->fd);
+    c->fd = -1;
+}
+
+static void drain(Conn *c) {
+    char buf[8192];
+    for (;;) {
+        ssize_t r = recv(c->fd, buf, sizeof(buf), 0);
+        if (r > 0) {
+            on_bytes(c, buf, (size_t)r);
+            continue;
+        }
+        if (r < 0 && errno == EINTR) continue;
+        if (r == 0) conn_close(c);   // the server hung up (server full); drop our end too
+        return;
+    }
+}
+
+// read whatever arrives until deadline, or (settle) until no PONG is pending
+static void pump(uint64_t deadline, int settle) {
+    static struct pollfd *pfd;
+    static uint32_t *ids;
+    static size_t cap;
+    if (cap < nconns) {
+        pfd = realloc(pfd, nconns * sizeof(*pfd));
+        ids = realloc(ids, nconns * sizeof(*ids));
+        if (!pfd || !ids) {
+            perror("realloc");
+            exit(1);
+        }
+        cap = nconns;
+    }
+    for (;;) {
+        if (settle && pending == 0) return;
+        uint64_t now = now_ns();
+        if (now >= deadline) break;
+        nfds_t n = 0;
+        for (size_t i = 0; i < nconns; i++) {
+            if (conns[i].fd < 0) continue;
+            pfd[n].fd = conns[i].fd;
+            pfd[n].events = POLLIN;
+            ids[n++] = (uint32_t)i;
+        }
+        int ms = (int)((deadline - now + 999999) / 1000000);
+        int rc = poll(pfd, n, ms);
+        if (rc < 0 && errno != EINTR) {
+            perror("poll");
+            exit(1);
+        }
+        for (nfds_t k = 0; rc > 0 && k < n; k++) {
+            if (pfd[k].revents) drain(&conns[ids[k]]);
+        }
+    }
+    if (!settle) return;
+    for (size_t i = 0; i < nconns && pending; i++) settle_conn(&conns[i], 0);   // give up on them
+}
+
+// send text plus a PING; sent_ns 0 keeps it out of the latency figures
+static int send_line(Conn *c, const char *text, uint64_t sent_ns) {
+    char out[CAPTURE_LINE_MAX + 32];
+    int k = snprintf(out, sizeof(out), "%s%sPING %u\n", text, *text ? "\n" : "", ++c->token);
+    if (send(c->fd, out, (size_t)k, MSG_NOSIGNAL) != k) return -1;
+    c->pending = 1;
+    c->sent_ns = sent_ns;
+    pending++;
+    return 0;
+}
+
+static int dump(FILE *f) {
+    static const char *kinds[] = {"", "OPEN", "LINE", "CLOSE"};
+    CaptureRecord *r = calloc(1, sizeof(*r));
+    int rc;
+    while ((rc = capture_next(f, r)) == 1)
+        printf("%10.3f %-5s %u %s\n", (double)r->t_us / 1000.0, kinds[r->kind], r->conn, r->line);
+    if (rc < 0) fprintf(stderr, "damaged record after %.3f ms\n", (double)r->t_us / 1000.0);
+    free(r);
+    return rc < 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s CAPTURE HOST PORT [--speed X | --fast] [--wait-ms N]\n       %s CAPTURE --dump\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    CaptureHeader h;
+    if (!f || capture_read_header(f, &h) < 0) {
+        fprintf(stderr, "%s: not a capture file\n", argv[1]);
+        return 1;
+    }
+    if (strcmp(argv[2], "--dump") == 0) {
+        printf("seed %u\n", h.seed);
+        return dump(f);
+    }
+    if (argc < 4) {
+        fprintf(stderr, "need HOST and PORT\n");
+        return 1;
+    }
+
+    double speed = 1.0;
+    int fast = 0, wait_ms = 500;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) fast = 1;
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "--wait-ms") == 0 && i + 1 < argc) wait_ms = atoi(argv[++i]);
+    }
+    if (speed <= 0 || wait_ms < 0) {
+        fprintf(stderr, "--speed and --wait-ms must be positive\n");
+        return 1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)atoi(argv[3]));
+    if (inet_pton(AF_INET, argv[2], &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad address %s\n", argv[2]);
+        return 1;
+    }
+    printf("capture seed %u: the target should be fresh and started with --seed %u\n", h.seed, h.seed);
+
+    CaptureRecord *r = calloc(1, sizeof(*r));
+    uint64_t wait_ns = (uint64_t)wait_ms * 1000000ull;
+    uint64_t start = now_ns(), lines = 0, opened = 0, failed = 0;
+    int rc;
+    while ((rc = capture_next(f, r)) == 1) {
+        pump(now_ns() + wait_ns, 1);
+        if (!fast) {
+            uint64_t due = start + (uint64_t)((double)r->t_us * 1000.0 / speed), now = now_ns();
+            if (now < due) pump(due, 0);
+            else hist_record(&behind, now - due);
+        }
+        Conn *c = conn_get(r->conn);
+        if (r->kind == CAPTURE_OPEN) {
+            c->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                if (c->fd >= 0) close(c->fd);
+                c->fd = -1;
+                failed++;
+                continue;
+            }
+            int one = 1;
+            setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(c->fd, F_SETFL, O_NONBLOCK);
+            opened++;
+            if (send_line(c, "", 0) < 0) failed++;   // so the accept comes first too
+        } else if (r->kind == CAPTURE_CLOSE) {
+            if (c->fd >= 0) conn_close(c);
+        } else if (c->fd >= 0) {
+            lines++;
+            if (strcmp(r->line, "QUIT") == 0) {
+                // the server hangs up on QUIT, so no PING can follow it
+                if (send(c->fd, "QUIT\n", 5, MSG_NOSIGNAL) != 5) failed++;
+            } else if (send_line(c, r->line, now_ns()) < 0) {
+                failed++;
+            }
+        }
+    }
+    if (rc < 0) fprintf(stderr, "damaged record after %.3f ms; replayed up to there\n", (double)r->t_us / 1000.0);
+    pump(now_ns() + wait_ns, 1);
+    double secs = (double)(now_ns() - start) / 1e9;
+    for (size_t i = 0; i < nconns; i++) {
+        if (conns[i].fd >= 0) close(conns[i].fd);
+    }
+
+    printf("%llu lines on %llu connections in %.2f s (capture %.2f s, %s): %.0f lines/s\n",
+           (unsigned long long)lines, (unsigned long long)opened, secs, (double)r->t_us / 1e6,
+           fast ? "fast" : "paced", (double)lines / secs);
+    printf("reply ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f  (%llu PONGs)\n",
+           (double)hist_quantile(&latency, 0.5) / 1e6, (double)hist_quantile(&latency, 0.9) / 1e6,
+           (double)hist_quantile(&latency, 0.99) / 1e6, (double)hist_quantile(&latency, 0.999) / 1e6,
+           (double)latency.max / 1e6, (unsigned long long)latency.count);
+    if (!fast && behind.count)
+        printf("behind schedule: %llu records, p50 %.3f ms  p99 %.3f ms  max %.3f ms\n",
+               (unsigned long long)behind.count, (double)hist_quantile(&behind, 0.5) / 1e6,
+               (double)hist_quantile(&behind, 0.99) / 1e6, (double)behind.max / 1e6);
+    printf("no PONG: %llu  ERR replies: %llu  bytes in: %llu  failed connects/sends: %llu\n",
+           (unsigned long long)no_reply, (unsigned long long)err_lines, (unsigned long long)bytes_in,
+           (unsigned long long)failed);
+    free(r);
+    return 0;
+}
@@ -0,0 +1,643 @@
+// sim.c
+// Deterministic simulation: the real server loop (server.c built with
+// -DSERVER_NO_MAIN) runs in this process on a ServerIo of in-memory
+// connections and a virtual clock, against thousands of scripted players.
+// Nothing waits on wall time: when no connection has input, the clock jumps
+// to the next player timer or server timeout. The same options and --seed
+// give the same run, byte for byte (see the trace digest), so timeouts,
+// backpressure and disconnect storms can be reproduced and compared.
+// Players behave like loadgen's: they connect over --ramp-ms, send NICK and
+// SUB (as the client does), and pairs play random moves after a think time,
+// the even one hosting, the odd one joining; after --moves plies the player
+// to move leaves and the pair starts over. --seek-pct of them use SEEK
+// instead and report their matchmaking wait.
+// Scenarios:
+//   --storm-at S --storm-pct P   P% of players hang up at second S and
+//                                reconnect --reconnect-ms later
+//   --stall-at S --stall-pct P   P% of players stop reading at second S;
+//                                once --sockbuf bytes are queued to one, a
+//                                send would block (the OS server stalls its
+//                                whole loop there; here it fails and counts)
+// Reports virtual-time throughput, seek waits, what the scenarios caused,
+// and the real CPU the server loop took per command (the one figure that
+// varies between runs).
+// Run:   ./sim [--clients N] [--seconds N] [--think-ms N] [--size N] [--moves N] [--ramp-ms N]
+//              [--seek-pct P] [--storm-at S --storm-pct P [--reconnect-ms N]]
+//              [--stall-at S --stall-pct P] [--sockbuf BYTES] [--seed N]
+// gcc -O2 -pthread -DSERVER_NO_MAIN -DMAX_CLIENTS=4096 -I../server sim.c ../server/server.c ../server/server_game.c ../server/server_rules.c ../server/server_proto.c ../server/server_playout.c ../server/server_pattern.c ../server/server_tt.c ../server/server_bot.c ../server/server_ring.c ../server/server_botpool.c ../server/server_book.c ../server/server_boardpool.c ../server/server_rxpool.c ../server/server_journal.c ../server/server_snapshot.c ../server/server_crc.c ../server/server_archive.c ../server/server_history.c ../server/server_rating.c ../server/server_match.c ../server/server_fdtab.c ../server/server_metrics.c ../server/server_admin.c ../server/server_slowlog.c ../server/server_dash.c ../server/server_capture.c ../server/server_io.c -lm -o sim
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "server_io.h"
+#include "server_crc.h"
+#include "server_match.h"
+#include "server_metrics.h"
+
+#define SIM_LISTEN_FD 1000000    // virtual fds, well clear of real ones
+#define SIM_FD0 1000001
+#define SIM_RBUF 2048
+#define SIM_CELLS 1024
+#define SIM_EPOCH_MS 1704067200000LL   // wall clock at virtual 0 (2024-01-01 UTC)
+
+enum { P_OFFLINE, P_CONNECTING, P_READY, P_HOSTING, P_JOINING, P_SEEKING, P_PLAYING };
+enum { T_CONNECT, T_MOVE, T_STORM, T_STALL };
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+} Pipe;
+
+// both ends of one connection; the player end is gone once player is -1
+typedef struct
+{
+    Pipe up;                  // player -> server, not received yet
+    Pipe down;                // server -> player, not read yet
+    int player;
+    int player_closed;        // the server reads EOF after up drains
+    int server_closed;        // the player reads EOF after down drains
+    int eof_read;
+    int readable;             // counted in nreadable
+    int queued;               // on the delivery list
+} SimConn;
+
+typedef struct
+{
+    int conn;                 // -1 while offline
+    int state;
+    int seeker;
+    int stalled;
+    int game;
+    int color;
+    int plies;
+    int awaiting;
+    int size;
+    int64_t seek_ms;
+    char board[SIM_CELLS];
+    size_t rlen;
+    char rbuf[SIM_RBUF];
+} Player;
+
+typedef struct
+{
+    int64_t due;
+    int kind;
+    int player;
+    int game;
+} Timer;
+
+static int64_t vnow;          // virtual ms
+static SimConn *conns;
+static int nconns, conns_cap, nreadable;
+static int *acceptq, acc_head, acc_len;   // acceptq holds nconns entries at most
+static int *delivery, ndelivery;
+static Player *players;
+static int nplayers;
+static Timer *heap;
+static int nheap, heap_cap;
+static unsigned rng = 2463534242u;
+
+static int think_ms = 200, board_size = 9, max_moves = 60, reconnect_ms = 1000;
+static int storm_pct, stall_pct;
+static size_t sockbuf = 212992;   // Linux default rmem_default
+
+static uint32_t digest;       // CRC-32 of everything the server sent, in order
+static uint64_t lines_out, moves, games, rejected, errors, refused, hangups;
+static uint64_t would_block, storm_drops, backlogged;
+static Histogram seek_wait;
+
+static unsigned next_rand(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void pipe_put(Pipe *p, const void *src, size_t n) {
+    if (p->len + n > p->cap) {
+        size_t cap = p->cap ? p->cap : 256;
+        while (cap < p->len + n) cap *= 2;
+        char *d = realloc(p->data, cap);
+        if (!d) {
+            perror("realloc");
+            exit(1);
+        }
+        p->data = d;
+        p->cap = cap;
+    }
+    memcpy(p->data + p->len, src, n);
+    p->len += n;
+}
+
+static void pipe_free(Pipe *p) {
+    free(p->data);
+    memset(p, 0, sizeof(*p));
+}
+
+// ---- timers (binary heap on due time) ----
+
+static void heap_push(int64_t due, int kind, int player, int game) {
+    if (nheap == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 1024;
+        heap = realloc(heap, (size_t)heap_cap * sizeof(Timer));
+        if (!heap) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    Timer t = {due, kind, player, game};
+    int i = nheap++;
+    while (i > 0 && heap[(i - 1) / 2].due > t.due) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = t;
+}
+
+static Timer heap_pop(void) {
+    Timer top = heap[0], last = heap[--nheap];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= nheap) break;
+        if (c + 1 < nheap && heap[c + 1].due < heap[c].due) c++;
+        if (heap[c].due >= last.due) break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+// ---- the ServerIo ----
+
+static SimConn *conn_of(int fd) {
+    int k = fd - SIM_FD0;
+    return k >= 0 && k < nconns ? &conns[k] : NULL;
+}
+
+static void update_readable(SimConn *c) {
+    int r = !c->server_closed && (c->up.len > 0 || (c->player_closed && !c->eof_read));
+    nreadable += r - c->readable;
+    c->readable = r;
+}
+
+static void queue_delivery(int k) {
+    if (conns[k].queued) return;
+    conns[k].queued = 1;
+    delivery[ndelivery++] = k;
+}
+
+static int64_t sim_now_ms(void) {
+    return vnow;
+}
+
+// a fixed start date, so archived end times repeat too
+static int64_t sim_wall_ms(void) {
+    return SIM_EPOCH_MS + vnow;
+}
+
+static int sim_wait(const Client clients[], int listen_fd, int bot_fd, int timeout_ms) {
+    (void)clients;
+    (void)listen_fd;
+    (void)bot_fd;
+    if (nreadable > 0 || acc_len > 0) return nreadable + acc_len;
+    // nothing to read: time passes until the next player timer or the
+    // server's own timeout, whichever is first
+    int64_t next = nheap ? heap[0].due : INT64_MAX;
+    if (timeout_ms >= 0 && vnow + timeout_ms < next) next = vnow + timeout_ms;
+    if (next != INT64_MAX && next > vnow) vnow = next;
+    return 0;
+}
+
+static int sim_ready(int fd) {
+    if (fd == SIM_LISTEN_FD) return acc_len > 0;
+    SimConn *c = conn_of(fd);
+    return c && c->readable;
+}
+
+static int sim_accept(int listen_fd, struct sockaddr_in *peer) {
+    (void)listen_fd;
+    if (acc_len == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    int k = acceptq[acc_head];
+    acc_head = (acc_head + 1) % conns_cap;
+    acc_len--;
+    memset(peer, 0, sizeof(*peer));
+    peer->sin_family = AF_INET;
+    peer->sin_addr.s_addr = htonl(0x0a000000u | (uint32_t)(k & 0xffffff));
+    peer->sin_port = htons((uint16_t)(20000 + k % 40000));
+    return SIM_FD0 + k;
+}
+
+static ssize_t sim_recv(int fd, void *buf, size_t n) {
+    SimConn *c = conn_of(fd);
+    if (!c || c->server_closed) {
+        errno = EBADF;
+        return -1;
+    }
+    if (c->up.len == 0) {
+        if (c->player_closed) {
+            c->eof_read = 1;
+            update_readable(c);
+            return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+    size_t k = c->up.len < n ? c->up.len : n;
+    memcpy(buf, c->up.data, k);
+    memmove(c->up.data, c->up.data + k, c->up.len - k);
+    c->up.len -= k;
+    update_readable(c);
+    return (ssize_t)k;
+}
+
+static ssize_t sim_send(int fd, const void *buf, size_t n) {
+    SimConn *c = conn_of(fd);
+    if (!c || c->server_closed) {
+        errno = EBADF;
+        return -1;
+    }
+    if (c->player_closed) {
+        errno = EPIPE;
+        return -1;
+    }
+    size_t room = c->down.len < sockbuf ? sockbuf - c->down.len : 0;
+    if (room == 0) {
+        would_block++;
+        errno = EAGAIN;
+        return -1;
+    }
+    size_t k = n < room ? n : room;
+    pipe_put(&c->down, buf, k);
+    digest = crc32_update(digest, buf, k);
+    queue_delivery(fd - SIM_FD0);
+    return (ssize_t)k;
+}
+
+// archive records go through the same pipe as everything else
+static ssize_t sim_sendfile(int fd, int in_fd, off_t *off, size_t n) {
+    char buf[65536];
+    ssize_t r = pread(in_fd, buf, n < sizeof(buf) ? n : sizeof(buf), *off);
+    if (r <= 0) return r;
+    ssize_t w = sim_send(fd, buf, (size_t)r);
+    if (w > 0) *off += w;
+    return w;
+}
+
+static void sim_close(int fd) {
+    SimConn *c = conn_of(fd);
+    if (!c || c->server_closed) return;
+    c->server_closed = 1;
+    pipe_free(&c->up);
+    update_readable(c);
+    queue_delivery(fd - SIM_FD0);
+}
+
+static const ServerIo sim_io = {sim_now_ms, sim_wall_ms, sim_wait, sim_ready, sim_accept, sim_recv, sim_send, sim_sendfile, sim_close};
+
+// ---- players ----
+
+static void hang_up(Player *p) {
+    if (p->conn < 0) return;
+    SimConn *c = &conns[p->conn];
+    c->player = -1;
+    c->player_closed = 1;
+    pipe_free(&c->down);
+    update_readable(c);
+    p->conn = -1;
+    p->state = P_OFFLINE;
+    p->rlen = 0;
+}
+
+static void say(Player *p, const char *line) {
+    SimConn *c = &conns[p->conn];
+    if (c->server_closed) return;
+    pipe_put(&c->up, line, strlen(line));
+    update_readable(c);
+    lines_out++;
+}
+
+static void connect_player(int i) {
+    if (nconns == conns_cap) {
+        // the accept queue is a ring over conns_cap; unroll it before growing
+        int cap = conns_cap ? conns_cap * 2 : 4096;
+        SimConn *nc = realloc(conns, (size_t)cap * sizeof(SimConn));
+        int *q = malloc((size_t)cap * sizeof(int)), *d = realloc(delivery, (size_t)cap * sizeof(int));
+        if (!nc || !q || !d) {
+            perror("realloc");
+            exit(1);
+        }
+        for (int k = 0; k < acc_len; k++) q[k] = acceptq[(acc_head + k) % conns_cap];
+        free(acceptq);
+        conns = nc;
+        acceptq = q;
+        delivery = d;
+        acc_head = 0;
+        conns_cap = cap;
+    }
+    int k = nconns++;
+    memset(&conns[k], 0, sizeof(SimConn));
+    conns[k].player = i;
+    acceptq[(acc_head + acc_len++) % conns_cap] = k;
+
+    Player *p = &players[i];
+    p->conn = k;
+    p->state = P_CONNECTING;
+    p->game = 0;
+    p->awaiting = 0;
+    p->rlen = 0;
+    char line[64];
+    snprintf(line, sizeof(line), "NICK sim%d\nSUB\n", i);
+    say(p, line);
+}
+
+// pair h, h + 1: the even player hosts once both are ready; the odd one
+// joins whatever the even one hosts, also after coming back from a storm
+static void pair_up(int h) {
+    Player *p = &players[h], *q = &players[h + 1];
+    if (q->state != P_READY) return;
+    char line[32];
+    if (p->state == P_READY) {
+        snprintf(line, sizeof(line), "HOST %d R\n", board_size);
+        p->state = P_HOSTING;
+        p->game = 0;
+        say(p, line);
+    } else if (p->state == P_HOSTING && p->game) {
+        snprintf(line, sizeof(line), "JOIN %d\n", p->game);
+        q->state = P_JOINING;
+        say(q, line);
+    }
+}
+
+static void seek(Player *p) {
+    char line[32];
+    snprintf(line, sizeof(line), "SEEK %d R\n", board_size);
+    p->state = P_SEEKING;
+    p->seek_ms = vnow;
+    say(p, line);
+}
+
+// between games: seekers seek again, the even player of a pair hosts
+static void game_done(int i) {
+    Player *p = &players[i];
+    p->game = 0;
+    p->awaiting = 0;
+    p->state = P_READY;
+    if (p->seeker) seek(p);
+    else pair_up(i & ~1);
+}
+
+static void play(int i) {
+    Player *p = &players[i];
+    char line[64];
+    if (p->plies >= max_moves) {
+        snprintf(line, sizeof(line), "LEAVE %d\n", p->game);
+        p->game = 0;
+        say(p, line);
+        return;
+    }
+    int n = p->size * p->size, empty = 0;
+    for (int k = 0; k < n; k++) empty += p->board[k] == '.';
+    if (empty == 0) {
+        snprintf(line, sizeof(line), "PASS %d\n", p->game);
+    } else {
+        int pick = (int)(next_rand() % (unsigned)empty), k = 0;
+        for (;; k++) {
+            if (p->board[k] == '.' && pick-- == 0) break;
+        }
+        p->board[k] = 'x';
+        snprintf(line, sizeof(line), "MOVE %d %d %d\n", p->game, k % p->size, k / p->size);
+    }
+    p->awaiting = 1;
+    say(p, line);
+}
+
+static void on_line(int i, char *line) {
+    Player *p = &players[i];
+    int id, size;
+    char word[16];
+
+    if (strncmp(line, "BOARD ", 6) == 0) {
+        if (sscanf(line, "BOARD %d %15s", &id, word) != 2 || id != p->game) return;
+        char *cells = strchr(line + 6, ' ');
+        if (cells) cells = strchr(cells + 1, ' ');
+        int n = p->size * p->size;
+        if (!cells || (int)strlen(cells + 1) < n) return;
+        memcpy(p->board, cells + 1, (size_t)n);
+        p->plies++;
+        if (p->awaiting) {
+            moves++;
+            p->awaiting = 0;
+        }
+        if ((strcmp(word, "BLACK") == 0 ? 0 : 1) == p->color) {
+            int think = think_ms / 2 + (int)(next_rand() % (unsigned)(think_ms + 1));
+            heap_push(vnow + think, T_MOVE, i, p->game);
+        }
+    } else if (strncmp(line, "START ", 6) == 0) {
+        if (sscanf(line, "START %d %d %15s", &id, &size, word) != 3 || size * size > SIM_CELLS) return;
+        if (p->state == P_SEEKING) hist_record(&seek_wait, (uint64_t)(vnow - p->seek_ms) * 1000000u);
+        p->state = P_PLAYING;
+        p->game = id;
+        p->size = size;
+        p->color = strcmp(word, "BLACK") == 0 ? 0 : 1;
+        p->plies = -1;    // the opening BOARD is not a move
+        p->awaiting = 0;
+        if (p->color == 0) games++;
+    } else if (strncmp(line, "HOSTED ", 7) == 0) {
+        if (sscanf(line, "HOSTED %d", &id) != 1 || p->state != P_HOSTING) return;
+        p->game = id;
+        pair_up(i);
+    } else if (strncmp(line, "GAME_OVER ", 10) == 0) {
+        if (sscanf(line, "GAME_OVER %d", &id) == 1 && id == p->game) game_done(i);
+    } else if (strcmp(line, "OK LEFT") == 0) {
+        game_done(i);
+    } else if (strcmp(line, "OK NICK set") == 0) {
+        game_done(i);
+    } else if (strncmp(line, "ERR ", 4) == 0) {
+        if (strcmp(line, "ERR server full") == 0) {
+            refused++;
+        } else if (p->awaiting && (strcmp(line, "ERR suicide") == 0 || strcmp(line, "ERR ko") == 0 ||
+                                   strcmp(line, "ERR occupied") == 0)) {
+            rejected++;
+            p->awaiting = 0;
+            play(i);
+        } else {
+            errors++;
+            p->awaiting = 0;
+            // a partner that left meanwhile makes HOST/JOIN fail; start over
+            if (p->state == P_HOSTING || p->state == P_JOINING) game_done(i);
+        }
+    }
+}
+
+// hand player k's end whatever the server sent it
+static void deliver(int k) {
+    SimConn *c = &conns[k];
+    c->queued = 0;
+    if (c->player < 0) return;
+    Player *p = &players[c->player];
+    if (p->stalled) return;
+    size_t off = 0;
+    while (off < c->down.len && p->conn == k) {
+        size_t n = c->down.len - off;
+        if (n > SIM_RBUF - 1 - p->rlen) n = SIM_RBUF - 1 - p->rlen;
+        memcpy(p->rbuf + p->rlen, c->down.data + off, n);
+        off += n;
+        p->rlen += n;
+        size_t start = 0;
+        for (size_t j = 0; j < p->rlen && p->conn == k; j++) {
+            if (p->rbuf[j] != '\n') continue;
+            p->rbuf[j] = '\0';
+            on_line(c->player, p->rbuf + start);
+            start = j + 1;
+        }
+        if (p->conn != k) return;   // hung up on something it read
+        memmove(p->rbuf, p->rbuf + start, p->rlen - start);
+        p->rlen -= start;
+        if (p->rlen == SIM_RBUF - 1) p->rlen = 0;
+    }
+    c->down.len = 0;
+    if (c->server_closed) {
+        // EOF: the server dropped this player (a send failed, server full)
+        hangups++;
+        hang_up(p);
+    }
+}
+
+static void fire(const Timer *t) {
+    if (t->kind == T_CONNECT) {
+        if (players[t->player].conn < 0) connect_player(t->player);
+    } else if (t->kind == T_MOVE) {
+        Player *p = &players[t->player];
+        if (p->conn >= 0 && p->state == P_PLAYING && p->game == t->game && !p->awaiting) play(t->player);
+    } else if (t->kind == T_STORM) {
+        for (int i = 0; i < nplayers; i++) {
+            if (players[i].conn < 0 || (int)(next_rand() % 100) >= storm_pct) continue;
+            hang_up(&players[i]);
+            storm_drops++;
+            heap_push(vnow + reconnect_ms, T_CONNECT, i, 0);
+        }
+    } else if (t->kind == T_STALL) {
+        for (int i = 0; i < nplayers; i++) {
+            if ((int)(next_rand() % 100) < stall_pct) players[i].stalled = 1;
+        }
+    }
+}
+
+static double per_s(uint64_t n, int64_t ms) {
+    return ms > 0 ? (double)n * 1000.0 / (double)ms : 0.0;
+}
+
+int main(int argc, char **argv) {
+    int clients = 2000, seconds = 60, ramp_ms = 1000, seek_pct = 0;
+    double storm_at = -1, stall_at = -1;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value\n", a);
+            return 1;
+        }
+        if (strcmp(a, "--clients") == 0) clients = atoi(argv[++i]);
+        else if (strcmp(a, "--seconds") == 0) seconds = atoi(argv[++i]);
+        else if (strcmp(a, "--think-ms") == 0) think_ms = atoi(argv[++i]);
+        else if (strcmp(a, "--size") == 0) board_size = atoi(argv[++i]);
+        else if (strcmp(a, "--moves") == 0) max_moves = atoi(argv[++i]);
+        else if (strcmp(a, "--ramp-ms") == 0) ramp_ms = atoi(argv[++i]);
+        else if (strcmp(a, "--seek-pct") == 0) seek_pct = atoi(argv[++i]);
+        else if (strcmp(a, "--storm-at") == 0) storm_at = atof(argv[++i]);
+        else if (strcmp(a, "--storm-pct") == 0) storm_pct = atoi(argv[++i]);
+        else if (strcmp(a, "--reconnect-ms") == 0) reconnect_ms = atoi(argv[++i]);
+        else if (strcmp(a, "--stall-at") == 0) stall_at = atof(argv[++i]);
+        else if (strcmp(a, "--stall-pct") == 0) stall_pct = atoi(argv[++i]);
+        else if (strcmp(a, "--sockbuf") == 0) sockbuf = (size_t)atol(argv[++i]);
+        else if (strcmp(a, "--seed") == 0) seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "unknown option %s\n", a);
+            return 1;
+        }
+    }
+    if (clients < 2 || seconds <= 0 || think_ms < 0 || ramp_ms < 0 || board_size < BOARD_MIN_SIZE ||
+        board_size > BOARD_MAX_SIZE || board_size * board_size > SIM_CELLS || sockbuf == 0) {
+        fprintf(stderr, "bad options\n");
+        return 1;
+    }
+    clients &= ~1;
+    if (clients > MAX_CLIENTS)
+        printf("note: %d players, the server holds %d (MAX_CLIENTS); the rest are refused\n", clients, MAX_CLIENTS);
+
+    metrics_init();
+    srand(seed);
+    rng ^= seed * 2654435761u;
+    if (rng == 0) rng = 1;
+    server_init(&sim_io, SIM_LISTEN_FD, -1);
+
+    nplayers = clients;
+    players = calloc((size_t)nplayers, sizeof(Player));
+    if (!players) {
+        perror("calloc");
+        return 1;
+    }
+    int seekers = (int)((long)nplayers * seek_pct / 100);
+    for (int i = 0; i < nplayers; i++) {
+        players[i].conn = -1;
+        players[i].seeker = (i & ~1) < seekers;
+        heap_push(ramp_ms ? (int64_t)((long)i * ramp_ms / nplayers) : 0, T_CONNECT, i, 0);
+    }
+    if (storm_at >= 0 && storm_pct > 0) heap_push((int64_t)(storm_at * 1000), T_STORM, -1, 0);
+    if (stall_at >= 0 && stall_pct > 0) heap_push((int64_t)(stall_at * 1000), T_STALL, -1, 0);
+
+    int64_t end_ms = (int64_t)seconds * 1000;
+    uint64_t passes = 0, server_ns = 0, t_start = metrics_now_ns();
+    while (vnow < end_ms) {
+        uint64_t t0 = metrics_now_ns();
+        server_step();
+        server_ns += metrics_now_ns() - t0;
+        passes++;
+        for (int k = 0; k < ndelivery; k++) deliver(delivery[k]);
+        ndelivery = 0;
+        while (nheap && heap[0].due <= vnow) {
+            Timer t = heap_pop();
+            fire(&t);
+        }
+        if (nreadable == 0 && acc_len == 0 && nheap == 0 && !match_waiting()) break;   // nothing left to happen
+    }
+    double real_s = (double)(metrics_now_ns() - t_start) / 1e9;
+
+    int online = 0, stalled = 0;
+    for (int i = 0; i < nplayers; i++) {
+        online += players[i].conn >= 0;
+        stalled += players[i].stalled;
+    }
+    for (int k = 0; k < nconns; k++) {
+        if (conns[k].down.len && conns[k].player >= 0 && players[conns[k].player].stalled) backlogged++;
+    }
+    printf("virtual %.3f s, %d players (%d seeking), %llu loop passes, %d connections made\n", (double)vnow / 1000.0,
+           nplayers, seekers, (unsigned long long)passes, nconns);
+    printf("moves %llu (%.0f/s)  games %llu  commands %llu  rejected %llu  errors %llu  refused %llu\n",
+           (unsigned long long)moves, per_s(moves, vnow), (unsigned long long)games,
+           (unsigned long long)lines_out, (unsigned long long)rejected, (unsigned long long)errors,
+           (unsigned long long)refused);
+    if (seek_wait.count)
+        printf("seek wait ms: p50 %.0f  p99 %.0f  max %.0f  (%llu matched)\n",
+               (double)hist_quantile(&seek_wait, 0.5) / 1e6, (double)hist_quantile(&seek_wait, 0.99) / 1e6,
+               (double)seek_wait.max / 1e6, (unsigned long long)seek_wait.count);
+    if (storm_pct > 0) printf("storm: %llu hung up\n", (unsigned long long)storm_drops);
+    if (stall_pct > 0)
+        printf("stall: %d players stopped reading, %d with data queued; %llu sends would have blocked the loop\n",
+               stalled, (int)backlogged, (unsigned long long)would_block);
+    printf("dropped by the server (full, failed sends): %llu  online at the end: %d\n", (unsigned long long)hangups, online);
+    printf("trace digest %08x\n", digest);
+    printf("real %.2f s, server loop %.2f s: %.2f us per command (varies between runs)\n", real_s,
+           (double)server_ns / 1e9, lines_out ? (double)server_ns / 1e3 / (double)lines_out : 0.0);
+    return 0;
+}